@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Number to text without printf: padded integers, fixed-point decimals and clock
+// times are written straight into the caller's buffer with integer arithmetic. Every
+// function writes at out without a terminating zero and returns the position after the
+// last character, so a line is built by chaining calls and terminated with End(). The
+// caller's buffer must hold the result, which is at most max(width, MAX_*) characters.
+class FixedFormat
+{
+public:
+    static constexpr size_t MAX_UNSIGNED = 10;          // 4294967295
+    static constexpr size_t MAX_SIGNED = 11;            // -2147483648
+    static constexpr size_t MAX_FIXED = 18;             // Sign, 10 + 6 digits and '.'
+    static constexpr int MAX_DECIMALS = 6;
+
+    static char* Text(char* out, const char* text)
+    {
+        while (*text) {
+            *out++ = *text++;
+        }
+        return out;
+    }
+
+    static char* Char(char* out, char c)
+    {
+        *out++ = c;
+        return out;
+    }
+
+    static char* End(char* out)
+    {
+        *out = '\0';
+        return out;
+    }
+
+    // Right aligned in width, '0' padding goes between the sign and the digits
+    static char* Unsigned(char* out, uint32_t value, int width = 0, char pad = ' ')
+    {
+        char digits[MAX_UNSIGNED];
+        const int len = reverse_digits(digits, value);
+        out = padding(out, width - len, pad);
+        return copy_reversed(out, digits, len);
+    }
+
+    static char* Signed(char* out, int32_t value, int width = 0, char pad = ' ', bool plus = false)
+    {
+        const uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : value;
+        char digits[MAX_UNSIGNED];
+        const int len = reverse_digits(digits, magnitude);
+        return with_sign(out, digits, len, value < 0, width, pad, plus);
+    }
+
+    // Rounded to decimals places like "%*.*f", except that exact binary ties go away from
+    // zero (printf: to even) and a value rounding to zero has no sign ("0.0", not "-0.0").
+    // Magnitudes above 4e9 are clamped, NaN is "nan".
+    static char* Fixed(char* out, float value, int decimals, int width = 0, bool plus = false)
+    {
+        if (std::isnan(value)) {
+            out = padding(out, width - 3, ' ');
+            return Text(out, "nan");
+        }
+
+        static constexpr uint32_t POW10[MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+        decimals = decimals < 0 ? 0 : decimals > MAX_DECIMALS ? MAX_DECIMALS : decimals;
+
+        // Whole and fraction apart: the fraction is exact in a float, scaling the value as
+        // a whole would lose the last decimals of larger numbers
+        const float magnitude = std::fmin(std::fabs(value), 4e9f);
+        uint32_t whole = static_cast<uint32_t>(magnitude);
+        uint32_t fraction = static_cast<uint32_t>((magnitude - whole) * POW10[decimals] + 0.5f);
+        if (fraction >= POW10[decimals]) {
+            fraction -= POW10[decimals];
+            ++whole;
+        }
+        const bool negative = value < 0 && (whole || fraction);
+
+        char digits[MAX_FIXED];
+        int len = 0;
+        if (decimals) {
+            for (int i = 0; i < decimals; ++i) {
+                digits[len++] = '0' + fraction % 10;
+                fraction /= 10;
+            }
+            digits[len++] = '.';
+        }
+        len += reverse_digits(digits + len, whole);
+        return with_sign(out, digits, len, negative, width, ' ', plus);
+    }
+
+    // Two digits with a leading zero, as "%02u" for 0..99
+    static char* TwoDigits(char* out, unsigned value)
+    {
+        *out++ = '0' + value / 10 % 10;
+        *out++ = '0' + value % 10;
+        return out;
+    }
+
+    // "HH:MM:SS", or "HH:MM" without seconds
+    static char* Clock(char* out, int hour, int minute, int second, bool seconds = true)
+    {
+        out = TwoDigits(out, hour);
+        *out++ = ':';
+        out = TwoDigits(out, minute);
+        if (seconds) {
+            *out++ = ':';
+            out = TwoDigits(out, second);
+        }
+        return out;
+    }
+
+private:
+    // Least significant first, at least one digit; division by a constant 10 compiles
+    // to a multiply
+    static int reverse_digits(char* digits, uint32_t value)
+    {
+        int len = 0;
+        do {
+            digits[len++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        return len;
+    }
+
+    static char* copy_reversed(char* out, const char* digits, int len)
+    {
+        while (len) {
+            *out++ = digits[--len];
+        }
+        return out;
+    }
+
+    static char* padding(char* out, int count, char pad)
+    {
+        for (; count > 0; --count) {
+            *out++ = pad;
+        }
+        return out;
+    }
+
+    static char* with_sign(char* out, const char* digits, int len, bool negative, int width, char pad, bool plus)
+    {
+        const char sign = negative ? '-' : plus ? '+' : '\0';
+        const int total = len + (sign ? 1 : 0);
+        if (pad == '0') {
+            if (sign)
+                *out++ = sign;
+            out = padding(out, width - total, '0');
+        }
+        else {
+            out = padding(out, width - total, pad);
+            if (sign)
+                *out++ = sign;
+        }
+        return copy_reversed(out, digits, len);
+    }
+};
@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "common.h"
+#include "FixedFormat.h"
 #include "sdkconfig.h"
 
 const TickType_t xDelayMs = 20 / portTICK_PERIOD_MS;
@@ -154,7 +155,16 @@ void process_led_input()
             int duty = duty_r * PWM_LED_RANGE;
             ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, PWM_LED_CHAN, duty, 0);
             if (g_log_counter % 50 == 0) {
-                ESP_LOGI(TAG, "LED >>> Avg: %6.1f | Duty: %4d (%4.1f%%)", led_sample, duty, duty_r * 100.0f);
+                // Same as "Avg: %6.1f | Duty: %4d (%4.1f%%)", without the float printf path
+                char line[96];
+                char* p = FixedFormat::Text(line, "Avg: ");
+                p = FixedFormat::Fixed(p, led_sample, 1, 6);
+                p = FixedFormat::Text(p, " | Duty: ");
+                p = FixedFormat::Signed(p, duty, 4);
+                p = FixedFormat::Text(p, " (");
+                p = FixedFormat::Fixed(p, duty_r * 100.0f, 1, 4);
+                FixedFormat::End(FixedFormat::Text(p, "%)"));
+                ESP_LOGI(TAG, "LED >>> %s", line);
             }
         }
     }
@@ -257,7 +267,18 @@ void process_servo_input()
     ledc_set_duty_and_update(LEDC_LOW_SPEED_MODE, PWM_SERVO_CHAN, duty, 0);
     if (g_log_counter % 50 == 0) {
         float angle = -90.0f + duty_r * 180.0f;
-        ESP_LOGI(TAG, "SRV >>> Avg: %6.1f | Duty: %4d (%4.1f%%) | Angle: %+6.1f", servo_sample, duty, duty_r * 100.0f, angle);
+
+        // Same as "Avg: %6.1f | Duty: %4d (%4.1f%%) | Angle: %+6.1f", without the float printf path
+        char line[128];
+        char* p = FixedFormat::Text(line, "Avg: ");
+        p = FixedFormat::Fixed(p, servo_sample, 1, 6);
+        p = FixedFormat::Text(p, " | Duty: ");
+        p = FixedFormat::Signed(p, duty, 4);
+        p = FixedFormat::Text(p, " (");
+        p = FixedFormat::Fixed(p, duty_r * 100.0f, 1, 4);
+        p = FixedFormat::Text(p, "%) | Angle: ");
+        FixedFormat::End(FixedFormat::Fixed(p, angle, 1, 6, true));
+        ESP_LOGI(TAG, "SRV >>> %s", line);
     }
 }
 
@@ -0,0 +1,186 @@
+#include "LoopStats.h"
+
+#include <freertos/task.h>
+#include <esp_attr.h>
+#include <esp_freertos_hooks.h>
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+#include "common.h"
+
+constexpr const int64_t TICK_US = portTICK_PERIOD_MS * 1000LL;
+constexpr const uint32_t TICK_CPU = 0;          // The core that counts ticks
+
+/* static */ LoopStats* LoopStats::s_first = nullptr;
+/* static */ portMUX_TYPE LoopStats::s_lock = portMUX_INITIALIZER_UNLOCKED;
+/* static */ int64_t LoopStats::s_tick_origin_us = 0;
+/* static */ portMUX_TYPE LoopStats::s_tick_lock = portMUX_INITIALIZER_UNLOCKED;
+
+LoopStats::LoopStats(const char* name)
+    : m_name(name)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const bool first = !s_first;
+    m_next = s_first;
+    s_first = this;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (first) {
+        esp_register_freertos_tick_hook_for_cpu(&LoopStats::on_tick, TICK_CPU);
+    }
+}
+
+LoopStats::~LoopStats()
+{
+    taskENTER_CRITICAL(&s_lock);
+    for (LoopStats** p = &s_first; *p; p = &(*p)->m_next) {
+        if (*p == this) {
+            *p = m_next;
+            break;
+        }
+    }
+    const bool last = !s_first;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (last) {
+        esp_deregister_freertos_tick_hook_for_cpu(&LoopStats::on_tick, TICK_CPU);
+    }
+}
+
+void LoopStats::Begin(bool timed_out /* = false */)
+{
+    m_begin_us = esp_timer_get_time();
+
+    // A wakeup by an event is not lateness. A timeout expires at a tick interrupt, the
+    // one m_timeout ticks after the tick End() was called in.
+    if (timed_out && m_timeout != portMAX_DELAY) {
+        m_late.Add(m_begin_us - tick_time_us(m_end_tick + m_timeout));
+    }
+}
+
+void LoopStats::End(TickType_t timeout /* = portMAX_DELAY */)
+{
+    const int64_t now = esp_timer_get_time();
+    if (m_begin_us) {
+        m_run.Add(now - m_begin_us);
+    }
+    m_end_tick = xTaskGetTickCount();
+    m_timeout = timeout;
+}
+
+void LoopStats::Read(Histogram* run, Histogram* late) const
+{
+    m_run.Read(run);
+    m_late.Read(late);
+}
+
+int LoopStats::Format(char* buf, size_t size) const
+{
+    Histogram histograms[2];
+    Read(&histograms[0], &histograms[1]);
+    static const char* const KINDS[2] = { "run", "late" };
+
+    int len = snprintf(buf, size, "{");
+    for (int h = 0; h < 2; ++h) {
+        const Histogram& histogram = histograms[h];
+        int used = BUCKETS;
+        while (used > 1 && !histogram.buckets[used - 1]) {
+            --used;
+        }
+
+        len += snprintf(buf + len, len < (int) size ? size - len : 0, "%s\"%s\":{\"n\":%lu,\"max\":%lu,\"b\":[",
+            h ? "," : "", KINDS[h], (unsigned long) histogram.count, (unsigned long) histogram.max_us);
+        for (int i = 0; i < used; ++i) {
+            len += snprintf(buf + len, len < (int) size ? size - len : 0, "%s%lu", i ? "," : "", (unsigned long) histogram.buckets[i]);
+        }
+        len += snprintf(buf + len, len < (int) size ? size - len : 0, "]}");
+    }
+    len += snprintf(buf + len, len < (int) size ? size - len : 0, "}");
+    return len;
+}
+
+/* static */ void LoopStats::LogAll()
+{
+    ForEach([] (const LoopStats& stats) {
+        Histogram run, late;
+        stats.Read(&run, &late);
+        log_histogram(stats.Name(), "run", run);
+        log_histogram(stats.Name(), "late", late);
+    });
+}
+
+/* static */ void LoopStats::ForEach(const std::function<void(const LoopStats&)>& fn)
+{
+    // New instances go to the front, walking the list needs no lock
+    for (const LoopStats* stats = s_first; stats; stats = stats->m_next) {
+        fn(*stats);
+    }
+}
+
+/* static */ void LoopStats::log_histogram(const char* name, const char* kind, const Histogram& histogram)
+{
+    // Non-empty buckets by their upper bound in us, e.g. "<64:12 <128:300"
+    char line[BUCKETS * 21];
+    int len = 0;
+    for (int i = 0; i < BUCKETS && len < (int) sizeof(line); ++i) {
+        if (!histogram.buckets[i])
+            continue;
+
+        const unsigned long count = histogram.buckets[i];
+        if (i == 0)
+            len += snprintf(line + len, sizeof(line) - len, " 0:%lu", count);
+        else if (i < BUCKETS - 1)
+            len += snprintf(line + len, sizeof(line) - len, " <%lu:%lu", 1ul << i, count);
+        else
+            len += snprintf(line + len, sizeof(line) - len, " >=%lu:%lu", 1ul << (i - 1), count);
+    }
+    line[std::min<size_t>(len, sizeof(line) - 1)] = '\0';
+
+    ESP_LOGI(TAG, "Loop %s %s: n=%lu max=%lu us,%s", name, kind,
+        (unsigned long) histogram.count, (unsigned long) histogram.max_us, len ? line : " -");
+}
+
+/* static */ IRAM_ATTR void LoopStats::on_tick()
+{
+    // Runs in the tick interrupt right after the count went up. Kept as one origin, not
+    // as the last tick's time, so it stays valid across ticks skipped by tickless idle
+    // for as long as the tick timer keeps its phase.
+    const int64_t origin = esp_timer_get_time() - xTaskGetTickCountFromISR() * TICK_US;
+    portENTER_CRITICAL_ISR(&s_tick_lock);
+    s_tick_origin_us = origin;
+    portEXIT_CRITICAL_ISR(&s_tick_lock);
+}
+
+/* static */ int64_t LoopStats::tick_time_us(TickType_t tick)
+{
+    taskENTER_CRITICAL(&s_tick_lock);
+    const int64_t origin = s_tick_origin_us;
+    taskEXIT_CRITICAL(&s_tick_lock);
+    return origin + tick * TICK_US;
+}
+
+void LoopStats::Counters::Add(int64_t us)
+{
+    const uint32_t value = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+    const int bucket = std::min<int>(std::bit_width(value), BUCKETS - 1);
+
+    // Single writer, so plain read-modify-write is enough, atomics only keep readers sane
+    buckets[bucket].store(buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (value > max_us.load(std::memory_order_relaxed)) {
+        max_us.store(value, std::memory_order_relaxed);
+    }
+}
+
+void LoopStats::Counters::Read(Histogram* histogram) const
+{
+    histogram->count = count.load(std::memory_order_relaxed);
+    histogram->max_us = max_us.load(std::memory_order_relaxed);
+    for (int i = 0; i < BUCKETS; ++i) {
+        histogram->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Timing of a task's main loop in two log2 histograms:
+//   run   time from wakeup until the task blocks again, i.e. the work of one iteration
+//   late  how long after its timeout a task woke up, only for wakeups by timeout
+// The task calls Begin() right after its blocking wait returns, telling whether the
+// wait timed out, and End() right before it blocks again. A timeout expires at a tick
+// interrupt, so lateness counts from the tick the wait was due to end on (tick count at
+// End() plus the timeout), not from the time of End() plus the timeout. A tick hook
+// keeps the esp_timer time of tick 0 for converting ticks to us. Bucket 0 counts 0 us,
+// bucket i values in [2^(i-1), 2^i) us and the last bucket everything from
+// 2^(BUCKETS-2) us up. Only the owning task writes, and readers get a snapshot without
+// stopping it. Every instance is listed for LogAll() and ForEach(), so a new task needs
+// nothing beyond a member and the two calls.
+class LoopStats
+{
+public:
+    static constexpr int BUCKETS = 24;          // Last bucket starts at 4.2 s
+
+    struct Histogram {
+        uint32_t count;
+        uint32_t max_us;
+        uint32_t buckets[BUCKETS];
+    };
+
+    LoopStats(const char* name);
+    ~LoopStats();
+
+    LoopStats(const LoopStats&) = delete;
+    LoopStats& operator=(const LoopStats&) = delete;
+
+    // timed_out: the wait returned because its timeout expired, not for an event
+    void Begin(bool timed_out = false);
+    // Task is about to block for at most timeout ticks
+    void End(TickType_t timeout = portMAX_DELAY);
+
+    const char* Name() const { return m_name; }
+    void Read(Histogram* run, Histogram* late) const;
+
+    // JSON {"run":{"n":..,"max":..,"b":[..]},"late":{..}}, trailing empty buckets left out.
+    // Returns the length like snprintf.
+    int Format(char* buf, size_t size) const;
+
+    // One console line per histogram of every instance
+    static void LogAll();
+
+    // Instances must outlive the call, they normally live as long as their task
+    static void ForEach(const std::function<void(const LoopStats&)>& fn);
+
+private:
+    struct Counters {
+        std::atomic<uint32_t> count = 0;
+        std::atomic<uint32_t> max_us = 0;
+        std::atomic<uint32_t> buckets[BUCKETS] = {};
+
+        void Add(int64_t us);
+        void Read(Histogram* histogram) const;
+    };
+
+    const char* m_name;
+    Counters m_run;
+    Counters m_late;
+    int64_t m_begin_us = 0;
+    TickType_t m_end_tick = 0;                  // Tick count at End()
+    TickType_t m_timeout = portMAX_DELAY;
+
+    LoopStats* m_next = nullptr;
+    static LoopStats* s_first;
+    static portMUX_TYPE s_lock;
+
+    // esp_timer time at which tick 0 would have occurred, updated by on_tick()
+    static int64_t s_tick_origin_us;
+    static portMUX_TYPE s_tick_lock;
+
+    static void on_tick();
+    static int64_t tick_time_us(TickType_t tick);
+    static void log_histogram(const char* name, const char* kind, const Histogram& histogram);
+};
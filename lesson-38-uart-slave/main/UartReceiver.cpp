@@ -67,7 +67,9 @@ void UartReceiver::uart_event_task()
 
     while (1) {
         //Waiting for UART event.
+        m_loop.End();
         if (xQueueReceive(m_uart_queue, &event, portMAX_DELAY)) {
+            m_loop.Begin();
             bzero(buf, sizeof(buf));
             ESP_LOGI(TAG, "uart event type: %d", event.type);
             switch (event.type) {
@@ -3,6 +3,8 @@
 #include <functional>
 #include <driver/uart.h>
 
+#include "LoopStats.h"
+
 class UartReceiver
 {
 public:
@@ -17,6 +19,7 @@ private:
 
     QueueHandle_t m_uart_queue = nullptr;
     TaskHandle_t m_uart_task = nullptr;
+    LoopStats m_loop { "uart_event_task" };
 
     void uart_event_task();
 };
@@ -5,13 +5,18 @@
 #include "common.h"
 
 #include "Calculator.h"
+#include "LoopStats.h"
 
 extern "C" void app_main(void)
 {
     Calculator calc(3);
 
-    while (1) {
+    // Task loop timing on the console once a minute
+    for (int seconds = 1; ; ++seconds) {
         vTaskDelay(pdMS_TO_TICKS(1000));
+        if (seconds % 60 == 0) {
+            LoopStats::LogAll();
+        }
     }
 
 }
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Timing of the micro-benchmarks: an operation runs iterations times per round, the
+// fastest of ROUNDS rounds counts. Results go through keep() so that the compiler can't
+// drop the work.
+namespace bench {
+
+constexpr const int ROUNDS = 5;
+
+template <typename T>
+inline void keep(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// fn(i) for i = 0..iterations-1, prints and returns ns per call
+template <typename F>
+double run(const char* name, uint32_t iterations, F&& fn)
+{
+    using clock = std::chrono::steady_clock;
+    double best = 1e30;
+    for (int round = 0; round < ROUNDS; ++round) {
+        const auto start = clock::now();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            fn(i);
+        }
+        const std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+        best = std::min(best, elapsed.count() / iterations);
+    }
+    printf("%-36s %9.1f ns\n", name, best);
+    return best;
+}
+
+} // namespace bench
@@ -0,0 +1,93 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "FixedFormat.h"
+#include "bench.h"
+
+// The display's metric lines, "T: %.1f C", "P: %4.0f hPa" and "H: %.1f %%", with
+// snprintf against the FixedFormat chain of format_metric() in EnvironmentMonitor.cpp,
+// on random readings in the sensor's range. Both must give the same text first, except
+// where FixedFormat documents otherwise: exact binary ties and "-0.0".
+
+namespace {
+
+struct MetricFormat {
+    const char* label;
+    int decimals;
+    int width;
+    const char* unit;
+    const char* printf_format;
+    float min;
+    float max;
+};
+
+// As METRIC_FORMATS in EnvironmentMonitor.cpp, with the snprintf they replaced
+constexpr MetricFormat FORMATS[] = {
+    { "T: ", 1, 0, " C",   "T: %.1f C",    -40,  85 },
+    { "P: ", 0, 4, " hPa", "P: %4.0f hPa", 300,  1100 },
+    { "H: ", 1, 0, " %",   "H: %.1f %%",   0,    100 },
+};
+
+constexpr size_t VALUE_COUNT = 4096;
+constexpr size_t LINE_SIZE = 3 + FixedFormat::MAX_FIXED + 4 + 1;
+
+void fixed_line(char* line, const MetricFormat& format, float value)
+{
+    char* p = FixedFormat::Text(line, format.label);
+    p = FixedFormat::Fixed(p, value, format.decimals, format.width);
+    p = FixedFormat::Text(p, format.unit);
+    FixedFormat::End(p);
+}
+
+// Value exactly halfway between two outputs, where printf rounds to even, or a negative
+// value that rounds to zero, where printf keeps the sign
+bool is_exception(float value, int decimals)
+{
+    const double scaled = std::fabs(static_cast<double>(value)) * std::pow(10.0, decimals);
+    return scaled - std::floor(scaled) == 0.5 || (value < 0 && scaled < 0.5);
+}
+
+} // namespace
+
+int main()
+{
+    constexpr uint32_t ITERATIONS = 2000000;
+    std::mt19937 random(1);
+    int failed = 0;
+
+    for (const MetricFormat& format : FORMATS) {
+        std::uniform_real_distribution<float> distribution(format.min, format.max);
+        std::vector<float> values(VALUE_COUNT);
+        int exceptions = 0;
+        for (float& value : values) {
+            value = distribution(random);
+            char expected[LINE_SIZE], line[LINE_SIZE];
+            snprintf(expected, sizeof(expected), format.printf_format, value);
+            fixed_line(line, format, value);
+            if (strcmp(expected, line)) {
+                if (is_exception(value, format.decimals)) {
+                    ++exceptions;
+                    continue;
+                }
+                printf("Mismatch for %.9g: \"%s\" against \"%s\"\n", value, line, expected);
+                ++failed;
+            }
+        }
+
+        printf("\"%s\", %zu values, %d ties or -0\n", format.printf_format, VALUE_COUNT, exceptions);
+        char line[LINE_SIZE];
+        const double printf_ns = bench::run("  snprintf", ITERATIONS, [&](uint32_t i) {
+            snprintf(line, sizeof(line), format.printf_format, values[i % VALUE_COUNT]);
+            bench::keep(line);
+        });
+        const double fixed_ns = bench::run("  FixedFormat", ITERATIONS, [&](uint32_t i) {
+            fixed_line(line, format, values[i % VALUE_COUNT]);
+            bench::keep(line);
+        });
+        printf("%-36s %9.1fx\n", "  speedup", printf_ns / fixed_ns);
+    }
+    return failed ? 1 : 0;
+}
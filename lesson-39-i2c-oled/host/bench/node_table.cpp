@@ -0,0 +1,137 @@
+#include <esp_timer.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "NodeTable.h"
+#include "TopicRouter.h"
+#include "bench.h"
+
+// NodeTable::Update() on replayed messages of remote nodes, "sensors/<node>/<metric>"
+// with a number as payload in random order: all nodes fitting the table, and four times
+// as many nodes as it holds, so that three of four updates evict the oldest node. Then the whole path of
+// a message in EnvironmentMonitor::post_event() and update_node() (filter match, route,
+// node ID, strtof, Update) on the evicting stream, and a replay of that stream paced at
+// 10000 messages per second for 2 s, which measures the busy share of one core.
+
+namespace {
+
+// As in EnvironmentMonitor.cpp
+constexpr TopicRoute REMOTE_ROUTES[] = {
+    { "temp",        "/temp", 3 },
+    { "temperature", "/temp", 3 },
+    { "pres",        "/pres", 4 },
+    { "pressure",    "/pres", 4 },
+    { "hum",         "/hum",  5 },
+    { "humi",        "/hum",  5 },
+    { "humidity",    "/hum",  5 },
+};
+
+constexpr TopicRouter REMOTE_ROUTER(REMOTE_ROUTES);
+static_assert(REMOTE_ROUTER.IsValid());
+
+constexpr int LINE_TEMP = 3;                // Metric = line - LINE_TEMP, as SPARKLINE_PAGE
+constexpr size_t STREAM_SIZE = 1 << 16;
+
+struct Message {
+    std::string topic;
+    std::string data;
+    std::string_view id;                    // Into topic
+    int metric;
+};
+
+std::vector<Message> make_stream(size_t nodes, uint32_t seed)
+{
+    static const char* const METRICS[] = { "temp", "pres", "humi" };
+    static const char* const VALUES[] = { "21.5", "1013", "45.2" };
+
+    std::mt19937 random(seed);
+    std::vector<Message> stream(STREAM_SIZE);
+    for (Message& m : stream) {
+        const int metric = random() % 3;
+        m.topic = "sensors/node" + std::to_string(random() % nodes) + "/" + METRICS[metric];
+        m.data = VALUES[metric];
+        m.metric = metric;
+    }
+    for (Message& m : stream) {
+        m.id = std::string_view(m.topic).substr(0, m.topic.rfind('/'));
+    }
+    return stream;
+}
+
+// update_node() without the log line and with the time given
+void update_node(NodeTable& nodes, const Message& m, int64_t now_us)
+{
+    const std::string_view topic = m.topic;
+    if (!topic_matches(CONFIG_REMOTE_NODES_TOPIC, topic))
+        return;
+
+    auto route = REMOTE_ROUTER.Find(topic);
+    if (const size_t level = topic.rfind('/'); route && level != topic.npos) {
+        char number[16] = {};
+        memcpy(number, m.data.data(), std::min(m.data.size(), sizeof(number) - 1));
+        nodes.Update(topic.substr(0, level), route->line - LINE_TEMP, strtof(number, nullptr), now_us, NodeTable::SOURCE_UPSTREAM);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    constexpr uint32_t ITERATIONS = 4000000;
+    const size_t fitting = NodeTable::CAPACITY * 3 / 4;
+    const size_t evicting = NodeTable::CAPACITY * 4;
+    const std::vector<Message> hits = make_stream(fitting, 1);
+    const std::vector<Message> misses = make_stream(evicting, 2);
+    printf("%zu-node table, %u updates per round, filter \"%s\"\n", NodeTable::CAPACITY, ITERATIONS, CONFIG_REMOTE_NODES_TOPIC);
+
+    static NodeTable table;
+    bench::run(("Update, " + std::to_string(fitting) + " nodes").c_str(), ITERATIONS, [&](uint32_t i) {
+        const Message& m = hits[i % STREAM_SIZE];
+        table.Update(m.id, m.metric, 21.5f, i, NodeTable::SOURCE_UPSTREAM);
+    });
+
+    static NodeTable evicting_table;
+    const uint32_t evicted = evicting_table.Evicted();
+    bench::run(("Update, " + std::to_string(evicting) + " nodes").c_str(), ITERATIONS, [&](uint32_t i) {
+        const Message& m = misses[i % STREAM_SIZE];
+        evicting_table.Update(m.id, m.metric, 21.5f, i, NodeTable::SOURCE_UPSTREAM);
+    });
+    printf("%-36s %9.1f %%\n", "  updates evicting a node", 100.0 * (evicting_table.Evicted() - evicted) / (ITERATIONS * bench::ROUNDS));
+
+    static NodeTable message_table;
+    const double message_ns = bench::run(("Message, " + std::to_string(evicting) + " nodes").c_str(), ITERATIONS, [&](uint32_t i) {
+        update_node(message_table, misses[i % STREAM_SIZE], i);
+    });
+    printf("%-36s %9.0f messages/s\n", "  one core at most", 1e9 / message_ns);
+
+    // Paced replay: 10 messages at every ms, busy time measured around each burst
+    using clock = std::chrono::steady_clock;
+    constexpr int RATE = 10000;
+    constexpr int BURST = RATE / 1000;
+    constexpr int MS = 2000;
+    static NodeTable replay_table;
+    std::chrono::duration<double, std::nano> busy{}, worst{};
+    const auto start = clock::now();
+    uint32_t n = 0;
+    for (int ms = 0; ms < MS; ++ms) {
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(ms));
+        const auto begin = clock::now();
+        for (int i = 0; i < BURST; ++i, ++n) {
+            update_node(replay_table, misses[n % STREAM_SIZE], esp_timer_get_time());
+        }
+        const auto elapsed = clock::now() - begin;
+        busy += elapsed;
+        worst = std::max<std::chrono::duration<double, std::nano>>(worst, elapsed);
+    }
+    const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    printf("replay at %d messages/s: %u messages in %.2f s, %.2f %% busy, %.1f ns per message, worst burst of %d %.1f us\n",
+        RATE, n, seconds, 100.0 * busy.count() / (seconds * 1e9), busy.count() / n, BURST, worst.count() / 1000);
+    return 0;
+}
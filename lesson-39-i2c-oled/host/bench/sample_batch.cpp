@@ -0,0 +1,268 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mqtt_client.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "host.h"
+#include "FixedFormat.h"
+#include "SampleBatch.h"
+#include "bench.h"
+
+// Packed payloads (SampleBatch) against the text format of one message per metric:
+// a decoder of the layout in SampleBatch.h that checks every encoded sample, the cost of
+// encoding and decoding, and samples per second through the in-process broker from one
+// publishing client to one subscriber, with the MQTT bytes each takes.
+
+namespace {
+
+struct Record {
+    uint32_t seq;
+    uint32_t time;
+    int16_t temp;
+    uint16_t pres;
+    uint16_t humi;
+    uint8_t flags;
+};
+
+uint16_t le16(const uint8_t* p)
+{
+    return p[0] | p[1] << 8;
+}
+
+uint32_t le32(const uint8_t* p)
+{
+    return le16(p) | static_cast<uint32_t>(le16(p + 2)) << 16;
+}
+
+// Appends the payload's records, false for a payload that doesn't follow the layout.
+// Records longer than the known fields are accepted, as SampleBatch.h promises.
+bool decode(const uint8_t* data, size_t size, std::vector<Record>* records)
+{
+    if (size < SampleBatch::HEADER_SIZE || data[0] != SampleBatch::PAYLOAD_VERSION)
+        return false;
+    const size_t count = data[1];
+    const size_t record_size = data[2];
+    if (record_size < 14 || size != SampleBatch::HEADER_SIZE + count * record_size)
+        return false;
+
+    for (const uint8_t* p = data + SampleBatch::HEADER_SIZE; p < data + size; p += record_size) {
+        records->push_back({
+            .seq = le32(p),
+            .time = le32(p + 4),
+            .temp = static_cast<int16_t>(le16(p + 8)),
+            .pres = le16(p + 10),
+            .humi = le16(p + 12),
+            .flags = p[14],
+        });
+    }
+    return true;
+}
+
+std::vector<SensorSampler::Sample> make_samples(size_t count)
+{
+    std::minstd_rand random(13);
+    std::normal_distribution<float> noise(0, 1);
+    std::vector<SensorSampler::Sample> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto& s = samples[i];
+        s.seq = i;
+        s.mono_us = i * 1000000LL;
+        s.time = 1790000000 + i;
+        s.valid = true;
+        s.temp = 21.5f + 2 * std::sin(i / 100.f) + 0.05f * noise(random);
+        s.pres = 101325.f + 150 * std::sin(i / 1000.f) + 2 * noise(random);
+        s.humi = i % 97 ? 45.f + 5 * std::sin(i / 300.f) + 0.1f * noise(random) : NAN;
+    }
+    return samples;
+}
+
+// Within half a unit of the fixed-point scale, plus float rounding
+bool check(const SensorSampler::Sample& s, const Record& r)
+{
+    const uint8_t flags = SampleBatch::FLAG_TEMP | SampleBatch::FLAG_PRES | (std::isnan(s.humi) ? 0 : SampleBatch::FLAG_HUMI);
+    return r.seq == s.seq && r.time == s.time && r.flags == flags
+        && std::fabs(r.temp / 100.f - s.temp) <= 0.0051f
+        && std::fabs(r.pres * 10.f - s.pres) <= 5.01f
+        && ((r.flags & SampleBatch::FLAG_HUMI) == 0 || std::fabs(r.humi / 100.f - s.humi) <= 0.0051f);
+}
+
+// Bytes of an MQTT 3.1.1 QoS 0 PUBLISH packet
+size_t publish_size(size_t topic_len, size_t payload_len)
+{
+    const size_t remaining = 2 + topic_len + payload_len;
+    return 1 + (remaining < 128 ? 1 : remaining < 16384 ? 2 : 3) + remaining;
+}
+
+// Subscriber side of the broker run
+std::atomic<uint32_t> s_received = 0;
+std::atomic<uint32_t> s_received_samples = 0;
+std::atomic<bool> s_connected = false;
+
+void on_event(void* arg, esp_event_base_t base, int32_t event_id, void* event_data)
+{
+    auto event = static_cast<esp_mqtt_event_handle_t>(event_data);
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        s_connected = true;
+    }
+    else if (event_id == MQTT_EVENT_DATA) {
+        ++s_received;
+        if (event->topic_len == 13 && !memcmp(event->topic, "node/1/packed", 13)) {
+            std::vector<Record> records;
+            decode(reinterpret_cast<const uint8_t*>(event->data), event->data_len, &records);
+            s_received_samples += records.size();
+        }
+        else if (event->topic_len == 11 && !memcmp(event->topic, "node/1/humi", 11)) {
+            // Last message of a text sample
+            ++s_received_samples;
+        }
+    }
+}
+
+esp_mqtt_client_handle_t start_client(const char* id, bool subscriber)
+{
+    s_connected = false;
+    auto client = host_mqtt_client_init(id);
+    esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, subscriber ? on_event : [](void*, esp_event_base_t, int32_t id, void*) {
+        if (id == MQTT_EVENT_CONNECTED)
+            s_connected = true;
+    }, nullptr);
+    esp_mqtt_client_start(client);
+    while (!s_connected) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return client;
+}
+
+// Publishes every sample, text or in batches of batch_size, keeping at most WINDOW
+// messages in flight so that the broker's queue never drops. Returns samples per second.
+double broker_run(const std::vector<SensorSampler::Sample>& samples, int batch_size, esp_mqtt_client_handle_t publisher, size_t* bytes)
+{
+    constexpr uint32_t WINDOW = 256;
+    s_received = 0;
+    s_received_samples = 0;
+    uint32_t sent = 0;
+    *bytes = 0;
+
+    auto wait_window = [&] {
+        while (sent - s_received >= WINDOW) {
+            std::this_thread::yield();
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    if (batch_size) {
+        SampleBatch batch(batch_size);
+        for (const auto& sample : samples) {
+            if (batch.Add(sample)) {
+                wait_window();
+                esp_mqtt_client_publish(publisher, "node/1/packed", reinterpret_cast<const char*>(batch.Data()), batch.Size(), 0, 0);
+                *bytes += publish_size(13, batch.Size());
+                ++sent;
+                batch.Clear();
+            }
+        }
+    }
+    else {
+        char value[FixedFormat::MAX_FIXED];
+        const char* end;
+        for (const auto& sample : samples) {
+            wait_window();
+            end = FixedFormat::Fixed(value, sample.temp, 1);
+            esp_mqtt_client_publish(publisher, "node/1/temp", value, end - value, 0, 0);
+            *bytes += publish_size(11, end - value);
+            end = FixedFormat::Unsigned(value, (uint32_t) (sample.pres / 100.f));
+            esp_mqtt_client_publish(publisher, "node/1/pres", value, end - value, 0, 0);
+            *bytes += publish_size(11, end - value);
+            end = FixedFormat::Fixed(value, sample.humi, 1);
+            esp_mqtt_client_publish(publisher, "node/1/humi", value, end - value, 0, 0);
+            *bytes += publish_size(11, end - value);
+            sent += 3;
+        }
+    }
+    while (s_received < sent) {
+        std::this_thread::yield();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return s_received_samples / elapsed.count();
+}
+
+} // namespace
+
+int main()
+{
+    const auto samples = make_samples(32 * 4096);
+
+    // Every sample must come back out of the decoder, for every batch size
+    for (int batch_size = 1; batch_size <= SampleBatch::MAX_SAMPLES; ++batch_size) {
+        SampleBatch batch(batch_size);
+        std::vector<Record> records;
+        for (const auto& sample : samples) {
+            if (batch.Add(sample)) {
+                if (!decode(batch.Data(), batch.Size(), &records)) {
+                    printf("Batch size %d: payload not decodable\n", batch_size);
+                    return 1;
+                }
+                batch.Clear();
+            }
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (!check(samples[i], records[i])) {
+                printf("Batch size %d: sample %zu decoded wrong\n", batch_size, i);
+                return 1;
+            }
+        }
+    }
+    printf("Decoder checked on %zu samples, batch sizes 1..%d\n\n", samples.size(), SampleBatch::MAX_SAMPLES);
+
+    // Cost per sample
+    const uint32_t count = samples.size();
+    SampleBatch batch(SampleBatch::MAX_SAMPLES);
+    bench::run("SampleBatch::Add per sample", count, [&](uint32_t i) {
+        if (batch.Add(samples[i])) {
+            bench::keep(batch.Data()[batch.Size() - 1]);
+            batch.Clear();
+        }
+    });
+    char text[3][FixedFormat::MAX_FIXED];
+    bench::run("Text format per sample", count, [&](uint32_t i) {
+        bench::keep(FixedFormat::Fixed(text[0], samples[i].temp, 1));
+        bench::keep(FixedFormat::Unsigned(text[1], (uint32_t) (samples[i].pres / 100.f)));
+        bench::keep(FixedFormat::Fixed(text[2], samples[i].humi, 1));
+    });
+    std::vector<Record> records;
+    records.reserve(SampleBatch::MAX_SAMPLES);
+    for (const auto& sample : samples) {
+        if (batch.Add(sample))
+            break;
+    }
+    bench::run("Decode per batch of 32", count / SampleBatch::MAX_SAMPLES, [&](uint32_t i) {
+        records.clear();
+        decode(batch.Data(), batch.Size(), &records);
+        bench::keep(records.back().seq);
+    });
+    printf("\n");
+
+    // Through the broker
+    auto subscriber = start_client("bench-subscriber", true);
+    esp_mqtt_client_subscribe(subscriber, "node/1/#", 0);
+    auto publisher = start_client("bench-publisher", false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    printf("%-20s %12s %14s\n", "Broker, 1 -> 1", "samples/s", "bytes/sample");
+    for (int batch_size : { 0, 1, 4, 16, 32 }) {
+        size_t bytes;
+        const double rate = broker_run(samples, batch_size, publisher, &bytes);
+        char name[32];
+        snprintf(name, sizeof(name), batch_size ? "packed, batch %d" : "text", batch_size);
+        printf("%-20s %12.0f %14.1f\n", name, rate, (double) bytes / samples.size());
+    }
+    fflush(stdout);
+    _exit(0);
+}
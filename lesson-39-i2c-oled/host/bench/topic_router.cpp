@@ -0,0 +1,85 @@
+#include <cstring>
+#include <string_view>
+
+#include "TopicRouter.h"
+#include "bench.h"
+
+// TopicRouter::Find() against the strstr chain remote mode had before it (three
+// std::string_view::find() calls per message), on a mix of topics of the monitor's
+// subscriptions. Both must pick the same line for every topic first.
+
+namespace {
+
+// As in EnvironmentMonitor.cpp
+constexpr TopicRoute REMOTE_ROUTES[] = {
+    { "temp",        "/temp", 3 },
+    { "temperature", "/temp", 3 },
+    { "pres",        "/pres", 4 },
+    { "pressure",    "/pres", 4 },
+    { "hum",         "/hum",  5 },
+    { "humi",        "/hum",  5 },
+    { "humidity",    "/hum",  5 },
+};
+
+constexpr TopicRouter REMOTE_ROUTER(REMOTE_ROUTES);
+static_assert(REMOTE_ROUTER.IsValid());
+
+const char* const TOPICS[] = {
+    "node/2/temp",
+    "node/2/pres",
+    "node/2/humi",
+    "sensors/kitchen/temperature",
+    "sensors/kitchen/pressure",
+    "sensors/kitchen/humidity",
+    "home/floor1/livingroom/node17/temp",
+    "home/floor1/livingroom/node17/hum",
+    "node/2/status",
+    "node/2/control/state",
+    "sensors/garage/battery",
+    "home/floor1/livingroom/node17/rssi",
+};
+constexpr size_t TOPIC_COUNT = sizeof(TOPICS) / sizeof(TOPICS[0]);
+
+// The chain of the old update_task(): a later match overwrote an earlier one's line
+int strstr_line(std::string_view topic)
+{
+    int line = -1;
+    if (topic.find("/temp") != topic.npos)
+        line = 3;
+    if (topic.find("/pres") != topic.npos)
+        line = 4;
+    if (topic.find("/hum") != topic.npos)
+        line = 5;
+    return line;
+}
+
+int router_line(std::string_view topic)
+{
+    auto route = REMOTE_ROUTER.Find(topic);
+    return route ? route->line : -1;
+}
+
+} // namespace
+
+int main()
+{
+    std::string_view topics[TOPIC_COUNT];
+    for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        topics[i] = TOPICS[i];
+        if (strstr_line(topics[i]) != router_line(topics[i])) {
+            printf("Mismatch for %s: strstr %d, router %d\n", TOPICS[i], strstr_line(topics[i]), router_line(topics[i]));
+            return 1;
+        }
+    }
+
+    constexpr uint32_t ITERATIONS = 10000000;
+    printf("%zu topics, %u lookups per round\n", TOPIC_COUNT, ITERATIONS);
+    const double chain = bench::run("strstr chain", ITERATIONS, [&](uint32_t i) {
+        bench::keep(strstr_line(topics[i % TOPIC_COUNT]));
+    });
+    const double router = bench::run("TopicRouter::Find", ITERATIONS, [&](uint32_t i) {
+        bench::keep(router_line(topics[i % TOPIC_COUNT]));
+    });
+    printf("%-36s %9.1fx\n", "speedup", chain / router);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include <esp_rom_crc.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "HistoryLog.h"
+#include "SeriesBlock.h"
+
+// Decodes the history partition (HistoryLog slots of SeriesBlocks) and reports what the
+// compression saves on the recorded readings. The input is a partition image: history.bin
+// of the host build's --state directory, or the target's partition read with
+// "esptool.py read_flash <offset> <size> history.bin". With --frames it is the upload
+// stream as tools/history_server.py saves it instead. Bits per reading are split by
+// field, recomputed from the decoded values with the encoder's buckets.
+
+namespace {
+
+// Payload widths after the 0 / 10 / 110 / 1110 / 1111 prefixes, as in SeriesBlock.cpp
+constexpr int TIME_WIDTHS[] = { 0, 7, 9, 12, 32 };
+constexpr int VALUE_WIDTHS[] = { 0, 4, 8, 16, 32 };
+
+int bucket_bits(const int* widths, int32_t value)
+{
+    const uint32_t zigzag = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    for (int bucket = 0; bucket < 5; ++bucket) {
+        if (widths[bucket] == 32 || !(zigzag >> widths[bucket]))
+            return (bucket < 4 ? bucket + 1 : bucket) + widths[bucket];
+    }
+    return 0;
+}
+
+int32_t wrapping_sub(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+
+struct Totals {
+    uint32_t blocks = 0;
+    uint32_t bad = 0;
+    uint64_t readings = 0;
+    uint64_t bytes = 0;             // Block sizes, slot headers and padding not included
+    uint64_t bits[4] = {};          // Time, temperature, pressure, humidity
+    uint32_t missing = 0;           // Readings without humidity
+};
+
+void decode_block(uint32_t seq, const uint8_t* data, size_t size, bool verbose, Totals* totals)
+{
+    SeriesBlock::Reader reader(data, size);
+    if (!reader.IsValid()) {
+        printf("block %" PRIu32 ": not a SeriesBlock\n", seq);
+        ++totals->bad;
+        return;
+    }
+
+    SeriesBlock::Point point, last = {};
+    int32_t last_delta = 0;
+    uint64_t bits[4] = {};
+    uint32_t count = 0;
+    while (reader.Next(&point)) {
+        if (count) {
+            const int32_t delta = wrapping_sub(point.time, last.time);
+            bits[0] += bucket_bits(TIME_WIDTHS, wrapping_sub(delta, last_delta));
+            bits[1] += bucket_bits(VALUE_WIDTHS, wrapping_sub(point.temp, last.temp));
+            bits[2] += bucket_bits(VALUE_WIDTHS, wrapping_sub(point.pres, last.pres));
+            bits[3] += bucket_bits(VALUE_WIDTHS, wrapping_sub(point.humi, last.humi));
+            last_delta = delta;
+        }
+        if (verbose) {
+            printf("  %" PRIu32 "  %7.2f C  %6" PRId32 " Pa  ", point.time, point.temp / 100.0, point.pres);
+            if (point.humi == SeriesBlock::MISSING)
+                printf("     - %%\n");
+            else
+                printf("%6.2f %%\n", point.humi / 100.0);
+        }
+        totals->missing += point.humi == SeriesBlock::MISSING;
+        last = point;
+        ++count;
+    }
+    if (!reader.IsValid() || count != reader.Count()) {
+        printf("block %" PRIu32 ": truncated after %" PRIu32 " of %u readings\n", seq, count, reader.Count());
+        ++totals->bad;
+        return;
+    }
+
+    printf("block %" PRIu32 ": %u readings in %zu bytes, %.1f bits each\n", seq, reader.Count(), size, 8.0 * size / reader.Count());
+    ++totals->blocks;
+    totals->readings += count;
+    totals->bytes += size;
+    for (int i = 0; i < 4; ++i) {
+        totals->bits[i] += bits[i];
+    }
+}
+
+void report(const Totals& totals)
+{
+    if (!totals.readings) {
+        printf("No readings\n");
+        return;
+    }
+
+    const double n = totals.readings;
+    const uint64_t stream = totals.bits[0] + totals.bits[1] + totals.bits[2] + totals.bits[3];
+    const uint64_t header = 8 * totals.bytes - stream;
+    printf("\n%" PRIu32 " blocks, %" PRIu64 " readings (%" PRIu32 " without humidity), %" PRIu64 " bytes",
+        totals.blocks, totals.readings, totals.missing, totals.bytes);
+    if (totals.bad) {
+        printf(", %" PRIu32 " blocks not decodable", totals.bad);
+    }
+    printf("\nbits per reading: %.2f = time %.2f + temp %.2f + pres %.2f + humi %.2f + block header and padding %.2f\n",
+        8.0 * totals.bytes / n, totals.bits[0] / n, totals.bits[1] / n, totals.bits[2] / n, totals.bits[3] / n, header / n);
+    printf("compression ratio: %.1fx against %zu-byte points, %.1fx with the %zu-byte slot headers\n",
+        sizeof(SeriesBlock::Point) * n / totals.bytes, sizeof(SeriesBlock::Point),
+        sizeof(SeriesBlock::Point) * n / (totals.bytes + totals.blocks * HistoryLog::HEADER_SIZE), HistoryLog::HEADER_SIZE);
+}
+
+uint32_t le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool verbose = false;
+    bool frames = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!strcmp(argv[i], "--frames"))
+            frames = true;
+        else if (!path)
+            path = argv[i];
+        else
+            path = nullptr, i = argc;
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [-v] [--frames] history.bin\n"
+            "  -v        print every reading\n"
+            "  --frames  file of uploaded frames { u32 seq, u16 size, block }, not a partition\n", argv[0]);
+        return 2;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> image;
+    uint8_t chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+        image.insert(image.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    // Blocks in sequence order, offset is that of the block's data
+    struct Block {
+        uint32_t seq;
+        size_t offset;
+        uint16_t size;
+    };
+    std::vector<Block> stored;
+    if (frames) {
+        // A block sent again, after the server rewound, replaces the earlier copy
+        constexpr size_t FRAME_HEADER_SIZE = 6;
+        for (size_t offset = 0; offset + FRAME_HEADER_SIZE <= image.size();) {
+            const uint8_t* p = image.data() + offset;
+            const Block b = { le32(p), offset + FRAME_HEADER_SIZE, static_cast<uint16_t>(p[4] | p[5] << 8) };
+            if (b.size > HistoryLog::BLOCK_SIZE || b.offset + b.size > image.size()) {
+                printf("frame at %zu: bad size %u\n", offset, b.size);
+                break;
+            }
+            auto same = std::find_if(stored.begin(), stored.end(), [&](const Block& s) { return s.seq == b.seq; });
+            if (same != stored.end())
+                *same = b;
+            else
+                stored.push_back(b);
+            offset = b.offset + b.size;
+        }
+    }
+    else {
+        // Slot headers as HistoryLog writes them
+        const uint32_t slots = image.size() / HistoryLog::SLOT_SIZE;
+        for (uint32_t slot = 0; slot < slots; ++slot) {
+            const uint8_t* p = image.data() + slot * HistoryLog::SLOT_SIZE;
+            const Block b = { le32(p), slot * HistoryLog::SLOT_SIZE + HistoryLog::HEADER_SIZE, static_cast<uint16_t>(p[4] | p[5] << 8) };
+            if (b.seq == UINT32_MAX || b.seq % slots != slot || b.size > HistoryLog::BLOCK_SIZE)
+                continue;
+
+            const uint16_t crc = esp_rom_crc16_le(esp_rom_crc16_le(0, p, 6), p + HistoryLog::HEADER_SIZE, b.size);
+            if (crc != (p[6] | p[7] << 8)) {
+                printf("block %" PRIu32 ": CRC error\n", b.seq);
+                continue;
+            }
+            stored.push_back(b);
+        }
+    }
+    std::sort(stored.begin(), stored.end(), [](const Block& a, const Block& b) { return a.seq < b.seq; });
+
+    Totals totals;
+    for (const Block& b : stored) {
+        decode_block(b.seq, image.data() + b.offset, b.size, verbose, &totals);
+    }
+    report(totals);
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <bmp280.h>
+#include <esp_event.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "host.h"
+#include "mqtt_creds.h"
+#include "EnvironmentMonitor.h"
+#include "LoopStats.h"
+
+// The monitor on Linux: app_main() as on the target, plus a load generator publishing to
+// the monitor's subscriptions, an observer of what it publishes and scripted button,
+// encoder and Wi-Fi events. At the end it prints the loop histograms and the counters of
+// the fake hardware. See Readme.txt for the options.
+
+namespace {
+
+constexpr const char* TAG = "host_main";
+
+struct Options {
+    int seconds = 30;
+    int rate = 100;                 // Messages per second of the load generator, 0 for none
+    int topics = 8;                 // Topics under MQTT_SUB_TOPIC
+    int nodes = 0;                  // Nodes under CONFIG_REMOTE_NODES_TOPIC
+    int publish_fail = 0;           // Per mille of the station's publishes that fail
+    int click_s = 0;                // Seconds between button clicks, 0 for none
+    int turn_s = 0;                 // Seconds between encoder turns, 0 for none
+    int wifi_drop_s = 0;            // Seconds between Wi-Fi drops, 0 for none
+    const char* state = nullptr;
+    bool bmp280 = false;            // BMP280 instead of BME280
+    bool quiet = false;
+};
+
+Options s_options;
+std::atomic<uint32_t> s_observed = 0;
+std::atomic<uint64_t> s_observed_bytes = 0;
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --seconds N        run time (30)\n"
+        "  --rate N           load generator messages per second, 0 for none (100)\n"
+        "  --topics N         topics under " MQTT_SUB_TOPIC " (8)\n"
+        "  --nodes N          nodes under CONFIG_REMOTE_NODES_TOPIC (0)\n"
+        "  --publish-fail N   per mille of the monitor's publishes that fail (0)\n"
+        "  --click N          click the button every N seconds\n"
+        "  --turn N           turn the encoder every N seconds\n"
+        "  --wifi-drop N      drop Wi-Fi for 2 s every N seconds\n"
+        "  --state DIR        keep NVS, history and EEPROM in DIR across runs\n"
+        "  --bmp280           BMP280 sensor, without humidity, instead of BME280\n"
+        "  -q                 log warnings and errors only\n",
+        name);
+    exit(2);
+}
+
+void parse(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        auto number = [&] {
+            if (i + 1 >= argc)
+                usage(argv[0]);
+            return atoi(argv[++i]);
+        };
+
+        if (!strcmp(arg, "--seconds"))
+            s_options.seconds = number();
+        else if (!strcmp(arg, "--rate"))
+            s_options.rate = number();
+        else if (!strcmp(arg, "--topics"))
+            s_options.topics = number();
+        else if (!strcmp(arg, "--nodes"))
+            s_options.nodes = number();
+        else if (!strcmp(arg, "--publish-fail"))
+            s_options.publish_fail = number();
+        else if (!strcmp(arg, "--click"))
+            s_options.click_s = number();
+        else if (!strcmp(arg, "--turn"))
+            s_options.turn_s = number();
+        else if (!strcmp(arg, "--wifi-drop"))
+            s_options.wifi_drop_s = number();
+        else if (!strcmp(arg, "--state") && i + 1 < argc)
+            s_options.state = argv[++i];
+        else if (!strcmp(arg, "--bmp280"))
+            s_options.bmp280 = true;
+        else if (!strcmp(arg, "-q"))
+            s_options.quiet = true;
+        else
+            usage(argv[0]);
+    }
+    if (s_options.topics < 1) {
+        s_options.topics = 1;
+    }
+}
+
+// app_main() of the target
+void main_task(void* arg)
+{
+    setenv("TZ", CONFIG_LOCAL_TIMEZONE, 1);
+    tzset();
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    // Never destroyed, the process ends with _exit() while it runs
+    new EnvironmentMonitor();
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+void on_observer_event(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    auto event = static_cast<esp_mqtt_event_handle_t>(event_data);
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        esp_mqtt_client_subscribe(event->client, MQTT_PUB_TOPIC "/#", 1);
+    }
+    else if (event_id == MQTT_EVENT_DATA) {
+        ++s_observed;
+        s_observed_bytes += event->data_len;
+    }
+}
+
+// Sensor-like values on --topics topics and --nodes remote nodes, spread evenly over the
+// second
+void load_generator(esp_mqtt_client_handle_t client)
+{
+    using clock = std::chrono::steady_clock;
+    static const char* const METRICS[] = { "temp", "pres", "humi" };
+
+    const int node_topics = *CONFIG_REMOTE_NODES_TOPIC ? s_options.nodes * 3 : 0;
+    const auto period = std::chrono::nanoseconds(1000000000LL / s_options.rate);
+    auto next = clock::now();
+    for (uint32_t n = 0;; ++n) {
+        next += period;
+        std::this_thread::sleep_until(next);
+
+        char topic[64];
+        char data[32];
+        const uint32_t slot = n % (s_options.topics + node_topics);
+        if (slot < (uint32_t) s_options.topics) {
+            snprintf(topic, sizeof(topic), "node/2/t%lu", (unsigned long) slot);
+        }
+        else {
+            const uint32_t index = slot - s_options.topics;
+            snprintf(topic, sizeof(topic), "sensors/n%lu/%s", (unsigned long) index / 3, METRICS[index % 3]);
+        }
+        const int len = snprintf(data, sizeof(data), "%.2f", 20.0 + (n % 1000) / 100.0);
+        esp_mqtt_client_publish(client, topic, data, len, 0, 0);
+    }
+}
+
+// Button clicks, encoder turns and Wi-Fi drops at the given intervals
+void script()
+{
+    int64_t next_click = s_options.click_s;
+    int64_t next_turn = s_options.turn_s;
+    int64_t next_drop = s_options.wifi_drop_s;
+    for (int64_t s = 1;; ++s) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (s_options.click_s && s >= next_click) {
+            host_gpio_set_input(static_cast<gpio_num_t>(CONFIG_PIN_DEVKIT_BUTTON), 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(80));
+            host_gpio_set_input(static_cast<gpio_num_t>(CONFIG_PIN_DEVKIT_BUTTON), 1);
+            next_click += s_options.click_s;
+        }
+        if (s_options.turn_s && s >= next_turn) {
+            host_encoder_turn(s / s_options.turn_s % 2 ? 3 : -3);
+            next_turn += s_options.turn_s;
+        }
+        if (s_options.wifi_drop_s && s >= next_drop) {
+            host_wifi_drop(2000);
+            next_drop += s_options.wifi_drop_s;
+        }
+    }
+}
+
+void print_histogram(const char* name, const char* kind, const LoopStats::Histogram& histogram)
+{
+    printf("%-16s %-4s n=%-8lu max=%-8lu us ", name, kind, (unsigned long) histogram.count, (unsigned long) histogram.max_us);
+    int last = LoopStats::BUCKETS - 1;
+    while (last > 0 && !histogram.buckets[last]) {
+        --last;
+    }
+    for (int i = 0; i <= last; ++i) {
+        printf("%s%lu", i ? " " : "[", (unsigned long) histogram.buckets[i]);
+    }
+    printf("]\n");
+}
+
+void report(esp_mqtt_client_handle_t load, esp_mqtt_client_handle_t observer, double seconds)
+{
+    printf("\n--- %.1f s\n", seconds);
+    LoopStats::ForEach([](const LoopStats& stats) {
+        LoopStats::Histogram run, late;
+        stats.Read(&run, &late);
+        print_histogram(stats.Name(), "run", run);
+        print_histogram(stats.Name(), "late", late);
+    });
+
+    host_mqtt_stats_t mqtt;
+    if (load) {
+        host_mqtt_stats(load, &mqtt);
+        printf("load generator   published=%lu failed=%lu (%.0f/s)\n", (unsigned long) mqtt.published,
+            (unsigned long) mqtt.failed, mqtt.published / seconds);
+    }
+    host_mqtt_stats(observer, &mqtt);
+    printf("observer         delivered=%lu (%.1f/s, %llu bytes) dropped=%lu queue_peak=%lu\n",
+        (unsigned long) s_observed.load(), s_observed / seconds, (unsigned long long) s_observed_bytes.load(),
+        (unsigned long) mqtt.dropped, (unsigned long) mqtt.queue_peak);
+
+    host_oled_stats_t oled;
+    host_oled_stats(&oled);
+    printf("oled             images=%lu (%.1f/s) bytes=%llu (%.0f/s)\n", (unsigned long) oled.transactions,
+        oled.transactions / seconds, (unsigned long long) oled.bytes, oled.bytes / seconds);
+
+    host_i2c_stats_t i2c;
+    host_i2c_stats(&i2c);
+    printf("i2c              transactions=%lu busy=%.1f%%\n", (unsigned long) i2c.transactions,
+        i2c.busy_us / (seconds * 1e4));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    parse(argc, argv);
+    if (s_options.quiet) {
+        esp_log_level_set("*", ESP_LOG_WARN);
+    }
+    if (s_options.state) {
+        host_set_state_dir(s_options.state);
+    }
+    host_mqtt_set_publish_fail(s_options.publish_fail);
+    if (s_options.bmp280) {
+        host_bmp280_set_chip(BMP280_CHIP_ID);
+    }
+
+    const int64_t start_us = esp_timer_get_time();
+    xTaskCreatePinnedToCore(main_task, "main", 8192, nullptr, 1, nullptr, 0);
+
+    esp_mqtt_client_handle_t observer = host_mqtt_client_init("host-observer");
+    esp_mqtt_client_register_event(observer, MQTT_EVENT_ANY, on_observer_event, nullptr);
+    esp_mqtt_client_start(observer);
+
+    esp_mqtt_client_handle_t load = nullptr;
+    if (s_options.rate > 0) {
+        load = host_mqtt_client_init("host-load");
+        esp_mqtt_client_start(load);
+        std::thread(load_generator, load).detach();
+    }
+    std::thread(script).detach();
+
+    ESP_LOGI(TAG, "Running for %d s", s_options.seconds);
+    std::this_thread::sleep_for(std::chrono::seconds(s_options.seconds));
+
+    report(load, observer, (esp_timer_get_time() - start_us) / 1e6);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+}
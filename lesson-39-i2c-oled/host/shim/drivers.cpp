@@ -0,0 +1,580 @@
+#include <driver/gpio.h>
+#include <driver/gpio_filter.h>
+#include <driver/gptimer.h>
+#include <driver/pulse_cnt.h>
+#include <rom/gpio.h>
+#include <esp_log.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "host.h"
+#include "shim.h"
+
+// GPIO, pulse counter and general purpose timers. Their callbacks run one at a time under
+// s_isr, as interrupts of one core would, and inside shim::IsrScope.
+
+struct gpio_glitch_filter_t {
+    int unused;
+};
+
+struct pcnt_unit_t {
+    pcnt_unit_config_t config;
+    pcnt_event_callbacks_t callbacks = {};
+    void* user_data = nullptr;
+    std::vector<int> watch_points;
+    bool enabled = false;
+    bool running = false;
+    int raw = 0;                            // Count within the limits
+    int accumulated = 0;                    // Overflows at the limits, with accum_count
+};
+
+struct pcnt_chan_t {
+    pcnt_unit_t* unit;
+};
+
+struct gptimer_t {
+    gptimer_config_t config;
+    gptimer_alarm_config_t alarm = {};
+    gptimer_event_callbacks_t callbacks = {};
+    void* user_data = nullptr;
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::thread thread;
+    bool enabled = false;
+    bool running = false;
+    bool alarm_set = false;
+    uint64_t count = 0;                     // Count at start_time
+    std::chrono::steady_clock::time_point start_time;
+    uint32_t generation = 0;                // Changes on start, stop and count changes
+};
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+std::recursive_mutex s_isr;
+
+// Pins
+
+std::mutex s_gpio_lock;
+uint8_t s_levels[GPIO_NUM_MAX];
+bool s_isr_service = false;
+gpio_isr_t s_handlers[GPIO_NUM_MAX];
+void* s_handler_args[GPIO_NUM_MAX];
+bool s_intr_enabled[GPIO_NUM_MAX];
+
+__attribute__((constructor)) void init_levels()
+{
+    for (auto& level : s_levels) {
+        level = 1;                          // Pulled up
+    }
+}
+
+bool valid_pin(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+// Pulse counters
+
+std::mutex s_pcnt_lock;
+std::vector<pcnt_unit_t*> s_units;
+
+// Timers
+
+uint64_t timer_count(gptimer_t* timer, clock::time_point now)
+{
+    if (!timer->running)
+        return timer->count;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - timer->start_time);
+    return timer->count + elapsed.count() * timer->config.resolution_hz / 1000000000;
+}
+
+clock::time_point alarm_time(gptimer_t* timer)
+{
+    const uint64_t ticks = timer->alarm.alarm_count > timer->count ? timer->alarm.alarm_count - timer->count : 0;
+    return timer->start_time + std::chrono::nanoseconds(ticks * 1000000000 / timer->config.resolution_hz);
+}
+
+void timer_thread(gptimer_t* timer)
+{
+    std::unique_lock lock(timer->lock);
+    while (timer->enabled) {
+        if (!timer->running || !timer->alarm_set) {
+            timer->cv.wait(lock);
+            continue;
+        }
+
+        const uint32_t generation = timer->generation;
+        const auto when = alarm_time(timer);
+        if (timer->cv.wait_until(lock, when) != std::cv_status::timeout && clock::now() < when)
+            continue;
+        if (generation != timer->generation || !timer->running)
+            continue;
+
+        // Alarm: reload and carry on from the alarm's time, so that periods don't drift
+        gptimer_alarm_event_data_t data = {
+            .count_value = timer->alarm.alarm_count,
+            .alarm_value = timer->alarm.alarm_count,
+        };
+        if (timer->alarm.flags.auto_reload_on_alarm) {
+            timer->count = timer->alarm.reload_count;
+            timer->start_time = when;
+        }
+        else {
+            timer->alarm_set = false;
+        }
+
+        auto callback = timer->callbacks.on_alarm;
+        lock.unlock();
+        if (callback) {
+            std::lock_guard isr(s_isr);
+            shim::IsrScope scope;
+            callback(timer, &data, timer->user_data);
+        }
+        lock.lock();
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+// GPIO
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+    if (config->pin_bit_mask >> GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_gpio_lock);
+    s_intr_enabled[gpio_num] = false;
+    s_levels[gpio_num] = 1;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_gpio_lock);
+    s_levels[gpio_num] = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return 0;
+
+    std::lock_guard lock(s_gpio_lock);
+    return s_levels[gpio_num];
+}
+
+esp_err_t gpio_pullup_en(gpio_num_t gpio_num)
+{
+    return valid_pin(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    std::lock_guard lock(s_gpio_lock);
+    if (s_isr_service)
+        return ESP_ERR_INVALID_STATE;
+    s_isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void* args)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_gpio_lock);
+    if (!s_isr_service)
+        return ESP_ERR_INVALID_STATE;
+    s_handlers[gpio_num] = isr_handler;
+    s_handler_args[gpio_num] = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_gpio_lock);
+    s_handlers[gpio_num] = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_gpio_lock);
+    s_intr_enabled[gpio_num] = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_gpio_lock);
+    s_intr_enabled[gpio_num] = false;
+    return ESP_OK;
+}
+
+void gpio_output_set(uint32_t set_mask, uint32_t clear_mask, uint32_t enable_mask, uint32_t disable_mask)
+{
+    std::lock_guard lock(s_gpio_lock);
+    for (int pin = 0; pin < 32; ++pin) {
+        if (set_mask & (1u << pin)) {
+            s_levels[pin] = 1;
+        }
+        if (clear_mask & (1u << pin)) {
+            s_levels[pin] = 0;
+        }
+    }
+}
+
+// Glitch filters
+
+esp_err_t gpio_new_pin_glitch_filter(const gpio_pin_glitch_filter_config_t* config, gpio_glitch_filter_handle_t* ret_filter)
+{
+    *ret_filter = new gpio_glitch_filter_t {};
+    return ESP_OK;
+}
+
+esp_err_t gpio_del_glitch_filter(gpio_glitch_filter_handle_t filter)
+{
+    delete filter;
+    return ESP_OK;
+}
+
+esp_err_t gpio_glitch_filter_enable(gpio_glitch_filter_handle_t filter)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_glitch_filter_disable(gpio_glitch_filter_handle_t filter)
+{
+    return ESP_OK;
+}
+
+// Pulse counter
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t* config, pcnt_unit_handle_t* ret_unit)
+{
+    if (config->low_limit >= 0 || config->high_limit <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    auto unit = new pcnt_unit_t { .config = *config };
+    std::lock_guard lock(s_pcnt_lock);
+    s_units.push_back(unit);
+    *ret_unit = unit;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit)
+{
+    {
+        std::lock_guard lock(s_pcnt_lock);
+        if (unit->enabled)
+            return ESP_ERR_INVALID_STATE;
+        std::erase(s_units, unit);
+    }
+    delete unit;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unit, const pcnt_glitch_filter_config_t* config)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    unit->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    unit->enabled = false;
+    unit->running = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    if (!unit->enabled)
+        return ESP_ERR_INVALID_STATE;
+    unit->running = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unit)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    unit->running = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    unit->raw = 0;
+    unit->accumulated = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int* value)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    *value = unit->accumulated + unit->raw;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_register_event_callbacks(pcnt_unit_handle_t unit, const pcnt_event_callbacks_t* cbs, void* user_data)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    if (unit->enabled)
+        return ESP_ERR_INVALID_STATE;
+    unit->callbacks = *cbs;
+    unit->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int watch_point)
+{
+    std::lock_guard lock(s_pcnt_lock);
+    if (watch_point < unit->config.low_limit || watch_point > unit->config.high_limit)
+        return ESP_ERR_INVALID_ARG;
+    unit->watch_points.push_back(watch_point);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t* config, pcnt_channel_handle_t* ret_chan)
+{
+    *ret_chan = new pcnt_chan_t { unit };
+    return ESP_OK;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan)
+{
+    delete chan;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos_act, pcnt_channel_edge_action_t neg_act)
+{
+    return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_level_action(pcnt_channel_handle_t chan, pcnt_channel_level_action_t high_act, pcnt_channel_level_action_t low_act)
+{
+    return ESP_OK;
+}
+
+// Timers
+
+esp_err_t gptimer_new_timer(const gptimer_config_t* config, gptimer_handle_t* ret_timer)
+{
+    if (config->resolution_hz == 0 || config->direction != GPTIMER_COUNT_UP)
+        return ESP_ERR_INVALID_ARG;
+
+    auto timer = new gptimer_t;
+    timer->config = *config;
+    *ret_timer = timer;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_del_timer(gptimer_handle_t timer)
+{
+    if (timer->enabled)
+        return ESP_ERR_INVALID_STATE;
+    delete timer;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_set_raw_count(gptimer_handle_t timer, uint64_t value)
+{
+    std::lock_guard lock(timer->lock);
+    timer->count = value;
+    timer->start_time = clock::now();
+    ++timer->generation;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t gptimer_set_alarm_action(gptimer_handle_t timer, const gptimer_alarm_config_t* config)
+{
+    std::lock_guard lock(timer->lock);
+    if (config) {
+        timer->alarm = *config;
+        timer->alarm_set = true;
+    }
+    else {
+        timer->alarm_set = false;
+    }
+    ++timer->generation;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t gptimer_register_event_callbacks(gptimer_handle_t timer, const gptimer_event_callbacks_t* cbs, void* user_data)
+{
+    std::lock_guard lock(timer->lock);
+    if (timer->enabled)
+        return ESP_ERR_INVALID_STATE;
+    timer->callbacks = *cbs;
+    timer->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t gptimer_enable(gptimer_handle_t timer)
+{
+    std::lock_guard lock(timer->lock);
+    if (timer->enabled)
+        return ESP_ERR_INVALID_STATE;
+    timer->enabled = true;
+    timer->thread = std::thread(timer_thread, timer);
+    return ESP_OK;
+}
+
+esp_err_t gptimer_disable(gptimer_handle_t timer)
+{
+    {
+        std::lock_guard lock(timer->lock);
+        if (!timer->enabled || timer->running)
+            return ESP_ERR_INVALID_STATE;
+        timer->enabled = false;
+        timer->cv.notify_all();
+    }
+    if (timer->thread.get_id() == std::this_thread::get_id()) {
+        timer->thread.detach();
+    }
+    else {
+        timer->thread.join();
+    }
+    return ESP_OK;
+}
+
+esp_err_t gptimer_start(gptimer_handle_t timer)
+{
+    std::lock_guard lock(timer->lock);
+    if (!timer->enabled || timer->running)
+        return ESP_ERR_INVALID_STATE;
+    timer->running = true;
+    timer->start_time = clock::now();
+    ++timer->generation;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t gptimer_stop(gptimer_handle_t timer)
+{
+    std::lock_guard lock(timer->lock);
+    if (!timer->running)
+        return ESP_ERR_INVALID_STATE;
+    timer->count = timer_count(timer, clock::now());
+    timer->running = false;
+    ++timer->generation;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+// Host
+
+void host_gpio_set_input(gpio_num_t gpio_num, int level)
+{
+    if (!valid_pin(gpio_num))
+        return;
+
+    gpio_isr_t handler = nullptr;
+    void* arg = nullptr;
+    {
+        std::lock_guard lock(s_gpio_lock);
+        level = level ? 1 : 0;
+        if (s_levels[gpio_num] == level)
+            return;
+        s_levels[gpio_num] = level;
+        if (s_intr_enabled[gpio_num]) {
+            handler = s_handlers[gpio_num];
+            arg = s_handler_args[gpio_num];
+        }
+    }
+
+    if (handler) {
+        std::lock_guard isr(s_isr);
+        shim::IsrScope scope;
+        handler(arg);
+    }
+}
+
+void host_encoder_turn(int detents)
+{
+    const int step = detents < 0 ? -1 : 1;
+    for (; detents; detents -= step) {
+        std::unique_lock lock(s_pcnt_lock);
+        // By index, the list may change while a callback runs
+        for (size_t i = 0; i < s_units.size(); ++i) {
+            pcnt_unit_t* unit = s_units[i];
+            if (!unit->running)
+                continue;
+
+            unit->raw += step;
+            const int value = unit->raw;
+            if (unit->config.flags.accum_count && (value == unit->config.low_limit || value == unit->config.high_limit)) {
+                unit->accumulated += value;
+                unit->raw = 0;
+            }
+
+            bool watched = false;
+            for (int point : unit->watch_points) {
+                watched |= point == value;
+            }
+            if (watched && unit->callbacks.on_reach) {
+                const pcnt_watch_event_data_t data = {
+                    .watch_point_value = value,
+                    .zero_cross_mode = PCNT_UNIT_ZERO_CROSS_POS_ZERO,
+                };
+                auto callback = unit->callbacks.on_reach;
+                void* user_data = unit->user_data;
+                lock.unlock();
+                {
+                    std::lock_guard isr(s_isr);
+                    shim::IsrScope scope;
+                    callback(unit, &data, user_data);
+                }
+                lock.lock();
+            }
+        }
+        lock.unlock();
+        // Detents of a quick turn, a few ms apart
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+} // extern "C"
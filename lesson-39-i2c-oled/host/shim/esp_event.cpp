@@ -0,0 +1,127 @@
+#include <esp_event.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Default event loop: a queue of 32 events (CONFIG_ESP_SYSTEM_EVENT_QUEUE_SIZE) and the
+// "sys_evt" task calling the handlers. Event data is copied when posted.
+
+namespace {
+
+struct Handler {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void* arg;
+};
+
+struct Event {
+    esp_event_base_t base;
+    int32_t id;
+    std::vector<uint8_t> data;
+};
+
+constexpr const UBaseType_t QUEUE_SIZE = 32;
+
+QueueHandle_t s_queue = nullptr;
+std::mutex s_handlers_lock;
+std::vector<Handler> s_handlers;
+
+void event_task(void*)
+{
+    while (true) {
+        Event* event;
+        xQueueReceive(s_queue, &event, portMAX_DELAY);
+
+        // Handlers may register or unregister handlers
+        std::vector<Handler> handlers;
+        {
+            std::lock_guard lock(s_handlers_lock);
+            handlers = s_handlers;
+        }
+        for (const Handler& h : handlers) {
+            if ((h.base == ESP_EVENT_ANY_BASE || h.base == event->base) && (h.id == ESP_EVENT_ANY_ID || h.id == event->id)) {
+                h.handler(h.arg, event->base, event->id, event->data.empty() ? nullptr : event->data.data());
+            }
+        }
+        delete event;
+    }
+}
+
+esp_err_t post(esp_event_base_t event_base, int32_t event_id, const void* event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    if (!s_queue)
+        return ESP_ERR_INVALID_STATE;
+
+    Event* event = new Event { event_base, event_id, {} };
+    if (event_data && event_data_size) {
+        event->data.assign(static_cast<const uint8_t*>(event_data), static_cast<const uint8_t*>(event_data) + event_data_size);
+    }
+    if (xQueueSend(s_queue, &event, ticks_to_wait) != pdTRUE) {
+        delete event;
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_queue)
+        return ESP_ERR_INVALID_STATE;
+
+    s_queue = xQueueCreate(QUEUE_SIZE, sizeof(Event*));
+    xTaskCreatePinnedToCore(event_task, "sys_evt", 2304, nullptr, 20, nullptr, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void* event_handler_arg)
+{
+    if (!s_queue)
+        return ESP_ERR_INVALID_STATE;
+
+    std::lock_guard lock(s_handlers_lock);
+    s_handlers.push_back({ event_base, event_id, event_handler, event_handler_arg });
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+    std::lock_guard lock(s_handlers_lock);
+    for (auto it = s_handlers.begin(); it != s_handlers.end(); ++it) {
+        if (it->base == event_base && it->id == event_id && it->handler == event_handler) {
+            s_handlers.erase(it);
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void* event_data,
+                         size_t event_data_size, TickType_t ticks_to_wait)
+{
+    return post(event_base, event_id, event_data, event_data_size, ticks_to_wait);
+}
+
+esp_err_t esp_event_isr_post(esp_event_base_t event_base, int32_t event_id, const void* event_data,
+                             size_t event_data_size, BaseType_t* task_unblocked)
+{
+    // Data is limited to 4 bytes from an ISR on the target
+    if (event_data_size > 4)
+        return ESP_ERR_INVALID_ARG;
+
+    const esp_err_t err = post(event_base, event_id, event_data, event_data_size, 0);
+    if (task_unblocked) {
+        *task_unblocked = err == ESP_OK;
+    }
+    return err == ESP_ERR_TIMEOUT ? ESP_FAIL : err;
+}
+
+} // extern "C"
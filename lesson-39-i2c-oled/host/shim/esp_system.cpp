@@ -0,0 +1,171 @@
+#include <esp_cpu.h>
+#include <esp_err.h>
+#include <esp_http_client.h>
+#include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <nvs.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <sys/time.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+// Log, errors, time and the odd ROM function. The system time of the monitor is the
+// host's clock plus an offset that settimeofday() moves, the host's clock stays as it is;
+// these definitions replace libc's for the whole program.
+
+namespace {
+
+const auto s_start = std::chrono::steady_clock::now();
+std::atomic<int64_t> s_time_offset_us = 0;
+std::atomic<esp_log_level_t> s_log_level = static_cast<esp_log_level_t>(CONFIG_LOG_DEFAULT_LEVEL);
+
+struct ErrorName {
+    esp_err_t code;
+    const char* name;
+};
+
+constexpr ErrorName ERROR_NAMES[] = {
+    { ESP_OK, "ESP_OK" },
+    { ESP_FAIL, "ESP_FAIL" },
+    { ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM" },
+    { ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG" },
+    { ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE" },
+    { ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE" },
+    { ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND" },
+    { ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED" },
+    { ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT" },
+    { ESP_ERR_INVALID_RESPONSE, "ESP_ERR_INVALID_RESPONSE" },
+    { ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC" },
+    { ESP_ERR_INVALID_VERSION, "ESP_ERR_INVALID_VERSION" },
+    { ESP_ERR_INVALID_MAC, "ESP_ERR_INVALID_MAC" },
+    { ESP_ERR_NOT_FINISHED, "ESP_ERR_NOT_FINISHED" },
+    { ESP_ERR_NOT_ALLOWED, "ESP_ERR_NOT_ALLOWED" },
+    { ESP_ERR_NVS_NOT_INITIALIZED, "ESP_ERR_NVS_NOT_INITIALIZED" },
+    { ESP_ERR_NVS_NOT_FOUND, "ESP_ERR_NVS_NOT_FOUND" },
+    { ESP_ERR_NVS_TYPE_MISMATCH, "ESP_ERR_NVS_TYPE_MISMATCH" },
+    { ESP_ERR_NVS_READ_ONLY, "ESP_ERR_NVS_READ_ONLY" },
+    { ESP_ERR_NVS_INVALID_NAME, "ESP_ERR_NVS_INVALID_NAME" },
+    { ESP_ERR_NVS_INVALID_HANDLE, "ESP_ERR_NVS_INVALID_HANDLE" },
+    { ESP_ERR_NVS_KEY_TOO_LONG, "ESP_ERR_NVS_KEY_TOO_LONG" },
+    { ESP_ERR_NVS_INVALID_LENGTH, "ESP_ERR_NVS_INVALID_LENGTH" },
+    { ESP_ERR_HTTP_CONNECT, "ESP_ERR_HTTP_CONNECT" },
+    { ESP_ERR_HTTP_WRITE_DATA, "ESP_ERR_HTTP_WRITE_DATA" },
+    { ESP_ERR_HTTP_FETCH_HEADER, "ESP_ERR_HTTP_FETCH_HEADER" },
+    { ESP_ERR_HTTP_CONNECTION_CLOSED, "ESP_ERR_HTTP_CONNECTION_CLOSED" },
+};
+
+} // namespace
+
+extern "C" {
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    for (const ErrorName& error : ERROR_NAMES) {
+        if (error.code == code)
+            return error.name;
+    }
+    return "UNKNOWN ERROR";
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    s_log_level = level;
+}
+
+esp_log_level_t esp_log_level_get(const char* tag)
+{
+    return s_log_level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    // One write per line, so lines of different tasks don't mix
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len >= (int) sizeof(line)) {
+        line[sizeof(line) - 2] = '\n';
+    }
+    fputs(line, stderr);
+}
+
+int gettimeofday(struct timeval* tv, void* tz) noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t us = ts.tv_sec * 1000000LL + ts.tv_nsec / 1000 + s_time_offset_us;
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+    return 0;
+}
+
+int settimeofday(const struct timeval* tv, const struct timezone* tz) noexcept
+{
+    if (tv) {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        s_time_offset_us = tv->tv_sec * 1000000LL + tv->tv_usec - (ts.tv_sec * 1000000LL + ts.tv_nsec / 1000);
+    }
+    return 0;
+}
+
+time_t time(time_t* result) noexcept
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (result) {
+        *result = tv.tv_sec;
+    }
+    return tv.tv_sec;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_start).count();
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    #if defined(__x86_64__) || defined(__i386__)
+    return static_cast<esp_cpu_cycle_count_t>(__rdtsc());
+    #else
+    // Nanoseconds, as a 1 GHz clock
+    return static_cast<esp_cpu_cycle_count_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    #endif
+}
+
+esp_err_t esp_pm_configure(const void* config)
+{
+    return ESP_OK;
+}
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+} // extern "C"
@@ -0,0 +1,152 @@
+#include <esp_netif.h>
+#include <esp_wifi.h>
+#include <esp_log.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "host.h"
+#include "shim.h"
+
+// Station that always finds its AP: connecting takes CONNECT_DELAY_MS, then the IP event
+// follows. host_wifi_drop() takes the AP away for a while.
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+
+struct esp_netif_obj {
+    int unused;
+};
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+constexpr const int CONNECT_DELAY_MS = 50;
+
+std::mutex s_lock;
+bool s_started = false;
+bool s_connected = false;
+uint32_t s_attempt = 0;                 // Connects started, a later one cancels earlier ones
+clock::time_point s_ap_back;            // AP is gone until then
+esp_netif_obj s_netif;
+
+} // namespace
+
+extern "C" {
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_deinit(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t* esp_netif_create_default_wifi_sta(void)
+{
+    return &s_netif;
+}
+
+void esp_netif_destroy_default_wifi(void* esp_netif)
+{
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t* conf)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    {
+        std::lock_guard lock(s_lock);
+        s_started = true;
+    }
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, nullptr, 0, portMAX_DELAY);
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    bool was_connected;
+    {
+        std::lock_guard lock(s_lock);
+        was_connected = s_connected;
+        s_started = false;
+        s_connected = false;
+        ++s_attempt;
+    }
+    if (was_connected) {
+        shim::mqtt_station_changed(false);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    uint32_t attempt;
+    clock::time_point at;
+    {
+        std::lock_guard lock(s_lock);
+        if (!s_started)
+            return ESP_ERR_INVALID_STATE;
+        attempt = ++s_attempt;
+        at = std::max(clock::now(), s_ap_back) + std::chrono::milliseconds(CONNECT_DELAY_MS);
+    }
+
+    std::thread([attempt, at] {
+        std::this_thread::sleep_until(at);
+        {
+            std::lock_guard lock(s_lock);
+            if (attempt != s_attempt || !s_started || s_connected)
+                return;
+            s_connected = true;
+        }
+        shim::mqtt_station_changed(true);
+        esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, nullptr, 0, portMAX_DELAY);
+    }).detach();
+    return ESP_OK;
+}
+
+void host_wifi_drop(uint32_t ms)
+{
+    bool was_connected;
+    {
+        std::lock_guard lock(s_lock);
+        was_connected = s_connected;
+        s_connected = false;
+        ++s_attempt;
+        s_ap_back = clock::now() + std::chrono::milliseconds(ms);
+    }
+    ESP_LOGI(shim::TAG, "Wi-Fi: AP gone for %lu ms", (unsigned long) ms);
+
+    if (was_connected) {
+        shim::mqtt_station_changed(false);
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, nullptr, 0, portMAX_DELAY);
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,487 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_freertos_hooks.h>
+#include <esp_log.h>
+
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shim.h"
+
+// Every task is a detached thread. Blocking calls wait on the task's own condition
+// variable with the kernel lock held; whatever changes an object wakes the tasks blocked
+// on it, the tick thread wakes those whose timeout expired. Timeouts are in ticks and end
+// at a tick, as on the target.
+
+struct tskTaskControlBlock {
+    std::string name;
+    TaskFunction_t function = nullptr;
+    void* parameters = nullptr;
+    UBaseType_t priority = 0;
+    BaseType_t core = tskNO_AFFINITY;
+
+    std::condition_variable cv;
+    const void* waiting_on = nullptr;       // Object the task is blocked on
+    TickType_t wait_start = 0;
+    TickType_t wait_ticks = 0;
+    uint32_t notify[configTASK_NOTIFICATION_ARRAY_ENTRIES] = {};
+};
+
+struct QueueDefinition {
+    UBaseType_t length;
+    UBaseType_t item_size;
+    std::vector<uint8_t> storage;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+};
+
+struct EventGroupDef_t {
+    EventBits_t bits = 0;
+};
+
+namespace {
+
+// Thrown by vTaskDelete(nullptr), ends the task's thread after unwinding its stack
+struct TaskDeleted {};
+
+std::mutex s_kernel;
+std::vector<TaskHandle_t> s_blocked;
+std::atomic<TickType_t> s_ticks = 0;
+
+thread_local TaskHandle_t t_self = nullptr;
+thread_local bool t_in_isr = false;
+thread_local uint32_t t_mux_owner = 0;
+std::atomic<uint32_t> s_mux_owners = 0;
+
+std::mutex s_hooks_lock;
+std::vector<esp_freertos_tick_cb_t> s_tick_hooks;
+
+void tick_thread()
+{
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::microseconds(1000000 / configTICK_RATE_HZ);
+    auto next = clock::now();
+
+    while (true) {
+        next += period;
+        std::this_thread::sleep_until(next);
+
+        {
+            std::lock_guard lock(s_kernel);
+            const TickType_t now = ++s_ticks;
+            for (TaskHandle_t task : s_blocked) {
+                if (task->wait_ticks != portMAX_DELAY && static_cast<TickType_t>(now - task->wait_start) >= task->wait_ticks) {
+                    task->cv.notify_one();
+                }
+            }
+        }
+
+        std::vector<esp_freertos_tick_cb_t> hooks;
+        {
+            std::lock_guard lock(s_hooks_lock);
+            hooks = s_tick_hooks;
+        }
+        shim::IsrScope isr;
+        for (esp_freertos_tick_cb_t hook : hooks) {
+            hook();
+        }
+    }
+}
+
+void start_kernel()
+{
+    static std::once_flag started;
+    std::call_once(started, [] { std::thread(tick_thread).detach(); });
+}
+
+TaskHandle_t self()
+{
+    if (!t_self) {
+        // A thread that wasn't created as a task, e.g. main(), gets a record on first use
+        start_kernel();
+        t_self = new tskTaskControlBlock;
+        t_self->name = "thread";
+        t_self->core = 0;
+    }
+    return t_self;
+}
+
+// Blocks the calling task with s_kernel held until ready() is true or ticks have passed.
+// Returns ready().
+template <typename F>
+bool block(std::unique_lock<std::mutex>& lock, const void* object, TickType_t ticks, F&& ready)
+{
+    if (ready())
+        return true;
+    if (!ticks || t_in_isr)
+        return false;
+
+    TaskHandle_t task = self();
+    task->waiting_on = object;
+    task->wait_start = s_ticks;
+    task->wait_ticks = ticks;
+    s_blocked.push_back(task);
+
+    while (!ready()) {
+        if (ticks != portMAX_DELAY && static_cast<TickType_t>(s_ticks - task->wait_start) >= ticks)
+            break;
+        task->cv.wait(lock);
+    }
+
+    s_blocked.erase(std::find(s_blocked.begin(), s_blocked.end(), task));
+    task->waiting_on = nullptr;
+    return ready();
+}
+
+// With s_kernel held, after object changed
+void wake(const void* object)
+{
+    for (TaskHandle_t task : s_blocked) {
+        if (task->waiting_on == object) {
+            task->cv.notify_one();
+        }
+    }
+}
+
+void task_main(TaskHandle_t task)
+{
+    t_self = task;
+    try {
+        task->function(task->parameters);
+        ESP_LOGE(shim::TAG, "Task %s returned from its function", task->name.c_str());
+    }
+    catch (const TaskDeleted&) {
+    }
+    // Handle may still be in use by others, as after vTaskDelete() on the target it
+    // just must not be used anymore
+}
+
+} // namespace
+
+namespace shim {
+
+IsrScope::IsrScope()
+    : m_outer(t_in_isr)
+{
+    t_in_isr = true;
+}
+
+IsrScope::~IsrScope()
+{
+    t_in_isr = m_outer;
+}
+
+} // namespace shim
+
+extern "C" {
+
+// Tasks
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* created_task,
+                                   BaseType_t core_id)
+{
+    start_kernel();
+
+    TaskHandle_t task = new tskTaskControlBlock;
+    task->name = name ? name : "";
+    task->function = function;
+    task->parameters = parameters;
+    task->priority = priority;
+    task->core = core_id;
+
+    // Handle is known before the task runs, as on the target
+    if (created_task) {
+        *created_task = task;
+    }
+
+    std::thread thread(task_main, task);
+    pthread_setname_np(thread.native_handle(), task->name.substr(0, 15).c_str());
+    thread.detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* created_task)
+{
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task && task != t_self) {
+        ESP_LOGE(shim::TAG, "vTaskDelete() of another task isn't supported");
+        abort();
+    }
+    throw TaskDeleted();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (!ticks) {
+        std::this_thread::yield();
+        return;
+    }
+
+    std::unique_lock lock(s_kernel);
+    block(lock, self(), ticks, [] { return false; });
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake_time, TickType_t increment)
+{
+    // As in FreeRTOS: no delay when the wake time already passed
+    *previous_wake_time += increment;
+    const TickType_t ticks = *previous_wake_time - xTaskGetTickCount();
+    if (ticks == 0 || ticks > increment)
+        return pdFALSE;
+
+    vTaskDelay(ticks);
+    return pdTRUE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return self();
+}
+
+const char* pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : self())->name.c_str();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return s_ticks;
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return s_ticks;
+}
+
+uint32_t ulTaskGenericNotifyTake(UBaseType_t index, BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    TaskHandle_t task = self();
+    uint32_t& value = task->notify[index];
+
+    std::unique_lock lock(s_kernel);
+    if (!block(lock, &value, ticks_to_wait, [&] { return value != 0; }))
+        return 0;
+
+    const uint32_t taken = value;
+    value = clear_count_on_exit ? 0 : value - 1;
+    return taken;
+}
+
+BaseType_t xTaskGenericNotifyGive(TaskHandle_t task, UBaseType_t index)
+{
+    std::lock_guard lock(s_kernel);
+    ++task->notify[index];
+    wake(&task->notify[index]);
+    return pdPASS;
+}
+
+void vTaskGenericNotifyGiveFromISR(TaskHandle_t task, UBaseType_t index, BaseType_t* higher_priority_task_woken)
+{
+    xTaskGenericNotifyGive(task, index);
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdTRUE;
+    }
+}
+
+// Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    if (!length)
+        return nullptr;
+
+    QueueHandle_t queue = new QueueDefinition;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->storage.resize(static_cast<size_t>(length) * item_size);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait, BaseType_t position)
+{
+    std::unique_lock lock(s_kernel);
+    if (position == queueOVERWRITE && queue->count == queue->length) {
+        // Only meant for queues of length 1, replaces the item there
+        queue->count = 0;
+    }
+    if (!block(lock, queue, ticks_to_wait, [queue] { return queue->count < queue->length; }))
+        return errQUEUE_FULL;
+
+    UBaseType_t slot;
+    if (position == queueSEND_TO_FRONT) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    }
+    else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->item_size) {
+        memcpy(&queue->storage[static_cast<size_t>(slot) * queue->item_size], item, queue->item_size);
+    }
+    ++queue->count;
+    wake(queue);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait)
+{
+    std::unique_lock lock(s_kernel);
+    if (!block(lock, queue, ticks_to_wait, [queue] { return queue->count > 0; }))
+        return errQUEUE_EMPTY;
+
+    if (queue->item_size) {
+        memcpy(buffer, &queue->storage[static_cast<size_t>(queue->head) * queue->item_size], queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    --queue->count;
+    wake(queue);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard lock(s_kernel);
+    return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    xSemaphoreGive(mutex);
+    return mutex;
+}
+
+// Event groups
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return new EventGroupDef_t;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    delete group;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits_to_wait_for, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all_bits, TickType_t ticks_to_wait)
+{
+    std::unique_lock lock(s_kernel);
+    const bool satisfied = block(lock, group, ticks_to_wait, [=] {
+        const EventBits_t set = group->bits & bits_to_wait_for;
+        return wait_for_all_bits ? set == bits_to_wait_for : set != 0;
+    });
+
+    const EventBits_t bits = group->bits;
+    if (satisfied && clear_on_exit) {
+        group->bits &= ~bits_to_wait_for;
+    }
+    return bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits_to_set)
+{
+    std::lock_guard lock(s_kernel);
+    group->bits |= bits_to_set;
+    wake(group);
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits_to_clear)
+{
+    std::lock_guard lock(s_kernel);
+    const EventBits_t bits = group->bits;
+    group->bits &= ~bits_to_clear;
+    return bits;
+}
+
+// Port
+
+void vPortEnterCritical(portMUX_TYPE* mux)
+{
+    if (!t_mux_owner) {
+        t_mux_owner = ++s_mux_owners;
+    }
+
+    uint32_t owner = __atomic_load_n(&mux->owner, __ATOMIC_RELAXED);
+    if (owner == t_mux_owner) {
+        ++mux->count;
+        return;
+    }
+
+    while (true) {
+        uint32_t expected = portMUX_FREE_VAL;
+        if (__atomic_compare_exchange_n(&mux->owner, &expected, t_mux_owner, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+        sched_yield();
+    }
+    mux->count = 1;
+}
+
+void vPortExitCritical(portMUX_TYPE* mux)
+{
+    if (--mux->count == 0) {
+        __atomic_store_n(&mux->owner, portMUX_FREE_VAL, __ATOMIC_RELEASE);
+    }
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    const BaseType_t core = self()->core;
+    return core >= 0 && core < portNUM_PROCESSORS ? core : 0;
+}
+
+BaseType_t xPortInIsrContext(void)
+{
+    return t_in_isr;
+}
+
+// Hooks
+
+esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t new_tick_cb, uint32_t cpuid)
+{
+    start_kernel();
+
+    std::lock_guard lock(s_hooks_lock);
+    s_tick_hooks.push_back(new_tick_cb);
+    return ESP_OK;
+}
+
+void esp_deregister_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t old_tick_cb, uint32_t cpuid)
+{
+    std::lock_guard lock(s_hooks_lock);
+    auto it = std::find(s_tick_hooks.begin(), s_tick_hooks.end(), old_tick_cb);
+    if (it != s_tick_hooks.end()) {
+        s_tick_hooks.erase(it);
+    }
+}
+
+} // extern "C"
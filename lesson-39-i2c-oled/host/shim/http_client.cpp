@@ -0,0 +1,288 @@
+#include <esp_http_client.h>
+#include <esp_log.h>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shim.h"
+
+struct esp_http_client {
+    std::string host;
+    std::string port;
+    std::string path;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool keep_alive;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    int sock = -1;
+    std::string rx;                     // Received but not yet consumed
+    int status = 0;
+    int64_t content_length = -1;
+    int64_t body_left = 0;
+    bool close_after = false;           // Server said "Connection: close"
+};
+
+namespace {
+
+bool parse_url(esp_http_client_handle_t client, const char* url)
+{
+    std::string rest = url;
+    if (rest.rfind("http://", 0) != 0) {
+        ESP_LOGE(shim::TAG, "HTTP: only http:// URLs are supported, not \"%s\"", url);
+        return false;
+    }
+    rest.erase(0, 7);
+
+    const size_t slash = rest.find('/');
+    std::string authority = rest.substr(0, slash);
+    client->path = slash == rest.npos ? "/" : rest.substr(slash);
+
+    const size_t colon = authority.rfind(':');
+    client->host = authority.substr(0, colon);
+    client->port = colon == authority.npos ? "80" : authority.substr(colon + 1);
+    return !client->host.empty();
+}
+
+void disconnect(esp_http_client_handle_t client)
+{
+    if (client->sock >= 0) {
+        close(client->sock);
+        client->sock = -1;
+    }
+    client->rx.clear();
+}
+
+bool connect_server(esp_http_client_handle_t client)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(client->host.c_str(), client->port.c_str(), &hints, &result) != 0)
+        return false;
+
+    for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+        const int sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock < 0)
+            continue;
+
+        timeval timeout = { .tv_sec = client->timeout_ms / 1000, .tv_usec = (client->timeout_ms % 1000) * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) {
+            client->sock = sock;
+            break;
+        }
+        close(sock);
+    }
+    freeaddrinfo(result);
+    return client->sock >= 0;
+}
+
+bool send_all(esp_http_client_handle_t client, const char* data, size_t len)
+{
+    while (len) {
+        const ssize_t n = send(client->sock, data, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Appends to client->rx, false on timeout, error or end of stream
+bool receive(esp_http_client_handle_t client)
+{
+    char buf[1024];
+    const ssize_t n = recv(client->sock, buf, sizeof(buf), 0);
+    if (n <= 0)
+        return false;
+    client->rx.append(buf, n);
+    return true;
+}
+
+} // namespace
+
+extern "C" {
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config)
+{
+    auto client = new esp_http_client;
+    client->method = config->method;
+    client->timeout_ms = config->timeout_ms ? config->timeout_ms : 5000;
+    client->keep_alive = config->keep_alive_enable;
+    if (!config->url || !parse_url(client, config->url)) {
+        delete client;
+        return nullptr;
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value)
+{
+    for (auto& header : client->headers) {
+        if (!strcasecmp(header.first.c_str(), key)) {
+            header.second = value;
+            return ESP_OK;
+        }
+    }
+    client->headers.emplace_back(key, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    // A kept-alive connection is used as it is. If the server closed it meanwhile, the
+    // request fails later on and the caller starts over.
+    if (client->sock < 0 && !connect_server(client))
+        return ESP_ERR_HTTP_CONNECT;
+
+    static const char* const METHODS[] = { "GET", "POST", "PUT" };
+    std::string request = std::string(METHODS[client->method]) + " " + client->path + " HTTP/1.1\r\n";
+    request += "Host: " + client->host + ":" + client->port + "\r\n";
+    request += "User-Agent: ESP32 HTTP Client/1.0\r\n";
+    for (const auto& [key, value] : client->headers) {
+        request += key + ": " + value + "\r\n";
+    }
+    if (write_len < 0)
+        request += "Transfer-Encoding: chunked\r\n";
+    else if (write_len > 0 || client->method != HTTP_METHOD_GET)
+        request += "Content-Length: " + std::to_string(write_len) + "\r\n";
+    if (!client->keep_alive)
+        request += "Connection: close\r\n";
+    request += "\r\n";
+
+    client->status = 0;
+    client->content_length = -1;
+    client->body_left = 0;
+    client->close_after = !client->keep_alive;
+
+    if (!send_all(client, request.data(), request.size())) {
+        disconnect(client);
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char* buffer, int len)
+{
+    if (client->sock < 0 || !send_all(client, buffer, len))
+        return -1;
+    return len;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    if (client->sock < 0)
+        return ESP_FAIL;
+
+    size_t end;
+    while ((end = client->rx.find("\r\n\r\n")) == client->rx.npos) {
+        if (!receive(client)) {
+            disconnect(client);
+            return ESP_FAIL;
+        }
+    }
+
+    const std::string head = client->rx.substr(0, end + 2);
+    client->rx.erase(0, end + 4);
+
+    if (sscanf(head.c_str(), "HTTP/%*d.%*d %d", &client->status) != 1) {
+        disconnect(client);
+        return ESP_FAIL;
+    }
+
+    for (size_t line = head.find("\r\n") + 2; line < head.size(); line = head.find("\r\n", line) + 2) {
+        const std::string text = head.substr(line, head.find("\r\n", line) - line);
+        const size_t colon = text.find(':');
+        if (colon == text.npos)
+            continue;
+
+        const std::string key = text.substr(0, colon);
+        std::string value = text.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if (!strcasecmp(key.c_str(), "Content-Length"))
+            client->content_length = strtoll(value.c_str(), nullptr, 10);
+        else if (!strcasecmp(key.c_str(), "Connection") && !strcasecmp(value.c_str(), "close"))
+            client->close_after = true;
+    }
+
+    // Without a length the body ends with the connection
+    if (client->content_length < 0) {
+        client->close_after = true;
+    }
+    client->body_left = client->content_length < 0 ? INT64_MAX : client->content_length;
+    return client->content_length < 0 ? 0 : client->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int esp_http_client_read_response(esp_http_client_handle_t client, char* buffer, int len)
+{
+    int total = 0;
+    while (total < len && client->body_left > 0) {
+        if (client->rx.empty() && (client->sock < 0 || !receive(client)))
+            break;
+
+        const size_t n = std::min<int64_t>({ static_cast<int64_t>(client->rx.size()), len - total, client->body_left });
+        memcpy(buffer + total, client->rx.data(), n);
+        client->rx.erase(0, n);
+        client->body_left -= n;
+        total += n;
+    }
+    if (!client->body_left && client->close_after) {
+        disconnect(client);
+    }
+    return total;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int* len)
+{
+    char buffer[256];
+    int total = 0;
+    while (client->body_left > 0) {
+        const int n = esp_http_client_read_response(client, buffer, sizeof(buffer));
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    if (client->close_after) {
+        disconnect(client);
+    }
+    if (len) {
+        *len = total;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    disconnect(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    disconnect(client);
+    delete client;
+    return ESP_OK;
+}
+
+} // extern "C"
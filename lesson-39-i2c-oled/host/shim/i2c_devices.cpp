@@ -0,0 +1,515 @@
+#include <bmp280.h>
+#include <ds1307.h>
+#include <i2cdev.h>
+#include <ssd1306.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "host.h"
+#include "shim.h"
+
+// Devices of the board on one fake I2C bus. A transfer holds the bus for as long as its
+// bytes take at the device's clock (9 clocks per byte including the address byte) plus
+// START/STOP and driver overhead; nothing else happens on the bus meanwhile.
+
+struct i2c_master_bus_t {
+    int unused;
+};
+
+struct i2c_master_dev_t {
+    int unused;
+};
+
+namespace {
+
+constexpr const int64_t TRANSACTION_OVERHEAD_US = 20;
+
+std::mutex s_bus;
+std::atomic<uint32_t> s_transactions = 0;
+std::atomic<uint64_t> s_busy_us = 0;
+i2c_master_bus_t s_bus_handle;
+
+// Occupies the bus for a transaction of bytes data bytes at clk_hz
+void transfer(size_t bytes, uint32_t clk_hz)
+{
+    const int64_t us = (bytes + 1) * 9 * 1000000LL / clk_hz + TRANSACTION_OVERHEAD_US;
+    std::lock_guard lock(s_bus);
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+    ++s_transactions;
+    s_busy_us += us;
+}
+
+// AT24C32: 4 KB behind a two byte address, 32 byte pages. A write wraps within its page
+// and starts a write cycle during which the chip doesn't acknowledge its address.
+
+constexpr const size_t EEPROM_SIZE = 4096;
+constexpr const size_t EEPROM_PAGE = 32;
+constexpr const int64_t EEPROM_WRITE_CYCLE_US = 5000;          // Typical, 10 ms max
+
+std::mutex s_eeprom_lock;
+uint8_t s_eeprom[EEPROM_SIZE];
+bool s_eeprom_loaded = false;
+int64_t s_eeprom_busy_until = 0;
+
+bool is_eeprom(uint16_t addr)
+{
+    return (addr & ~0x07) == 0x50;
+}
+
+// With s_eeprom_lock held
+void eeprom_load()
+{
+    if (s_eeprom_loaded)
+        return;
+    s_eeprom_loaded = true;
+
+    memset(s_eeprom, 0xFF, sizeof(s_eeprom));
+    const std::string path = shim::state_path("eeprom.bin");
+    if (FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "rb")) {
+        if (fread(s_eeprom, sizeof(s_eeprom), 1, file) != 1) {
+            memset(s_eeprom, 0xFF, sizeof(s_eeprom));
+        }
+        fclose(file);
+    }
+}
+
+// With s_eeprom_lock held
+void eeprom_save()
+{
+    const std::string path = shim::state_path("eeprom.bin");
+    if (FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "wb")) {
+        fwrite(s_eeprom, sizeof(s_eeprom), 1, file);
+        fclose(file);
+    }
+}
+
+esp_err_t eeprom_access(const i2c_dev_t* dev, const void* reg, size_t reg_size, void* in, size_t in_size,
+                        const void* out, size_t out_size)
+{
+    transfer(reg_size + in_size + out_size + (in_size ? 1 : 0), dev->cfg.master.clk_speed);
+
+    std::lock_guard lock(s_eeprom_lock);
+    eeprom_load();
+    if (esp_timer_get_time() < s_eeprom_busy_until)
+        return ESP_FAIL;                // Address NACK
+    if (reg_size != 2)
+        return ESP_ERR_INVALID_ARG;
+
+    auto r = static_cast<const uint8_t*>(reg);
+    size_t addr = ((r[0] << 8) | r[1]) % EEPROM_SIZE;
+
+    if (in_size) {
+        auto dst = static_cast<uint8_t*>(in);
+        for (size_t i = 0; i < in_size; ++i) {
+            dst[i] = s_eeprom[(addr + i) % EEPROM_SIZE];
+        }
+    }
+    if (out_size) {
+        auto src = static_cast<const uint8_t*>(out);
+        const size_t page = addr - addr % EEPROM_PAGE;
+        for (size_t i = 0; i < out_size; ++i) {
+            s_eeprom[page + (addr - page + i) % EEPROM_PAGE] = src[i];
+        }
+        s_eeprom_busy_until = esp_timer_get_time() + EEPROM_WRITE_CYCLE_US;
+        eeprom_save();
+    }
+    return ESP_OK;
+}
+
+// BME280: hourly waves of a room (+-1 C, +-150 Pa, +-3 %) plus white noise that
+// oversampling averages down, then the chip's IIR filter. Noise is the datasheets' RMS
+// noise at oversampling x1: 0.005 C, 3.3 Pa (BMP280: 2.62 Pa) and 0.02 %.
+
+constexpr const double PI = 3.14159265358979;
+constexpr const uint32_t BMP280_CLK_HZ = 1000000;
+
+struct Bme280State {
+    std::mutex lock;
+    uint8_t chip_id = BME280_CHIP_ID;
+    std::minstd_rand random { 280 };
+    bool filtered = false;
+    double temp = 0;
+    double pres = 0;
+    double humi = 0;
+};
+
+Bme280State s_bme280;
+
+int oversampling_factor(BMP280_Oversampling oversampling)
+{
+    return oversampling == BMP280_SKIPPED ? 0 : 1 << (oversampling - 1);
+}
+
+double noise(double rms, int factor)
+{
+    std::normal_distribution<double> distribution(0, rms / std::sqrt(factor ? factor : 1));
+    return distribution(s_bme280.random);
+}
+
+// DS1307 runs this many seconds ahead of the host's clock, which the monitor's
+// settimeofday() doesn't move
+std::atomic<time_t> s_rtc_offset = 0;
+constexpr const uint32_t DS1307_CLK_HZ = 100000;
+
+// SSD1306
+
+constexpr const uint32_t SSD1306_CLK_HZ = 400000;
+
+std::atomic<uint32_t> s_oled_images = 0;
+std::atomic<uint64_t> s_oled_bytes = 0;
+uint8_t s_oled_frame[8][128];
+i2c_master_dev_t s_oled_handle;
+
+uint8_t reverse_bits(uint8_t byte)
+{
+    byte = (byte & 0xF0) >> 4 | (byte & 0x0F) << 4;
+    byte = (byte & 0xCC) >> 2 | (byte & 0x33) << 2;
+    byte = (byte & 0xAA) >> 1 | (byte & 0x55) << 1;
+    return byte;
+}
+
+} // namespace
+
+extern "C" {
+
+// Stand-in for the component's font: printable characters get a frame with their code
+// in the middle columns, so that different text is different pixels. Filled before
+// main() since the monitor may read it before anything else of this file runs.
+uint8_t font8x8_basic_tr[128][8];
+
+__attribute__((constructor)) static void make_font()
+{
+    for (int ch = 0x21; ch < 0x7F; ++ch) {
+        font8x8_basic_tr[ch][0] = 0x7E;
+        for (int col = 1; col < 7; ++col) {
+            font8x8_basic_tr[ch][col] = 0x42 | ((ch >> (col - 1) & 1) ? 0x3C : 0x18);
+        }
+        font8x8_basic_tr[ch][7] = 0x00;
+    }
+}
+
+// i2cdev
+
+esp_err_t i2cdev_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_done(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2cdev_get_shared_handle(i2c_port_t port, void** bus_handle)
+{
+    *bus_handle = &s_bus_handle;
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_create_mutex(i2c_dev_t* dev)
+{
+    dev->mutex = xSemaphoreCreateMutex();
+    return dev->mutex ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_dev_delete_mutex(i2c_dev_t* dev)
+{
+    vSemaphoreDelete(dev->mutex);
+    dev->mutex = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t i2c_dev_take_mutex(i2c_dev_t* dev)
+{
+    return xSemaphoreTake(dev->mutex, portMAX_DELAY) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t i2c_dev_give_mutex(i2c_dev_t* dev)
+{
+    return xSemaphoreGive(dev->mutex) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t i2c_dev_read(const i2c_dev_t* dev, const void* out_data, size_t out_size, void* in_data, size_t in_size)
+{
+    if (is_eeprom(dev->addr))
+        return eeprom_access(dev, out_data, out_size, in_data, in_size, nullptr, 0);
+
+    transfer(out_size + in_size, dev->cfg.master.clk_speed);
+    return ESP_FAIL;
+}
+
+esp_err_t i2c_dev_write(const i2c_dev_t* dev, const void* out_reg, size_t out_reg_size, const void* out_data, size_t out_size)
+{
+    if (is_eeprom(dev->addr))
+        return eeprom_access(dev, out_reg, out_reg_size, nullptr, 0, out_data, out_size);
+
+    transfer(out_reg_size + out_size, dev->cfg.master.clk_speed);
+    return ESP_FAIL;
+}
+
+esp_err_t i2c_dev_read_reg(const i2c_dev_t* dev, uint8_t reg, void* in_data, size_t in_size)
+{
+    return i2c_dev_read(dev, &reg, 1, in_data, in_size);
+}
+
+esp_err_t i2c_dev_write_reg(const i2c_dev_t* dev, uint8_t reg, const void* out_data, size_t out_size)
+{
+    return i2c_dev_write(dev, &reg, 1, out_data, out_size);
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t handle, const uint8_t* write_buffer, size_t write_size, int xfer_timeout_ms)
+{
+    transfer(write_size, SSD1306_CLK_HZ);
+    return ESP_OK;
+}
+
+// bmp280
+
+esp_err_t bmp280_init_default_params(bmp280_params_t* params)
+{
+    params->mode = BMP280_MODE_NORMAL;
+    params->filter = BMP280_FILTER_OFF;
+    params->oversampling_pressure = BMP280_STANDARD;
+    params->oversampling_temperature = BMP280_STANDARD;
+    params->oversampling_humidity = BMP280_STANDARD;
+    params->standby = BMP280_STANDBY_250;
+    return ESP_OK;
+}
+
+esp_err_t bmp280_init_desc(bmp280_t* dev, uint8_t addr, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
+{
+    if (addr != BMP280_I2C_ADDRESS_0 && addr != BMP280_I2C_ADDRESS_1)
+        return ESP_ERR_INVALID_ARG;
+
+    dev->i2c_dev.port = port;
+    dev->i2c_dev.addr = addr;
+    dev->i2c_dev.cfg.sda_io_num = sda_gpio;
+    dev->i2c_dev.cfg.scl_io_num = scl_gpio;
+    dev->i2c_dev.cfg.master.clk_speed = BMP280_CLK_HZ;
+    return i2c_dev_create_mutex(&dev->i2c_dev);
+}
+
+esp_err_t bmp280_free_desc(bmp280_t* dev)
+{
+    return i2c_dev_delete_mutex(&dev->i2c_dev);
+}
+
+esp_err_t bmp280_init(bmp280_t* dev, bmp280_params_t* params)
+{
+    // Chip ID, soft reset, both calibration blocks, then control and config registers
+    transfer(2, BMP280_CLK_HZ);
+    transfer(2, BMP280_CLK_HZ);
+    transfer(1 + 26, BMP280_CLK_HZ);
+    transfer(1 + 7, BMP280_CLK_HZ);
+    transfer(2, BMP280_CLK_HZ);
+    transfer(2, BMP280_CLK_HZ);
+    transfer(2, BMP280_CLK_HZ);
+
+    dev->id = s_bme280.chip_id;
+    dev->params = *params;
+    dev->conversion_end_us = 0;
+
+    std::lock_guard lock(s_bme280.lock);
+    s_bme280.filtered = false;
+    return ESP_OK;
+}
+
+esp_err_t bmp280_force_measurement(bmp280_t* dev)
+{
+    if (dev->params.mode != BMP280_MODE_FORCED)
+        return ESP_ERR_INVALID_STATE;
+
+    transfer(2, BMP280_CLK_HZ);
+
+    // Typical measurement time (BME280 datasheet 9.1), a bit below the maximum
+    const int t = oversampling_factor(dev->params.oversampling_temperature);
+    const int p = oversampling_factor(dev->params.oversampling_pressure);
+    const int h = oversampling_factor(dev->params.oversampling_humidity);
+    int64_t us = 1000 + 2000 * t;
+    if (p)
+        us += 2000 * p + 500;
+    if (h)
+        us += 2000 * h + 500;
+    dev->conversion_end_us = esp_timer_get_time() + us;
+    return ESP_OK;
+}
+
+esp_err_t bmp280_is_measuring(bmp280_t* dev, bool* busy)
+{
+    transfer(2, BMP280_CLK_HZ);
+    *busy = esp_timer_get_time() < dev->conversion_end_us;
+    return ESP_OK;
+}
+
+esp_err_t bmp280_read_float(bmp280_t* dev, float* temperature, float* pressure, float* humidity)
+{
+    transfer(1 + (humidity ? 8 : 6), BMP280_CLK_HZ);
+
+    const double s = esp_timer_get_time() / 1e6;
+    std::lock_guard lock(s_bme280.lock);
+    const double temp = 21.5 + 1.0 * std::sin(2 * PI * s / 3600) + noise(0.005, oversampling_factor(dev->params.oversampling_temperature));
+    const double pres_rms = dev->id == BME280_CHIP_ID ? 3.3 : 2.62;
+    const double pres = 101325 + 150 * std::sin(2 * PI * s / 3600) + noise(pres_rms, oversampling_factor(dev->params.oversampling_pressure));
+    const double humi = 45.0 + 3.0 * std::sin(2 * PI * s / 3600) + noise(0.02, oversampling_factor(dev->params.oversampling_humidity));
+
+    // IIR filter as in the chip: x = (x * (c - 1) + new) / c, c = 2^filter
+    const int c = 1 << dev->params.filter;
+    if (!s_bme280.filtered || c == 1) {
+        s_bme280.temp = temp;
+        s_bme280.pres = pres;
+        s_bme280.humi = humi;
+        s_bme280.filtered = true;
+    }
+    else {
+        s_bme280.temp = (s_bme280.temp * (c - 1) + temp) / c;
+        s_bme280.pres = (s_bme280.pres * (c - 1) + pres) / c;
+        s_bme280.humi = (s_bme280.humi * (c - 1) + humi) / c;
+    }
+
+    *temperature = s_bme280.temp;
+    *pressure = s_bme280.pres;
+    if (humidity && dev->id == BME280_CHIP_ID) {
+        *humidity = s_bme280.humi;
+    }
+    return ESP_OK;
+}
+
+// ds1307
+
+esp_err_t ds1307_init_desc(i2c_dev_t* dev, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio)
+{
+    dev->port = port;
+    dev->addr = DS1307_ADDR;
+    dev->cfg.sda_io_num = sda_gpio;
+    dev->cfg.scl_io_num = scl_gpio;
+    dev->cfg.master.clk_speed = DS1307_CLK_HZ;
+    return i2c_dev_create_mutex(dev);
+}
+
+esp_err_t ds1307_free_desc(i2c_dev_t* dev)
+{
+    return i2c_dev_delete_mutex(dev);
+}
+
+esp_err_t ds1307_get_time(i2c_dev_t* dev, struct tm* time)
+{
+    transfer(1 + 7, DS1307_CLK_HZ);
+    timespec host;
+    clock_gettime(CLOCK_REALTIME, &host);
+    const time_t now = host.tv_sec + s_rtc_offset;
+    gmtime_r(&now, time);
+    return ESP_OK;
+}
+
+esp_err_t ds1307_set_time(i2c_dev_t* dev, const struct tm* time)
+{
+    transfer(1 + 7, DS1307_CLK_HZ);
+    timespec host;
+    clock_gettime(CLOCK_REALTIME, &host);
+    tm copy = *time;
+    s_rtc_offset = timegm(&copy) - host.tv_sec;
+    return ESP_OK;
+}
+
+// ssd1306
+
+void i2c_device_add(SSD1306_t* dev, i2c_port_t i2c_num, int16_t reset, uint16_t i2c_address)
+{
+    dev->_address = i2c_address;
+    dev->_flip = false;
+    dev->_i2c_dev_handle = &s_oled_handle;
+}
+
+void ssd1306_init(SSD1306_t* dev, int width, int height)
+{
+    // Init command sequence
+    transfer(1 + 27, SSD1306_CLK_HZ);
+
+    dev->_width = width;
+    dev->_height = height;
+    dev->_pages = height / 8;
+    for (int page = 0; page < dev->_pages; ++page) {
+        memset(dev->_page[page]._segs, 0, sizeof(dev->_page[page]._segs));
+    }
+}
+
+void ssd1306_clear_screen(SSD1306_t* dev, bool invert)
+{
+    uint8_t zeros[128];
+    memset(zeros, invert ? 0xFF : 0x00, sizeof(zeros));
+    for (int page = 0; page < dev->_pages; ++page) {
+        i2c_display_image(dev, page, 0, zeros, dev->_width);
+    }
+}
+
+void ssd1306_contrast(SSD1306_t* dev, int contrast)
+{
+    transfer(1 + 2, SSD1306_CLK_HZ);
+}
+
+void ssd1306_invert(uint8_t* buf, size_t blen)
+{
+    for (size_t i = 0; i < blen; ++i) {
+        buf[i] = ~buf[i];
+    }
+}
+
+void ssd1306_flip(uint8_t* buf, size_t blen)
+{
+    for (size_t i = 0; i < blen; ++i) {
+        buf[i] = reverse_bits(buf[i]);
+    }
+}
+
+void i2c_display_image(SSD1306_t* dev, int page, int seg, uint8_t* images, int width)
+{
+    if (page < 0 || page >= dev->_pages || seg < 0 || seg + width > dev->_width)
+        return;
+
+    // Column and page address commands, then the data
+    transfer(1 + 6, SSD1306_CLK_HZ);
+    transfer(1 + width, SSD1306_CLK_HZ);
+
+    memcpy(&s_oled_frame[page][seg], images, width);
+    ++s_oled_images;
+    s_oled_bytes += width;
+}
+
+// Host
+
+void host_bmp280_set_chip(uint8_t chip_id)
+{
+    std::lock_guard lock(s_bme280.lock);
+    s_bme280.chip_id = chip_id;
+}
+
+void host_oled_stats(host_oled_stats_t* stats)
+{
+    stats->transactions = s_oled_images;
+    stats->bytes = s_oled_bytes;
+}
+
+void host_i2c_stats(host_i2c_stats_t* stats)
+{
+    stats->transactions = s_transactions;
+    stats->busy_us = s_busy_us;
+}
+
+} // extern "C"
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "i2cdev.h"
+
+// BME280 on the fake bus: slow sine waves plus noise for the three metrics, a forced
+// conversion takes as long as the oversampling settings make it take on the chip
+
+#define BMP280_I2C_ADDRESS_0    0x76
+#define BMP280_I2C_ADDRESS_1    0x77
+
+#define BMP280_CHIP_ID          0x58
+#define BME280_CHIP_ID          0x60
+
+typedef enum {
+    BMP280_MODE_SLEEP = 0,
+    BMP280_MODE_FORCED = 1,
+    BMP280_MODE_NORMAL = 3,
+} BMP280_Mode;
+
+typedef enum {
+    BMP280_FILTER_OFF = 0,
+    BMP280_FILTER_2 = 1,
+    BMP280_FILTER_4 = 2,
+    BMP280_FILTER_8 = 3,
+    BMP280_FILTER_16 = 4,
+} BMP280_Filter;
+
+typedef enum {
+    BMP280_SKIPPED = 0,
+    BMP280_ULTRA_LOW_POWER = 1,
+    BMP280_LOW_POWER = 2,
+    BMP280_STANDARD = 3,
+    BMP280_HIGH_RES = 4,
+    BMP280_ULTRA_HIGH_RES = 5,
+} BMP280_Oversampling;
+
+typedef enum {
+    BMP280_STANDBY_05 = 0,
+    BMP280_STANDBY_62,
+    BMP280_STANDBY_125,
+    BMP280_STANDBY_250,
+    BMP280_STANDBY_500,
+    BMP280_STANDBY_1000,
+    BMP280_STANDBY_2000,
+    BMP280_STANDBY_4000,
+} BMP280_StandbyTime;
+
+typedef struct {
+    BMP280_Mode mode;
+    BMP280_Filter filter;
+    BMP280_Oversampling oversampling_pressure;
+    BMP280_Oversampling oversampling_temperature;
+    BMP280_Oversampling oversampling_humidity;
+    BMP280_StandbyTime standby;
+} bmp280_params_t;
+
+typedef struct {
+    i2c_dev_t i2c_dev;
+    uint8_t id;
+    bmp280_params_t params;
+    int64_t conversion_end_us;
+} bmp280_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t bmp280_init_default_params(bmp280_params_t* params);
+esp_err_t bmp280_init_desc(bmp280_t* dev, uint8_t addr, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
+esp_err_t bmp280_free_desc(bmp280_t* dev);
+esp_err_t bmp280_init(bmp280_t* dev, bmp280_params_t* params);
+esp_err_t bmp280_force_measurement(bmp280_t* dev);
+esp_err_t bmp280_is_measuring(bmp280_t* dev, bool* busy);
+esp_err_t bmp280_read_float(bmp280_t* dev, float* temperature, float* pressure, float* humidity);
+
+#ifdef __cplusplus
+}
+#endif
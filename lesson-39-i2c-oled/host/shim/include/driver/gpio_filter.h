@@ -0,0 +1,29 @@
+#pragma once
+
+#include "gpio.h"
+
+// Accepted and ignored, host.h changes levels without glitches
+
+typedef struct gpio_glitch_filter_t* gpio_glitch_filter_handle_t;
+
+typedef enum {
+    GLITCH_FILTER_CLK_SRC_DEFAULT = 0,
+} glitch_filter_clock_source_t;
+
+typedef struct {
+    glitch_filter_clock_source_t clk_src;
+    gpio_num_t gpio_num;
+} gpio_pin_glitch_filter_config_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t gpio_new_pin_glitch_filter(const gpio_pin_glitch_filter_config_t* config, gpio_glitch_filter_handle_t* ret_filter);
+esp_err_t gpio_del_glitch_filter(gpio_glitch_filter_handle_t filter);
+esp_err_t gpio_glitch_filter_enable(gpio_glitch_filter_handle_t filter);
+esp_err_t gpio_glitch_filter_disable(gpio_glitch_filter_handle_t filter);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "i2cdev.h"
+
+// DS1307 on the fake bus, running at a fixed offset from the host's clock
+
+#define DS1307_ADDR 0x68
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t ds1307_init_desc(i2c_dev_t* dev, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
+esp_err_t ds1307_free_desc(i2c_dev_t* dev);
+esp_err_t ds1307_get_time(i2c_dev_t* dev, struct tm* time);
+esp_err_t ds1307_set_time(i2c_dev_t* dev, const struct tm* time);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Time stamp counter of the host CPU, truncated like the 32 bit CCOUNT register. Its rate
+// is the host's nominal clock (1 GHz where there is no TSC), not the ESP32-S3's 240 MHz.
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef bool (*esp_freertos_idle_cb_t)(void);
+typedef void (*esp_freertos_tick_cb_t)(void);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hooks run on the tick thread right after the tick count went up, in ISR context
+esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t new_tick_cb, uint32_t cpuid);
+void esp_deregister_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t old_tick_cb, uint32_t cpuid);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_event.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_netif_init(void);
+esp_err_t esp_netif_deinit(void);
+esp_netif_t* esp_netif_create_default_wifi_sta(void);
+void esp_netif_destroy_default_wifi(void* esp_netif);
+
+#ifdef __cplusplus
+}
+#endif
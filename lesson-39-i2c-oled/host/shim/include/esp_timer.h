@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Microseconds since the program started
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <sdkconfig.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+
+// Kernel objects of the host shim: every task is a thread, the tick is a thread of its
+// own running at CONFIG_FREERTOS_HZ. Priorities and core affinity are recorded but not
+// enforced, the host scheduler decides who runs.
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+typedef void (*TaskFunction_t)(void*);
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef struct QueueDefinition* QueueHandle_t;
+typedef struct EventGroupDef_t* EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+#define configTICK_RATE_HZ                      CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES                    25
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES
+
+#define portTICK_PERIOD_MS      ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t) 0xffffffffUL)
+#define portNUM_PROCESSORS      2
+
+#define pdMS_TO_TICKS(ms)       ((TickType_t) (((uint64_t) (ms) * configTICK_RATE_HZ) / 1000U))
+#define pdTICKS_TO_MS(ticks)    ((TickType_t) (((uint64_t) (ticks) * 1000U) / configTICK_RATE_HZ))
+
+#define pdFALSE                 ((BaseType_t) 0)
+#define pdTRUE                  ((BaseType_t) 1)
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+
+#define tskIDLE_PRIORITY        ((UBaseType_t) 0)
+#define tskNO_AFFINITY          ((BaseType_t) 0x7FFFFFFF)
+
+// Recursive spinlock like the ESP-IDF one. There are no interrupts to disable, threads
+// that call back as "ISRs" take the same lock.
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_FREE_VAL                0xB33FFFFFu
+#define portMUX_INITIALIZER_UNLOCKED    { portMUX_FREE_VAL, 0 }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void vPortEnterCritical(portMUX_TYPE* mux);
+void vPortExitCritical(portMUX_TYPE* mux);
+BaseType_t xPortGetCoreID(void);
+BaseType_t xPortInIsrContext(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define portENTER_CRITICAL(mux)         vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)          vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)      vPortExitCritical(mux)
+#define portENTER_CRITICAL_SAFE(mux)    vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     vPortExitCritical(mux)
+#define taskENTER_CRITICAL(mux)         vPortEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux)          vPortExitCritical(mux)
+#define taskENTER_CRITICAL_ISR(mux)     vPortEnterCritical(mux)
+#define taskEXIT_CRITICAL_ISR(mux)      vPortExitCritical(mux)
+
+#define portYIELD_FROM_ISR(woken)       ((void) (woken))
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "task.h"                  // As in FreeRTOS
+
+#define queueSEND_TO_BACK   ((BaseType_t) 0)
+#define queueSEND_TO_FRONT  ((BaseType_t) 1)
+#define queueOVERWRITE      ((BaseType_t) 2)
+
+#define errQUEUE_FULL       ((BaseType_t) 0)
+#define errQUEUE_EMPTY      ((BaseType_t) 0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueGenericSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait, BaseType_t position);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define xQueueSend(queue, item, ticks)          xQueueGenericSend((queue), (item), (ticks), queueSEND_TO_BACK)
+#define xQueueSendToBack(queue, item, ticks)    xQueueGenericSend((queue), (item), (ticks), queueSEND_TO_BACK)
+#define xQueueSendToFront(queue, item, ticks)   xQueueGenericSend((queue), (item), (ticks), queueSEND_TO_FRONT)
+#define xQueueOverwrite(queue, item)            xQueueGenericSend((queue), (item), 0, queueOVERWRITE)
+#define xQueueSendFromISR(queue, item, woken)   xQueueGenericSend((queue), (item), 0, queueSEND_TO_BACK)
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "queue.h"
+
+// Semaphores are queues of zero-size items as in FreeRTOS. A mutex is a binary semaphore
+// that starts given, without priority inheritance or a recursive variant.
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define xSemaphoreTake(semaphore, ticks)        xQueueReceive((semaphore), NULL, (ticks))
+#define xSemaphoreGive(semaphore)               xQueueGenericSend((semaphore), NULL, 0, queueSEND_TO_BACK)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueGenericSend((semaphore), NULL, 0, queueSEND_TO_BACK)
+#define vSemaphoreDelete(semaphore)             vQueueDelete(semaphore)
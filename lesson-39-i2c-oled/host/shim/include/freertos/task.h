@@ -0,0 +1,38 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* created_task,
+                                   BaseType_t core_id);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* created_task);
+
+// Only the calling task can delete itself (nullptr)
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t* previous_wake_time, TickType_t increment);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char* pcTaskGetName(TaskHandle_t task);
+TickType_t xTaskGetTickCount(void);
+TickType_t xTaskGetTickCountFromISR(void);
+
+uint32_t ulTaskGenericNotifyTake(UBaseType_t index, BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskGenericNotifyGive(TaskHandle_t task, UBaseType_t index);
+void vTaskGenericNotifyGiveFromISR(TaskHandle_t task, UBaseType_t index, BaseType_t* higher_priority_task_woken);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ulTaskNotifyTake(clear, ticks)                      ulTaskGenericNotifyTake(0, (clear), (ticks))
+#define ulTaskNotifyTakeIndexed(index, clear, ticks)        ulTaskGenericNotifyTake((index), (clear), (ticks))
+#define xTaskNotifyGive(task)                               xTaskGenericNotifyGive((task), 0)
+#define xTaskNotifyGiveIndexed(task, index)                 xTaskGenericNotifyGive((task), (index))
+#define vTaskNotifyGiveFromISR(task, woken)                 vTaskGenericNotifyGiveFromISR((task), 0, (woken))
+#define vTaskNotifyGiveIndexedFromISR(task, index, woken)   vTaskGenericNotifyGiveFromISR((task), (index), (woken))
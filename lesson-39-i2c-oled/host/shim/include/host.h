@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mqtt_client.h"
+#include "soc/gpio_num.h"
+
+// Controls and counters of the host build's fake hardware, for main.cpp. Everything here
+// is safe to call from any thread once the monitor is running.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Directory that keeps NVS (nvs.bin) and the history partition (history.bin) across
+// runs, none keeps both in memory. Must be called before nvs_flash_init().
+void host_set_state_dir(const char* dir);
+
+// Input level of a pin, runs its ISR handler on a change
+void host_gpio_set_input(gpio_num_t gpio_num, int level);
+// Turns the rotary encoder by detents, negative counterclockwise
+void host_encoder_turn(int detents);
+
+// Chip behind the bmp280 driver: BME280_CHIP_ID (default) or BMP280_CHIP_ID, which has
+// no humidity. Must be called before the monitor starts.
+void host_bmp280_set_chip(uint8_t chip_id);
+
+// Station loses its AP for the given time, then reconnects when asked to
+void host_wifi_drop(uint32_t ms);
+
+// Client of the in-process broker that doesn't go through the station, for load
+// generators and observers. Connects on esp_mqtt_client_start() like any client.
+esp_mqtt_client_handle_t host_mqtt_client_init(const char* client_id);
+
+// Share of esp_mqtt_client_publish() calls of station clients that fail as with a full
+// outbox, in 1/1000
+void host_mqtt_set_publish_fail(int permille);
+
+typedef struct {
+    uint32_t published;         // Messages the client published
+    uint32_t failed;            // Publishes that returned -1
+    uint32_t delivered;         // Messages delivered to the client's handler
+    uint32_t dropped;           // Messages dropped because the client's queue was full
+    uint32_t queue_peak;        // Most events waiting for the client's handler
+} host_mqtt_stats_t;
+
+void host_mqtt_stats(esp_mqtt_client_handle_t client, host_mqtt_stats_t* stats);
+
+typedef struct {
+    uint32_t transactions;      // Images sent, one I2C transaction each
+    uint64_t bytes;             // Payload bytes of those images
+} host_oled_stats_t;
+
+void host_oled_stats(host_oled_stats_t* stats);
+
+typedef struct {
+    uint32_t transactions;
+    uint64_t busy_us;           // Time the bus was driven, by the configured clock speed
+} host_i2c_stats_t;
+
+void host_i2c_stats(host_i2c_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Fake I2C bus of the host build with the devices of the board: BME280 (0x76/0x77),
+// DS1307 (0x68), AT24C32 (0x50..0x57) and SSD1306 (0x3C/0x3D). Every transfer takes the
+// time its bytes need at the device's clock speed, plus a per-transaction overhead, so
+// bus occupancy looks like on the target.
+
+typedef struct {
+    i2c_port_t port;
+    uint16_t addr;
+    uint8_t addr_bit_len;
+    SemaphoreHandle_t mutex;
+    uint32_t timeout_ticks;
+    struct {
+        gpio_num_t sda_io_num;
+        gpio_num_t scl_io_num;
+        bool sda_pullup_en;
+        bool scl_pullup_en;
+        struct {
+            uint32_t clk_speed;
+        } master;
+    } cfg;
+    void* dev_handle;
+} i2c_dev_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t i2cdev_init(void);
+esp_err_t i2cdev_done(void);
+esp_err_t i2cdev_get_shared_handle(i2c_port_t port, void** bus_handle);
+
+esp_err_t i2c_dev_create_mutex(i2c_dev_t* dev);
+esp_err_t i2c_dev_delete_mutex(i2c_dev_t* dev);
+esp_err_t i2c_dev_take_mutex(i2c_dev_t* dev);
+esp_err_t i2c_dev_give_mutex(i2c_dev_t* dev);
+
+esp_err_t i2c_dev_read(const i2c_dev_t* dev, const void* out_data, size_t out_size, void* in_data, size_t in_size);
+esp_err_t i2c_dev_write(const i2c_dev_t* dev, const void* out_reg, size_t out_reg_size, const void* out_data, size_t out_size);
+esp_err_t i2c_dev_read_reg(const i2c_dev_t* dev, uint8_t reg, void* in_data, size_t in_size);
+esp_err_t i2c_dev_write_reg(const i2c_dev_t* dev, uint8_t reg, const void* out_data, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define I2C_DEV_TAKE_MUTEX(dev) do { \
+        esp_err_t __ = i2c_dev_take_mutex(dev); \
+        if (__ != ESP_OK) return __; \
+    } while (0)
+
+#define I2C_DEV_GIVE_MUTEX(dev) do { \
+        esp_err_t __ = i2c_dev_give_mutex(dev); \
+        if (__ != ESP_OK) return __; \
+    } while (0)
+
+#define I2C_DEV_CHECK(dev, X) do { \
+        esp_err_t ___ = X; \
+        if (___ != ESP_OK) { \
+            I2C_DEV_GIVE_MUTEX(dev); \
+            return ___; \
+        } \
+    } while (0)
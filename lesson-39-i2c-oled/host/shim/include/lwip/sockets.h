@@ -0,0 +1,12 @@
+#pragma once
+
+// BSD sockets of the host. The LWIP_MAX_SOCKETS limit isn't enforced, only the broker's
+// own MAX_CLIENTS is.
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
@@ -0,0 +1,7 @@
+#pragma once
+
+// The in-process broker ignores the URI. main.cpp's load generator publishes to
+// MQTT_SUB_TOPIC and the node topics of CONFIG_REMOTE_NODES_TOPIC.
+#define MQTT_BROKER_URI "mqtt://in-process"
+#define MQTT_PUB_TOPIC  "node/1"
+#define MQTT_SUB_TOPIC  "node/2/#"
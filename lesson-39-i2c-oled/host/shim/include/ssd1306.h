@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/i2c_master.h"
+
+// SSD1306 on the fake bus: images go into a framebuffer of the display, bytes and
+// transactions are counted for host_oled_stats() of host.h
+
+typedef struct {
+    bool _valid;
+    int _segLen;
+    uint8_t _segs[128];
+} PAGE_t;
+
+typedef struct {
+    int _address;
+    int _width;
+    int _height;
+    int _pages;
+    int _dc;
+    bool _scEnable;
+    int _scStart;
+    int _scEnd;
+    int _scDirection;
+    PAGE_t _page[8];
+    bool _flip;
+    i2c_master_bus_handle_t _i2c_bus_handle;
+    i2c_master_dev_handle_t _i2c_dev_handle;
+} SSD1306_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void i2c_device_add(SSD1306_t* dev, i2c_port_t i2c_num, int16_t reset, uint16_t i2c_address);
+void ssd1306_init(SSD1306_t* dev, int width, int height);
+void ssd1306_clear_screen(SSD1306_t* dev, bool invert);
+void ssd1306_contrast(SSD1306_t* dev, int contrast);
+void ssd1306_invert(uint8_t* buf, size_t blen);
+void ssd1306_flip(uint8_t* buf, size_t blen);
+void i2c_display_image(SSD1306_t* dev, int page, int seg, uint8_t* images, int width);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,5 @@
+#pragma once
+
+// Any value works, the host station connects to whatever it is given
+#define WIFI_SSID "host"
+#define WIFI_PASS "host"
@@ -0,0 +1,468 @@
+#include <mqtt_client.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "host.h"
+#include "shim.h"
+
+// In-process broker and its clients. A message goes to every connected client with a
+// matching subscription, once per client, into the client's event queue; the client's
+// task runs the event handler. Like a broker's per-client queue (mosquitto's
+// max_queued_messages), a full queue drops QoS 0 messages instead of slowing the
+// publisher down. Sessions are clean: a client that reconnects subscribes again.
+
+ESP_EVENT_DEFINE_BASE(MQTT_EVENTS);
+
+namespace {
+
+constexpr const size_t QUEUE_LIMIT = 1000;
+constexpr const auto RECONNECT_INTERVAL = std::chrono::seconds(10);     // reconnect_timeout_ms
+
+struct Message {
+    esp_mqtt_event_id_t id;
+    std::string topic;
+    std::string data;
+    int msg_id;
+    int qos;
+    bool retain;
+};
+
+struct Handler {
+    esp_mqtt_event_id_t event;
+    esp_event_handler_t handler;
+    void* arg;
+};
+
+struct Subscription {
+    std::string filter;
+    int qos;
+};
+
+std::atomic<bool> s_station_up = false;
+std::atomic<int> s_publish_fail = 0;
+
+} // namespace
+
+struct esp_mqtt_client {
+    std::string id;
+    bool station;                       // Connection goes through the Wi-Fi station
+
+    std::mutex lock;                    // Everything below but subscriptions
+    std::condition_variable cv;
+    std::deque<Message> events;
+    std::vector<Handler> handlers;
+    std::vector<Message> outbox;        // QoS > 0 messages published while disconnected
+    bool started = false;
+    bool connected = false;
+    bool connect_now = false;
+    int next_msg_id = 1;
+
+    std::vector<Subscription> subscriptions;    // Guarded by s_broker
+
+    std::atomic<uint32_t> published = 0;
+    std::atomic<uint32_t> failed = 0;
+    std::atomic<uint32_t> delivered = 0;
+    std::atomic<uint32_t> dropped = 0;
+    std::atomic<uint32_t> queue_peak = 0;
+};
+
+namespace {
+
+std::mutex s_broker;                    // Taken before a client's lock
+std::vector<esp_mqtt_client_handle_t> s_clients;
+std::map<std::string, std::string, std::less<>> s_retained;
+
+bool matches(std::string_view filter, std::string_view topic)
+{
+    while (true) {
+        const size_t f_end = std::min(filter.find('/'), filter.size());
+        const size_t t_end = std::min(topic.find('/'), topic.size());
+        const std::string_view level = filter.substr(0, f_end);
+
+        if (level == "#")
+            return true;
+        if (level != "+" && level != topic.substr(0, t_end))
+            return false;
+
+        const bool filter_done = f_end == filter.size();
+        const bool topic_done = t_end == topic.size();
+        if (filter_done || topic_done)
+            return filter_done && topic_done;
+
+        filter.remove_prefix(f_end + 1);
+        topic.remove_prefix(t_end + 1);
+    }
+}
+
+// With the client's lock held
+void push(esp_mqtt_client_handle_t client, Message&& message)
+{
+    if (message.id == MQTT_EVENT_DATA && client->events.size() >= QUEUE_LIMIT) {
+        ++client->dropped;
+        return;
+    }
+    client->events.push_back(std::move(message));
+    if (client->events.size() > client->queue_peak) {
+        client->queue_peak = client->events.size();
+    }
+    client->cv.notify_one();
+}
+
+// With s_broker held
+void deliver_to(esp_mqtt_client_handle_t client, std::string_view topic, std::string_view data, int qos, bool retain)
+{
+    for (const Subscription& sub : client->subscriptions) {
+        if (matches(sub.filter, topic)) {
+            std::lock_guard lock(client->lock);
+            if (client->connected) {
+                push(client, { MQTT_EVENT_DATA, std::string(topic), std::string(data), 0, std::min(qos, sub.qos), retain });
+            }
+            return;
+        }
+    }
+}
+
+void deliver(std::string_view topic, std::string_view data, int qos, bool retain)
+{
+    std::lock_guard lock(s_broker);
+    if (retain) {
+        if (data.empty()) {
+            if (auto it = s_retained.find(topic); it != s_retained.end()) {
+                s_retained.erase(it);
+            }
+        }
+        else {
+            s_retained[std::string(topic)] = data;
+        }
+    }
+    for (esp_mqtt_client_handle_t client : s_clients) {
+        deliver_to(client, topic, data, qos, false);
+    }
+}
+
+bool network_up(esp_mqtt_client_handle_t client)
+{
+    return !client->station || s_station_up;
+}
+
+void dispatch(esp_mqtt_client_handle_t client, Message& message)
+{
+    esp_mqtt_event_t event = {};
+    event.event_id = message.id;
+    event.client = client;
+    event.data = message.data.data();
+    event.data_len = message.data.size();
+    event.total_data_len = message.data.size();
+    event.topic = message.topic.data();
+    event.topic_len = message.topic.size();
+    event.msg_id = message.msg_id;
+    event.qos = message.qos;
+    event.retain = message.retain;
+
+    std::vector<Handler> handlers;
+    {
+        std::lock_guard lock(client->lock);
+        handlers = client->handlers;
+    }
+    for (const Handler& h : handlers) {
+        if (h.event == MQTT_EVENT_ANY || h.event == message.id) {
+            h.handler(h.arg, MQTT_EVENTS, message.id, &event);
+        }
+    }
+    if (message.id == MQTT_EVENT_DATA) {
+        ++client->delivered;
+    }
+}
+
+void client_task(void* arg)
+{
+    auto client = static_cast<esp_mqtt_client_handle_t>(arg);
+
+    while (true) {
+        Message message;
+        std::vector<Message> outbox;
+        bool connected = false;
+        {
+            std::unique_lock lock(client->lock);
+            const auto ready = [client] { return !client->events.empty() || client->connect_now; };
+            if (!client->connected) {
+                // Retried as esp-mqtt does while disconnected
+                if (!client->cv.wait_for(lock, RECONNECT_INTERVAL, ready)) {
+                    client->connect_now = true;
+                }
+            }
+            else {
+                client->cv.wait(lock, ready);
+            }
+
+            if (client->connect_now) {
+                client->connect_now = false;
+                if (client->connected || !network_up(client))
+                    continue;
+
+                client->connected = true;
+                connected = true;
+                outbox.swap(client->outbox);
+            }
+            else {
+                message = std::move(client->events.front());
+                client->events.pop_front();
+            }
+        }
+
+        if (connected) {
+            Message event = { MQTT_EVENT_CONNECTED, {}, {}, 0, 0, false };
+            dispatch(client, event);
+            for (Message& stored : outbox) {
+                deliver(stored.topic, stored.data, stored.qos, stored.retain);
+            }
+        }
+        else {
+            dispatch(client, message);
+        }
+    }
+}
+
+esp_mqtt_client_handle_t create(const char* client_id, bool station)
+{
+    static std::atomic<int> s_count = 0;
+
+    auto client = new esp_mqtt_client;
+    client->id = client_id ? client_id : "client" + std::to_string(++s_count);
+    client->station = station;
+
+    std::lock_guard lock(s_broker);
+    s_clients.push_back(client);
+    return client;
+}
+
+int publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain, bool store)
+{
+    if (!len && data) {
+        len = strlen(data);
+    }
+
+    if (client->station && s_publish_fail) {
+        thread_local std::minstd_rand random(std::random_device{}());
+        if (static_cast<int>(random() % 1000) < s_publish_fail) {
+            ++client->failed;
+            return -1;
+        }
+    }
+
+    int msg_id = 0;
+    {
+        std::lock_guard lock(client->lock);
+        if (qos > 0) {
+            msg_id = client->next_msg_id++;
+            if (client->next_msg_id > 0xFFFF) {
+                client->next_msg_id = 1;
+            }
+        }
+        if (!client->connected) {
+            if (!qos && !store) {
+                ++client->failed;
+                return -1;
+            }
+            client->outbox.push_back({ MQTT_EVENT_DATA, topic, std::string(data, len), msg_id, qos, retain != 0 });
+            return msg_id;
+        }
+    }
+
+    ++client->published;
+    deliver(topic, { data, static_cast<size_t>(len) }, qos, retain != 0);
+    if (qos > 0) {
+        std::lock_guard lock(client->lock);
+        push(client, { MQTT_EVENT_PUBLISHED, {}, {}, msg_id, qos, false });
+    }
+    return msg_id;
+}
+
+} // namespace
+
+namespace shim {
+
+void mqtt_station_changed(bool connected)
+{
+    s_station_up = connected;
+    if (connected)
+        return;
+
+    std::lock_guard broker_lock(s_broker);
+    for (esp_mqtt_client_handle_t client : s_clients) {
+        if (!client->station)
+            continue;
+
+        client->subscriptions.clear();
+        std::lock_guard lock(client->lock);
+        if (client->connected) {
+            client->connected = false;
+            client->events.clear();
+            push(client, { MQTT_EVENT_DISCONNECTED, {}, {}, 0, 0, false });
+        }
+    }
+}
+
+} // namespace shim
+
+extern "C" {
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config)
+{
+    return create(config->credentials.client_id, true);
+}
+
+esp_mqtt_client_handle_t host_mqtt_client_init(const char* client_id)
+{
+    return create(client_id, false);
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void* event_handler_arg)
+{
+    std::lock_guard lock(client->lock);
+    client->handlers.push_back({ event, event_handler, event_handler_arg });
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    {
+        std::lock_guard lock(client->lock);
+        if (client->started)
+            return ESP_FAIL;
+        client->started = true;
+        client->connect_now = true;
+    }
+    xTaskCreatePinnedToCore(client_task, "mqtt_task", 6144, client, 5, nullptr, tskNO_AFFINITY);
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard lock(client->lock);
+    if (!client->started)
+        return ESP_FAIL;
+    client->connect_now = true;
+    client->cv.notify_one();
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard broker_lock(s_broker);
+    client->subscriptions.clear();
+    std::lock_guard lock(client->lock);
+    if (client->connected) {
+        client->connected = false;
+        push(client, { MQTT_EVENT_DISCONNECTED, {}, {}, 0, 0, false });
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    // Task keeps running but stays disconnected
+    esp_mqtt_client_disconnect(client);
+    std::lock_guard lock(client->lock);
+    client->started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    // Client and its task are leaked, handlers may still be running
+    return esp_mqtt_client_stop(client);
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos)
+{
+    std::lock_guard broker_lock(s_broker);
+    int msg_id;
+    {
+        std::lock_guard lock(client->lock);
+        if (!client->connected)
+            return -1;
+        msg_id = client->next_msg_id++;
+    }
+
+    auto it = std::find_if(client->subscriptions.begin(), client->subscriptions.end(),
+        [topic] (const Subscription& sub) { return sub.filter == topic; });
+    if (it != client->subscriptions.end()) {
+        it->qos = qos;
+    }
+    else {
+        client->subscriptions.push_back({ topic, qos });
+    }
+
+    std::lock_guard lock(client->lock);
+    push(client, { MQTT_EVENT_SUBSCRIBED, {}, {}, msg_id, qos, false });
+    for (const auto& [retained_topic, data] : s_retained) {
+        if (matches(topic, retained_topic)) {
+            push(client, { MQTT_EVENT_DATA, retained_topic, data, 0, qos, true });
+        }
+    }
+    return msg_id;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char* topic)
+{
+    std::lock_guard broker_lock(s_broker);
+    std::erase_if(client->subscriptions, [topic] (const Subscription& sub) { return sub.filter == topic; });
+
+    std::lock_guard lock(client->lock);
+    if (!client->connected)
+        return -1;
+    const int msg_id = client->next_msg_id++;
+    push(client, { MQTT_EVENT_UNSUBSCRIBED, {}, {}, msg_id, 0, false });
+    return msg_id;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain)
+{
+    return publish(client, topic, data, len, qos, retain, false);
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain, bool store)
+{
+    return publish(client, topic, data, len, qos, retain, store);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard lock(client->lock);
+    size_t size = 0;
+    for (const Message& message : client->outbox) {
+        size += message.topic.size() + message.data.size();
+    }
+    return size;
+}
+
+void host_mqtt_set_publish_fail(int permille)
+{
+    s_publish_fail = permille;
+}
+
+void host_mqtt_stats(esp_mqtt_client_handle_t client, host_mqtt_stats_t* stats)
+{
+    stats->published = client->published;
+    stats->failed = client->failed;
+    stats->delivered = client->delivered;
+    stats->dropped = client->dropped;
+    stats->queue_peak = client->queue_peak;
+}
+
+} // extern "C"
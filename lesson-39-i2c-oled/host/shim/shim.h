@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+// Shared between the shim's sources, not part of the ESP-IDF API
+
+namespace shim {
+
+constexpr const char* TAG = "host";
+
+// Code that stands in for an interrupt handler runs inside one of these, so that
+// xPortInIsrContext() tells the truth
+class IsrScope
+{
+public:
+    IsrScope();
+    ~IsrScope();
+
+    IsrScope(const IsrScope&) = delete;
+    IsrScope& operator=(const IsrScope&) = delete;
+
+private:
+    bool m_outer;
+};
+
+// Path of a file in the state directory, empty when there is none
+std::string state_path(const char* name);
+
+// Station lost or got its connection, the MQTT clients behind it follow
+void mqtt_station_changed(bool connected);
+
+} // namespace shim
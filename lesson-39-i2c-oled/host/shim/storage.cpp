@@ -0,0 +1,407 @@
+#include <esp_partition.h>
+#include <esp_log.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "host.h"
+#include "shim.h"
+
+// NVS as a map in memory and the history partition as a byte array, both optionally
+// backed by files in the state directory
+
+namespace {
+
+std::string s_state_dir;
+
+// NVS
+
+enum class Type : uint8_t {
+    U8,
+    U16,
+    U32,
+    BLOB,
+};
+
+struct Entry {
+    Type type;
+    std::vector<uint8_t> value;
+};
+
+using Namespace = std::map<std::string, Entry>;
+
+struct Handle {
+    std::string ns;
+    bool writable;
+};
+
+std::mutex s_nvs_lock;
+bool s_nvs_ready = false;
+std::map<std::string, Namespace> s_nvs;
+std::map<nvs_handle_t, Handle> s_handles;
+nvs_handle_t s_next_handle = 1;
+
+// File format: per entry namespace, key, type, length and value, strings zero-terminated
+void nvs_load()
+{
+    const std::string path = shim::state_path("nvs.bin");
+    FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!file)
+        return;
+
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint8_t type;
+    uint32_t len;
+    while (fread(ns, sizeof(ns), 1, file) == 1 && fread(key, sizeof(key), 1, file) == 1
+           && fread(&type, 1, 1, file) == 1 && fread(&len, sizeof(len), 1, file) == 1) {
+        Entry& entry = s_nvs[ns][key];
+        entry.type = static_cast<Type>(type);
+        entry.value.resize(len);
+        if (len && fread(entry.value.data(), len, 1, file) != 1)
+            break;
+    }
+    fclose(file);
+}
+
+void nvs_save()
+{
+    const std::string path = shim::state_path("nvs.bin");
+    if (path.empty())
+        return;
+
+    FILE* file = fopen((path + ".tmp").c_str(), "wb");
+    if (!file)
+        return;
+
+    for (const auto& [ns_name, ns] : s_nvs) {
+        for (const auto& [key_name, entry] : ns) {
+            char ns_field[NVS_KEY_NAME_MAX_SIZE] = {};
+            char key_field[NVS_KEY_NAME_MAX_SIZE] = {};
+            strncpy(ns_field, ns_name.c_str(), sizeof(ns_field) - 1);
+            strncpy(key_field, key_name.c_str(), sizeof(key_field) - 1);
+            const uint8_t type = static_cast<uint8_t>(entry.type);
+            const uint32_t len = entry.value.size();
+            fwrite(ns_field, sizeof(ns_field), 1, file);
+            fwrite(key_field, sizeof(key_field), 1, file);
+            fwrite(&type, 1, 1, file);
+            fwrite(&len, sizeof(len), 1, file);
+            fwrite(entry.value.data(), len, 1, file);
+        }
+    }
+    fclose(file);
+    rename((path + ".tmp").c_str(), path.c_str());
+}
+
+esp_err_t check_key(const char* key)
+{
+    if (!key || !*key)
+        return ESP_ERR_NVS_INVALID_NAME;
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    return ESP_OK;
+}
+
+esp_err_t get(nvs_handle_t handle, const char* key, Type type, void* out, size_t* len)
+{
+    if (esp_err_t err = check_key(key); err != ESP_OK)
+        return err;
+
+    std::lock_guard lock(s_nvs_lock);
+    auto h = s_handles.find(handle);
+    if (h == s_handles.end())
+        return ESP_ERR_NVS_INVALID_HANDLE;
+
+    const Namespace& ns = s_nvs[h->second.ns];
+    auto it = ns.find(key);
+    if (it == ns.end() || it->second.type != type)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    const std::vector<uint8_t>& value = it->second.value;
+    if (type == Type::BLOB) {
+        // No buffer: only the length is wanted
+        if (!out) {
+            *len = value.size();
+            return ESP_OK;
+        }
+        if (*len < value.size()) {
+            *len = value.size();
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        *len = value.size();
+    }
+    memcpy(out, value.data(), value.size());
+    return ESP_OK;
+}
+
+esp_err_t set(nvs_handle_t handle, const char* key, Type type, const void* value, size_t len)
+{
+    if (esp_err_t err = check_key(key); err != ESP_OK)
+        return err;
+
+    std::lock_guard lock(s_nvs_lock);
+    auto h = s_handles.find(handle);
+    if (h == s_handles.end())
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->second.writable)
+        return ESP_ERR_NVS_READ_ONLY;
+
+    Entry& entry = s_nvs[h->second.ns][key];
+    entry.type = type;
+    entry.value.assign(static_cast<const uint8_t*>(value), static_cast<const uint8_t*>(value) + len);
+    return ESP_OK;
+}
+
+// Partition
+
+constexpr const uint32_t HISTORY_SIZE = 1024 * 1024;
+constexpr const uint32_t SECTOR_SIZE = 4096;
+constexpr const uint32_t PAGE_SIZE = 256;
+constexpr const auto SECTOR_ERASE_TIME = std::chrono::microseconds(45000);     // Typical of SPI NOR flash
+constexpr const auto PAGE_PROGRAM_TIME = std::chrono::microseconds(700);
+
+std::mutex s_flash_lock;
+std::vector<uint8_t> s_history;
+FILE* s_history_file = nullptr;
+
+esp_partition_t s_history_partition = {
+    .flash_chip = nullptr,
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = ESP_PARTITION_SUBTYPE_DATA_UNDEFINED,
+    .address = 0x210000,
+    .size = HISTORY_SIZE,
+    .erase_size = SECTOR_SIZE,
+    .label = "history",
+    .encrypted = false,
+    .readonly = false,
+};
+
+void history_open()
+{
+    if (!s_history.empty())
+        return;
+
+    s_history.assign(HISTORY_SIZE, 0xFF);
+    const std::string path = shim::state_path("history.bin");
+    if (path.empty())
+        return;
+
+    s_history_file = fopen(path.c_str(), "r+b");
+    if (s_history_file) {
+        if (fread(s_history.data(), HISTORY_SIZE, 1, s_history_file) != 1) {
+            ESP_LOGW(shim::TAG, "%s is shorter than the partition, rest is erased", path.c_str());
+        }
+    }
+    else {
+        s_history_file = fopen(path.c_str(), "w+b");
+    }
+    if (s_history_file) {
+        fseek(s_history_file, 0, SEEK_SET);
+        fwrite(s_history.data(), HISTORY_SIZE, 1, s_history_file);
+        fflush(s_history_file);
+    }
+}
+
+// With s_flash_lock held
+void history_sync(size_t offset, size_t size)
+{
+    if (s_history_file) {
+        fseek(s_history_file, offset, SEEK_SET);
+        fwrite(&s_history[offset], size, 1, s_history_file);
+        fflush(s_history_file);
+    }
+}
+
+esp_err_t check_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    if (partition != &s_history_partition)
+        return ESP_ERR_INVALID_ARG;
+    if (offset > partition->size || size > partition->size - offset)
+        return ESP_ERR_INVALID_SIZE;
+    return ESP_OK;
+}
+
+} // namespace
+
+namespace shim {
+
+std::string state_path(const char* name)
+{
+    return s_state_dir.empty() ? std::string() : s_state_dir + "/" + name;
+}
+
+} // namespace shim
+
+extern "C" {
+
+void host_set_state_dir(const char* dir)
+{
+    s_state_dir = dir ? dir : "";
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    std::lock_guard lock(s_nvs_lock);
+    if (!s_nvs_ready) {
+        nvs_load();
+        s_nvs_ready = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    std::lock_guard lock(s_nvs_lock);
+    s_nvs.clear();
+    nvs_save();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle)
+{
+    if (esp_err_t err = check_key(namespace_name); err != ESP_OK)
+        return err;
+
+    std::lock_guard lock(s_nvs_lock);
+    if (!s_nvs_ready)
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+
+    // Read-only can't create the namespace
+    if (open_mode == NVS_READONLY && !s_nvs.count(namespace_name))
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    s_nvs[namespace_name];
+    *out_handle = s_next_handle++;
+    s_handles[*out_handle] = { namespace_name, open_mode == NVS_READWRITE };
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard lock(s_nvs_lock);
+    s_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    std::lock_guard lock(s_nvs_lock);
+    if (!s_handles.count(handle))
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    nvs_save();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key)
+{
+    std::lock_guard lock(s_nvs_lock);
+    auto h = s_handles.find(handle);
+    if (h == s_handles.end())
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!h->second.writable)
+        return ESP_ERR_NVS_READ_ONLY;
+    return s_nvs[h->second.ns].erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length)
+{
+    return get(handle, key, Type::BLOB, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length)
+{
+    return set(handle, key, Type::BLOB, value, length);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value)
+{
+    return get(handle, key, Type::U8, out_value, nullptr);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value)
+{
+    return set(handle, key, Type::U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* out_value)
+{
+    return get(handle, key, Type::U16, out_value, nullptr);
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value)
+{
+    return set(handle, key, Type::U16, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value)
+{
+    return get(handle, key, Type::U32, out_value, nullptr);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value)
+{
+    return set(handle, key, Type::U32, &value, sizeof(value));
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label)
+{
+    if ((type != ESP_PARTITION_TYPE_ANY && type != s_history_partition.type)
+        || (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != s_history_partition.subtype)
+        || (label && strcmp(label, s_history_partition.label)))
+        return nullptr;
+
+    std::lock_guard lock(s_flash_lock);
+    history_open();
+    return &s_history_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size)
+{
+    if (esp_err_t err = check_range(partition, src_offset, size); err != ESP_OK)
+        return err;
+
+    std::lock_guard lock(s_flash_lock);
+    memcpy(dst, &s_history[src_offset], size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size)
+{
+    if (esp_err_t err = check_range(partition, dst_offset, size); err != ESP_OK)
+        return err;
+
+    // Programming only clears bits, one page program per 256 byte page touched
+    std::lock_guard lock(s_flash_lock);
+    auto data = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; ++i) {
+        s_history[dst_offset + i] &= data[i];
+    }
+    history_sync(dst_offset, size);
+
+    const size_t pages = size ? (dst_offset + size - 1) / PAGE_SIZE - dst_offset / PAGE_SIZE + 1 : 0;
+    std::this_thread::sleep_for(PAGE_PROGRAM_TIME * pages);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    if (esp_err_t err = check_range(partition, offset, size); err != ESP_OK)
+        return err;
+    if (offset % SECTOR_SIZE || size % SECTOR_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard lock(s_flash_lock);
+    memset(&s_history[offset], 0xFF, size);
+    history_sync(offset, size);
+    std::this_thread::sleep_for(SECTOR_ERASE_TIME * (size / SECTOR_SIZE));
+    return ESP_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,48 @@
+#include "BootTimeline.h"
+
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#include <algorithm>
+
+#include "common.h"
+
+static const char* const STAGE_NAMES[BootTimeline::STAGES] = {
+    "start",
+    "i2c",
+    "bmp280",
+    "ds1307",
+    "at24c32",
+    "ssd1306",
+    "history",
+    "tasks",
+    "nvs",
+    "wifi started",
+    "wifi connected",
+    "mqtt connected",
+    "first frame",
+    "first reading",
+    "first publish",
+};
+
+void BootTimeline::Mark(Stage stage)
+{
+    if (stage < 0 || stage >= STAGES || Reached(stage))
+        return;
+
+    // esp_timer starts early in boot, only the ROM and 2nd stage bootloader are missing
+    const uint32_t ms = std::max<uint32_t>(1, esp_timer_get_time() / 1000);
+    uint32_t expected = 0;
+    if (!m_ms[stage].compare_exchange_strong(expected, ms))
+        return;
+
+    ESP_LOGI(TAG, "Boot: %-14s %6lu ms", STAGE_NAMES[stage], (unsigned long) ms);
+
+    if (Reached(STAGE_FIRST_FRAME) && Reached(STAGE_FIRST_READING) && Reached(STAGE_FIRST_PUBLISH)
+        && !m_reported.exchange(true)) {
+        ESP_LOGI(TAG, "Boot: first frame after %lu ms, first reading after %lu ms, first publish after %lu ms",
+            (unsigned long) m_ms[STAGE_FIRST_FRAME],
+            (unsigned long) m_ms[STAGE_FIRST_READING],
+            (unsigned long) m_ms[STAGE_FIRST_PUBLISH]);
+    }
+}
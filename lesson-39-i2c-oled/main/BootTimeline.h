@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Milestones of the start-up, stamped with the time since boot when first reached.
+// Stages complete on different tasks (setup runs partly in parallel), so every mark
+// is logged as it happens and a summary follows once the node has drawn its first
+// frame, taken its first reading and published for the first time.
+class BootTimeline
+{
+public:
+    enum Stage {
+        STAGE_START,
+        STAGE_I2C,
+        STAGE_BMP280,
+        STAGE_DS1307,
+        STAGE_AT24C32,
+        STAGE_SSD1306,
+        STAGE_HISTORY,
+        STAGE_TASKS,
+        STAGE_NVS,
+        STAGE_WIFI_STARTED,
+        STAGE_WIFI_CONNECTED,
+        STAGE_MQTT_CONNECTED,
+        STAGE_FIRST_FRAME,
+        STAGE_FIRST_READING,
+        STAGE_FIRST_PUBLISH,
+        STAGES
+    };
+
+    BootTimeline() = default;
+
+    // Only the first mark of a stage counts, later ones are cheap no-ops
+    void Mark(Stage stage);
+
+    bool Reached(Stage stage) const { return m_ms[stage].load(std::memory_order_relaxed) != 0; }
+
+private:
+    std::atomic<uint32_t> m_ms[STAGES] = {};        // Milliseconds since boot, 0 = not reached
+    std::atomic<bool> m_reported = false;
+};
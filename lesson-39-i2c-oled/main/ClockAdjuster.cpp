@@ -4,6 +4,7 @@
 #include <cstring>
 
 #include "common.h"
+#include "FixedFormat.h"
 
 ESP_EVENT_DEFINE_BASE(EVENT_CLOCK_ADJUSTER);
 
@@ -13,10 +14,11 @@ enum event_id_t
     CLICK_EVENT_ID,
 };
 
-ClockAdjuster::ClockAdjuster(callback_t get_callback, callback_t set_callback)
+ClockAdjuster::ClockAdjuster(callback_t get_callback, callback_t set_callback, rotate_callback_t idle_rotate_callback)
     : m_display(3)
     , m_get_callback(get_callback)
     , m_set_callback(set_callback)
+    , m_idle_rotate_callback(idle_rotate_callback)
     , m_encoder(CONFIG_PIN_ENCODER_S1, CONFIG_PIN_ENCODER_S2, [this](bool decrease) { on_rotate(decrease); })
     , m_encoder_key(CONFIG_PIN_ENCODER_KEY, [this] { on_click(); })
 {
@@ -138,6 +140,11 @@ void ClockAdjuster::on_event(esp_event_base_t event_base, int32_t event_id, void
         int increment = decrease ? -1 : 1;
 
         switch (m_state) {
+            case Wait:
+                // Encoder is free for others until a click starts the adjustment
+                if (m_idle_rotate_callback)
+                    m_idle_rotate_callback(decrease);
+                break;
             case Year:
                 m_time_info.tm_year += increment;
                 break;
@@ -183,6 +190,11 @@ void ClockAdjuster::on_event(esp_event_base_t event_base, int32_t event_id, void
 
 void ClockAdjuster::update_display()
 {
+    // Field letter and two digits, e.g. "Y25"
+    auto field = [] (char* buf, char letter, unsigned value) {
+        FixedFormat::End(FixedFormat::TwoDigits(FixedFormat::Char(buf, letter), value));
+    };
+
     char buf[4];
     switch (m_state) {
         case Wait:
@@ -190,15 +202,15 @@ void ClockAdjuster::update_display()
                 m_display.PrintWaitIndicator();
             break;
         case Year:
-            snprintf(buf, sizeof(buf), "Y%02u", m_time_info.tm_year % 100);
+            field(buf, 'Y', m_time_info.tm_year % 100);
             m_display.PrintText(buf);
             break;
         case Month:
-            snprintf(buf, sizeof(buf), "M%02u", m_time_info.tm_mon + 1);
+            field(buf, 'M', m_time_info.tm_mon + 1);
             m_display.PrintText(buf);
             break;
         case Day:
-            snprintf(buf, sizeof(buf), "D%02u", m_time_info.tm_mday);
+            field(buf, 'D', m_time_info.tm_mday);
             m_display.PrintText(buf);
             break;
         case WeekDay:
@@ -206,11 +218,11 @@ void ClockAdjuster::update_display()
             m_display.PrintText(buf);
             break;
         case Hour:
-            snprintf(buf, sizeof(buf), "H%02u", m_time_info.tm_hour);
+            field(buf, 'H', m_time_info.tm_hour);
             m_display.PrintText(buf);
             break;
         case Minute:
-            snprintf(buf, sizeof(buf), " %02u", m_time_info.tm_min);
+            field(buf, ' ', m_time_info.tm_min);
             m_display.PrintText(buf);
             break;
         default:
@@ -25,8 +25,10 @@ class ClockAdjuster
 
 public:
     using callback_t = std::function<void(tm*)>;
+    using rotate_callback_t = std::function<void(bool decrease)>;
 
-    ClockAdjuster(callback_t get_callback, callback_t set_callback);
+    // idle_rotate_callback gets the encoder's turns while no clock field is being edited
+    ClockAdjuster(callback_t get_callback, callback_t set_callback, rotate_callback_t idle_rotate_callback = nullptr);
     ~ClockAdjuster();
 
     S7_Display* Display() { return &m_display; };
@@ -38,6 +40,7 @@ private:
     S7_Display m_display;
     callback_t m_get_callback;
     callback_t m_set_callback;
+    rotate_callback_t m_idle_rotate_callback;
 
     RotaryEncoder m_encoder;
     Button m_encoder_key;
@@ -1,46 +1,196 @@
 ﻿#include "EnvironmentMonitor.h"
 
 #include <freertos/queue.h>
+#include <esp_cpu.h>
 #include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 #include <esp_wifi.h>
 #include <mqtt_client.h>
 
 #include <cstring>
 #include <cmath>
+#include <sys/time.h>
 
 #include "common.h"
+#include "FixedFormat.h"
+#include "TopicRouter.h"
 #include "wifi_creds.h"
 #include "mqtt_creds.h"
 
 #define WIFI_CONNECTED_BIT BIT0
 #define MQTT_STARTED_BIT   BIT1
 #define MQTT_CONNECTED_BIT BIT2
+#define NET_SETUP_DONE_BIT BIT3
+
+// Sampling settings of this node, can be overridden next to MQTT_SUB_TOPIC in mqtt_creds.h
+#ifndef MQTT_CONTROL_TOPIC
+#define MQTT_CONTROL_TOPIC MQTT_PUB_TOPIC "/control"
+#endif
+
+constexpr const int64_t WAKEUP_STATS_INTERVAL_US = 10 * 1000 * 1000LL;     // 10 s
+
+static TickType_t ticks_to_next_second()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    // A timeout of n ticks ends at the n-th tick interrupt, which is between n - 1 and n
+    // tick periods away. Rounding up plus one tick wakes the task after the second has
+    // turned over, at most two ticks late.
+    const uint32_t us = 1000 * 1000 - tv.tv_usec;
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    return (us + tick_us - 1) / tick_us + 1;
+}
+
+// Remote mode: last level of a received topic -> OLED line
+static constexpr TopicRoute REMOTE_ROUTES[] = {
+    { "temp",        "/temp", 3 },
+    { "temperature", "/temp", 3 },
+    { "pres",        "/pres", 4 },
+    { "pressure",    "/pres", 4 },
+    { "hum",         "/hum",  5 },
+    { "humi",        "/hum",  5 },
+    { "humidity",    "/hum",  5 },
+};
+
+static constexpr TopicRouter REMOTE_ROUTER(REMOTE_ROUTES);
+static_assert(REMOTE_ROUTER.IsValid(), "Can't build perfect hash for remote topics");
+
+constexpr const int64_t REMOTE_PAGE_US = CONFIG_REMOTE_PAGE_S * 1000 * 1000LL;
+
+// Metric lines 3..5 of the local readings and the node pages: "T: 21.5 C", "P: 1013 hPa", "H: 45.0 %"
+struct MetricFormat {
+    const char* label;
+    int decimals;
+    int width;
+    const char* unit;
+};
+static constexpr MetricFormat METRIC_FORMATS[NodeTable::METRICS] = {
+    { "T: ", 1, 0, " C" },
+    { "P: ", 0, 4, " hPa" },
+    { "H: ", 1, 0, " %" },
+};
+constexpr const size_t METRIC_LINE_SIZE = 3 + FixedFormat::MAX_FIXED + 4 + 1;
+
+// CPU cycles spent in format_metric(), reported with the wakeup rate. Only update_task formats.
+static uint32_t s_format_cycles = 0;
+static uint32_t s_format_lines = 0;
+
+static void format_metric(char (&line)[METRIC_LINE_SIZE], int metric, float value)
+{
+    const uint32_t start = esp_cpu_get_cycle_count();
+    const MetricFormat& format = METRIC_FORMATS[metric];
+    char* p = FixedFormat::Text(line, format.label);
+    if (std::isnan(value)) {
+        p = FixedFormat::Text(p, "--");
+    }
+    else {
+        p = FixedFormat::Fixed(p, value, format.decimals, format.width);
+        p = FixedFormat::Text(p, format.unit);
+    }
+    FixedFormat::End(p);
+
+    s_format_cycles += esp_cpu_get_cycle_count() - start;
+    ++s_format_lines;
+}
+
+// Clock occupies pages 0 .. CLOCK_SCALE - 1, 3x digits fit on the screen without seconds only
+constexpr const int CLOCK_SCALE = CONFIG_CLOCK_DIGIT_SCALE;
+constexpr const bool CLOCK_SECONDS = CLOCK_SCALE != 3;
+constexpr const int CLOCK_COL = CLOCK_SCALE == 3 ? 4 : 0;
+constexpr const int DATE_PAGE = CLOCK_SCALE == 3 ? 6 : CLOCK_SCALE;
+
+// Publish policies of the local readings, deadbands are in units of Sample fields
+static constexpr PublishPolicy::Config policy_config(float abs_deadband)
+{
+    return {
+        .abs_deadband = abs_deadband,
+        .rel_deadband = CONFIG_PUBLISH_DEADBAND_REL / 1000.f,
+        .min_interval_ms = CONFIG_PUBLISH_MIN_INTERVAL_MS,
+        .max_silence_ms = CONFIG_PUBLISH_MAX_SILENCE_S * 1000,
+    };
+}
+
+constexpr const PublishPolicy::Config TEMP_POLICY = policy_config(CONFIG_PUBLISH_DEADBAND_TEMP / 100.f);    // C
+constexpr const PublishPolicy::Config PRES_POLICY = policy_config(CONFIG_PUBLISH_DEADBAND_PRES);            // Pa
+constexpr const PublishPolicy::Config HUMI_POLICY = policy_config(CONFIG_PUBLISH_DEADBAND_HUMI / 100.f);    // %
 
 EnvironmentMonitor::EnvironmentMonitor()
     : m_clock_adjuster(
         [this] (tm* info) { *info = m_local_time; },     // Get time callback
-        [this] (tm* info) { m_new_time = *info; })       // Set time callback
+        [this] (tm* info) {                                 // Set time callback
+            m_new_time = *info;
+            if (m_task) {
+                xTaskNotifyGive(m_task);
+            }
+        },
+        [this] (bool decrease) {                            // Encoder turned while not adjusting
+            m_console_scroll += decrease ? -1 : 1;
+            if (m_task) {
+                xTaskNotifyGive(m_task);
+            }
+        })
     , m_mode_switcher(CONFIG_PIN_DEVKIT_BUTTON, [this] { on_mode_switch(); })
+    , m_sampler(&m_bus, [this] (const SensorSampler::Sample& sample) { on_sample(sample); })
+    , m_uploader(&m_history, [this] { return (xEventGroupGetBits(m_wifi_event_group) & WIFI_CONNECTED_BIT) != 0; })
+    , m_temp_policy(TEMP_POLICY)
+    , m_pres_policy(PRES_POLICY)
+    , m_humi_policy(HUMI_POLICY)
 {
+    m_boot.Mark(BootTimeline::STAGE_START);
     ESP_LOGI(TAG, "Running on core #%d", xPortGetCoreID());
-    m_queue = xQueueCreate(10, sizeof(QueueMessage));
+    m_queue = xQueueCreate(m_messages.SIZE, sizeof(uint16_t));
     assert(m_queue);
+    m_sample_queue = xQueueCreate(1, sizeof(SensorSampler::Sample));
+    assert(m_sample_queue);
+    m_wifi_event_group = xEventGroupCreate();
+    assert(m_wifi_event_group);
+
+    if (!m_tz.Parse(CONFIG_LOCAL_TIMEZONE)) {
+        ESP_LOGE(TAG, "Unsupported timezone \"%s\", using UTC", CONFIG_LOCAL_TIMEZONE);
+    }
+
+    setup_power();
+
+    // NVS and Wi-Fi don't need any I2C device, bring them up meanwhile on another task
+    xTaskCreatePinnedToCore(
+        member_cast<TaskFunction_t>(&EnvironmentMonitor::net_setup_task),
+        "net_setup_task",
+        4096,
+        this,
+        5,
+        nullptr,
+        tskNO_AFFINITY          // Free to run on the other core while this one talks to I2C
+    );
 
     ESP_ERROR_CHECK(i2cdev_init());
+    m_boot.Mark(BootTimeline::STAGE_I2C);
 
     setup_bmp280();
+    m_boot.Mark(BootTimeline::STAGE_BMP280);
     setup_ds1307();
+    m_boot.Mark(BootTimeline::STAGE_DS1307);
+    setup_at24c32();
+    m_boot.Mark(BootTimeline::STAGE_AT24C32);
     setup_ssd1306();
-    setup_nvs();
-    setup_wifi();
+    m_boot.Mark(BootTimeline::STAGE_SSD1306);
+    setup_history();
+    m_boot.Mark(BootTimeline::STAGE_HISTORY);
     setup_task();
+    m_boot.Mark(BootTimeline::STAGE_TASKS);
 }
 
 EnvironmentMonitor::~EnvironmentMonitor()
 {
     m_stop_task = true;
 
+    xEventGroupWaitBits(m_wifi_event_group, NET_SETUP_DONE_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    m_uploader.Stop();
+    #ifdef CONFIG_BROKER_ENABLE
+    m_broker.Stop();
+    #endif
     esp_wifi_stop();
     esp_wifi_deinit();
     esp_netif_destroy_default_wifi(m_netif);
@@ -48,21 +198,37 @@ EnvironmentMonitor::~EnvironmentMonitor()
     vEventGroupDelete(m_wifi_event_group);
 }
 
-void EnvironmentMonitor::setup_bmp280()
+void EnvironmentMonitor::setup_power()
 {
-    bmp280_params_t params = {};
-    ESP_ERROR_CHECK(bmp280_init_default_params(&params));
+    #ifdef CONFIG_PM_ENABLE
+    // Frequency scaling always, automatic light sleep on request. Either only kicks in
+    // when every task is blocked, which is why update_task sleeps until the next event.
+    esp_pm_config_t config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        #ifdef CONFIG_AUTO_LIGHT_SLEEP
+        .light_sleep_enable = true,
+        #else
+        .light_sleep_enable = false,
+        #endif
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&config));
+    #endif
+}
 
-    ESP_ERROR_CHECK(bmp280_init_desc(&m_bmp280,
+void EnvironmentMonitor::setup_bmp280()
+{
+    ESP_ERROR_CHECK(m_sampler.Init(
         CONFIG_I2C_BMP280_ADDR, I2C_NUM_0,
         static_cast<gpio_num_t>(CONFIG_I2CDEV_DEFAULT_SDA_PIN),
         static_cast<gpio_num_t>(CONFIG_I2CDEV_DEFAULT_SCL_PIN)));
 
-    ESP_ERROR_CHECK(bmp280_init(&m_bmp280, &params));
+    ESP_LOGI(TAG, "BMP280 conversion time: %lu us", (unsigned long) m_sampler.ConversionTimeUs());
 }
 
 void EnvironmentMonitor::setup_ds1307()
 {
+    m_ds1307_bus_device = m_bus.AddDevice("ds1307");
     ESP_ERROR_CHECK(ds1307_init_desc(&m_ds1307, I2C_NUM_0,
         static_cast<gpio_num_t>(CONFIG_I2CDEV_DEFAULT_SDA_PIN),
         static_cast<gpio_num_t>(CONFIG_I2CDEV_DEFAULT_SCL_PIN)));
@@ -72,6 +238,26 @@ void EnvironmentMonitor::setup_ds1307()
     set_system_time(&rtc_time);
 }
 
+void EnvironmentMonitor::setup_at24c32()
+{
+    esp_err_t err = m_backlog.Open(I2C_NUM_0, CONFIG_I2C_AT24C32_ADDR,
+        static_cast<gpio_num_t>(CONFIG_I2CDEV_DEFAULT_SDA_PIN),
+        static_cast<gpio_num_t>(CONFIG_I2CDEV_DEFAULT_SCL_PIN));
+
+    // Not fatal: the monitor still works online, it just can't keep readings while offline
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "AT24C32 not available (%s), offline readings will be lost", esp_err_to_name(err));
+    }
+}
+
+void EnvironmentMonitor::setup_history()
+{
+    // Not fatal either, only long-term history is missing then
+    if (esp_err_t err = m_history.Open("history"); err != ESP_OK) {
+        ESP_LOGW(TAG, "History partition not available (%s)", esp_err_to_name(err));
+    }
+}
+
 void EnvironmentMonitor::setup_ssd1306()
 {
     i2cdev_get_shared_handle(I2C_NUM_0, reinterpret_cast<void**>(&m_oled._i2c_bus_handle));
@@ -89,231 +275,666 @@ void EnvironmentMonitor::setup_ssd1306()
 
 void EnvironmentMonitor::setup_task()
 {
+    // From now on every I2C transaction goes through the bus task
+    m_bus.Start();
+
     xTaskCreatePinnedToCore(
         member_cast<TaskFunction_t>(&EnvironmentMonitor::update_task),
         "update_task",          // A descriptive name for debugging
         4096,                   // Stack size (4096 bytes is very safe for I2C and OLED strings)
         this,                   // Parameter passed to the task (pointer to object)
         5,                      // Task priority (0 is lowest, configMAX_PRIORITIES-1 is highest)
-        nullptr,                // No task handle needed
+        &m_task,                // Task handle is used to notify the task about new messages
         xPortGetCoreID()        // Pin to the same core
     );
+
+    m_sampler.Start(CONFIG_SENSOR_SAMPLE_PERIOD_MS);
 }
 
-void EnvironmentMonitor::update_task()
+void EnvironmentMonitor::net_setup_task()
 {
-    const TickType_t xTimeout = pdMS_TO_TICKS(100);
+    setup_nvs();
+    m_boot.Mark(BootTimeline::STAGE_NVS);
+
+    // Sampler started with the defaults meanwhile, switch it to the stored settings
+    if (m_sampling.Load() == ESP_OK) {
+        m_sampler.Wake();
+    }
+    setup_wifi();
+    m_boot.Mark(BootTimeline::STAGE_WIFI_STARTED);
+
+    // Upload offset is in NVS as well, the task waits for Wi-Fi on its own
+    m_uploader.Start(CONFIG_HISTORY_UPLOAD_URL, CONFIG_HISTORY_UPLOAD_INTERVAL_S);
+
+    #ifdef CONFIG_BROKER_ENABLE
+    // Listening works before the station has an address
+    m_broker.Start(CONFIG_BROKER_PORT);
+    #endif
+
+    xEventGroupSetBits(m_wifi_event_group, NET_SETUP_DONE_BIT);
+    vTaskDelete(nullptr);
+}
 
+void EnvironmentMonitor::update_task()
+{
     const char PROGRESS[] = "-\\|/";
     int p_index = 0;
 
-    uint64_t counter = 0;
+    int shown_sec = -1;
+    bool shown_remote = false;
+    bool shown_node = false;
+    size_t node_page = 0;               // 0: live remote view, n: n-th node of the table
+    int64_t page_time = 0;
+    uint32_t wakeups = 0;
+    int64_t wakeups_start = esp_timer_get_time();
 
     typedef char line_t[17];
 
     while (!m_stop_task) {
+        // Sleep until MQTT data, a log message or a sample arrives, or the next second begins.
+        // Waiting first means a clock drawn for the new second goes out with this frame.
+        const TickType_t timeout = ticks_to_next_second();
+        m_update_loop.End(timeout);
+        const bool timed_out = !ulTaskNotifyTake(pdTRUE, timeout);
+        m_update_loop.Begin(timed_out);
+
         if (m_new_time.tm_year) {
             m_local_time = m_new_time;
             set_system_time();
             memset(&m_new_time, 0, sizeof(m_new_time));
+            shown_sec = -1;
         }
 
-        if (get_local_time()) {
-            line_t line_0 = {};
-            strftime(line_0, sizeof(line_0), "%H:%M:%S", &m_local_time);
-            ssd1306_display_text(&m_oled, 0, line_0, 16, false);
-
-            line_t line_1 = {};
-            strftime(line_1, sizeof(line_1), "%a %d.%m.%Y", &m_local_time);
-            ssd1306_display_text(&m_oled, 1, line_1, 16, false);
+        // Clock changes once a second, don't redraw it for every other wakeup
+        if (get_local_time() && m_local_time.tm_sec != shown_sec) {
+            shown_sec = m_local_time.tm_sec;
+            draw_clock();
         }
 
         line_t lines[3] = {};
 
-        QueueMessage qmsg;
-        if (xQueueReceive(m_queue, &qmsg, xTimeout)) {
-            switch (qmsg.type) {
-                case LogType:
-                    log_to_screen(7, qmsg.message);
-                    break;
-                case EventType:
-                    if (m_remote_mode) {
-                        // Display remote data from MQTT
-                        if (std::strstr(qmsg.topic, "/temp")) {
-                            snprintf(lines[0], sizeof(lines[0]), "/temp :%9s", qmsg.data);
-                            ssd1306_display_text(&m_oled, 3, lines[0], 16, false);
-                        }
-                        if (std::strstr(qmsg.topic, "/pres")) {
-                            snprintf(lines[1], sizeof(lines[1]), "/pres :%9s", qmsg.data);
-                            ssd1306_display_text(&m_oled, 4, lines[1], 16, false);
-                        }
-                        if (std::strstr(qmsg.topic, "/hum")) {
-                            snprintf(lines[2], sizeof(lines[2]), "/hum  :%9s", qmsg.data);
-                            ssd1306_display_text(&m_oled, 5, lines[2], 16, false);
-                        }
-                        log_to_screen(7, qmsg.topic);
-                    }
-                    else {
-                        // Otherwise just show some activity from MQTT
-                        log_to_screen(7, "MQTT [%c]", PROGRESS[p_index++ % 4]);
-                    }
-                    break;
-                default:
-                    break;
+        ++wakeups;
+        if (int64_t elapsed = esp_timer_get_time() - wakeups_start; elapsed >= WAKEUP_STATS_INTERVAL_US) {
+            char rate[FixedFormat::MAX_FIXED + 1];
+            FixedFormat::End(FixedFormat::Fixed(rate, wakeups * 1e6f / elapsed, 2));
+            ESP_LOGI(TAG, "update_task: %s wakeups/s, %lu MQTT updates superseded, %lu publishes suppressed, "
+                "MQTT topics peak %u/%d, %lu dropped, log blocks peak %u/%u, %lu dropped, %lu cycles per metric line",
+                rate, (unsigned long) m_latest.Superseded(),
+                (unsigned long) (m_temp_policy.Suppressed() + m_pres_policy.Suppressed() + m_humi_policy.Suppressed()),
+                (unsigned) m_latest.HighWater(), LatestValueTable::SLOTS, (unsigned long) m_latest.Dropped(),
+                (unsigned) m_messages.Peak(), (unsigned) m_messages.SIZE, (unsigned long) m_messages.Exhausted(),
+                (unsigned long) (s_format_lines ? s_format_cycles / s_format_lines : 0));
+            wakeups = 0;
+            s_format_cycles = 0;
+            s_format_lines = 0;
+            wakeups_start += elapsed;
+        }
+
+        // Remote mode pages through its live view and every node of the table
+        if (const int64_t now = esp_timer_get_time(); !m_remote_mode) {
+            node_page = 0;
+        }
+        else if (now - page_time >= REMOTE_PAGE_US) {
+            page_time = now;
+            node_page = m_nodes.Count() ? (node_page + 1) % (m_nodes.Count() + 1) : 0;
+        }
+
+        if (m_remote_mode != shown_remote || (node_page != 0) != shown_node) {
+            // Metric lines switch between local readings, remote values with graphs and node pages
+            shown_remote = m_remote_mode;
+            shown_node = node_page != 0;
+            for (int i = 0; i < SPARKLINES; ++i) {
+                m_screen.ClearPage(SPARKLINE_PAGE + i);
+                if (shown_remote && !shown_node)
+                    m_sparklines[i].Show();
+                else
+                    m_sparklines[i].Hide();
             }
         }
 
-        ssd1306_clear_line(&m_oled, 2, false);
+        // At most one update per topic per frame, older values have been coalesced away.
+        // Bounded, so topics arriving while the frame is drawn wait for the next one.
+        LatestValueTable::Value value;
+        for (int taken = 0; taken < LatestValueTable::SLOTS && m_latest.Take(&value); ++taken) {
+            if (value.superseded) {
+                ESP_LOGD(TAG, "%.*s: skipped %lu stale updates", (int) value.topic_len, value.topic, (unsigned long) value.superseded);
+            }
 
-        if (++counter % 10 != 0)
-            continue;
+            // History is recorded in both modes, so graphs are complete when switching to remote
+            auto route = REMOTE_ROUTER.Find({ value.topic, value.topic_len });
+            const int graph = route ? route->line - SPARKLINE_PAGE : -1;
+            if (graph >= 0 && graph < SPARKLINES) {
+                char number[LatestValueTable::MAX_DATA + 1] = {};
+                memcpy(number, value.data, value.data_len);
+                m_sparklines[graph].Add(strtof(number, nullptr));
+            }
 
-        float temp = NAN;
-        float pres = NAN;
-        float humi = NAN;
+            if (m_remote_mode && !node_page) {
+                // Display remote data from MQTT, text on the left, graph on the right
+                if (route) {
+                    snprintf(lines[0], sizeof(lines[0]), "%-5s %5.*s", route->label, (int) std::min<size_t>(value.data_len, 5), value.data);
+                    m_screen.DrawText(route->line, lines[0], REMOTE_TEXT_CHARS);
+                }
+                snprintf(lines[0], sizeof(lines[0]), "%.*s", (int) value.topic_len, value.topic);
+                m_console.Update(lines[0]);
+            }
+            else if (!m_remote_mode) {
+                // Otherwise just show some activity from MQTT, on a single console line
+                snprintf(lines[0], sizeof(lines[0]), "MQTT [%c]", PROGRESS[p_index++ % 4]);
+                m_console.Update(lines[0]);
+            }
+        }
 
-        if (bmp280_read_float(&m_bmp280, &temp, &pres, &humi) == ESP_OK) {
-            if (!m_remote_mode) {
-                snprintf(lines[0], sizeof(lines[0]), "T: %.1f C", temp);
-                ssd1306_display_text(&m_oled, 3, lines[0], 16, false);
+        // Redrawn every wakeup, the framebuffer sends only what changed
+        if (node_page) {
+            draw_node(node_page - 1);
+        }
 
-                snprintf(lines[1], sizeof(lines[1]), "P: %4u hPa", (uint) (pres / 100.f));
-                ssd1306_display_text(&m_oled, 4, lines[1], 16, false);
+        uint16_t index;
+        while (xQueueReceive(m_queue, &index, 0)) {
+            m_console.Print(m_messages[index].message);
+            m_messages.Release(index);
+        }
 
-                snprintf(lines[2], sizeof(lines[2]), "H: %.1f %%", humi);
-                ssd1306_display_text(&m_oled, 5, lines[2], 16, false);
-            }
+        // Turning the encoder up goes back through older log rows, down to 0 follows the newest
+        if (const int turns = m_console_scroll.exchange(0)) {
+            m_console.ScrollBack(m_console.Scrolled() + turns);
         }
-        else {
-            if (!m_remote_mode) {
-                ssd1306_clear_line(&m_oled, 3, false);
-                ssd1306_clear_line(&m_oled, 4, false);
-                ssd1306_clear_line(&m_oled, 5, false);
-            }
-            log_to_screen(7, "BME280 error");
+
+        if (CLOCK_SCALE == 1) {
+            m_screen.ClearPage(2);
         }
 
-        auto uxBits = xEventGroupWaitBits(m_wifi_event_group, WIFI_CONNECTED_BIT | MQTT_CONNECTED_BIT, pdFALSE, pdFALSE, 0);
-        if (uxBits & WIFI_CONNECTED_BIT) {
-            if (uxBits & MQTT_CONNECTED_BIT) {
-                if (!std::isnan(temp)) {
-                    snprintf(lines[0], sizeof(lines[0]), "%.1f", temp);
-                    esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/temp", lines[0], 0, 0, 0);
-                }
-                if (!std::isnan(pres)) {
-                    snprintf(lines[1], sizeof(lines[1]), "%u", (uint) (pres / 100.f));
-                    esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/pres", lines[1], 0, 0, 0);
-                }
-                if (!std::isnan(humi)) {
-                    snprintf(lines[2], sizeof(lines[2]), "%.1f", humi);
-                    esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/humi", lines[2], 0, 0, 0);
+        // Sensor data arrives from the sampler task at its own cadence
+        SensorSampler::Sample sample;
+        if (xQueueReceive(m_sample_queue, &sample, 0)) {
+            if (sample.valid) {
+                if (!m_remote_mode) {
+                    // Pressure is cut to whole hPa, not rounded
+                    const float values[NodeTable::METRICS] = { sample.temp, std::trunc(sample.pres / 100.f), sample.humi };
+                    char line[METRIC_LINE_SIZE];
+                    for (int i = 0; i < NodeTable::METRICS; ++i) {
+                        format_metric(line, i, values[i]);
+                        m_screen.DrawText(SPARKLINE_PAGE + i, line);
+                    }
                 }
             }
             else {
-                log_to_screen(7, "MQTT not ready");
+                if (!m_remote_mode) {
+                    m_screen.ClearPage(3);
+                    m_screen.ClearPage(4);
+                    m_screen.ClearPage(5);
+                }
+                m_console.Print("BME280 error");
             }
         }
-        else {
-            log_to_screen(7, "Wi-Fi disconnect");
+
+        if (m_screen.Flush()) {
+            m_boot.Mark(BootTimeline::STAGE_FIRST_FRAME);
         }
     }
 
+    m_sampler.Stop();
+    m_bus.Stop();
+
     i2c_master_bus_rm_device(m_oled._i2c_dev_handle);
     ds1307_free_desc(&m_ds1307);
-    bmp280_free_desc(&m_bmp280);
 
     i2cdev_done();
 
     vTaskDelete(nullptr);
 }
 
-void EnvironmentMonitor::post_log(const char* message)
+void EnvironmentMonitor::update_node(std::string_view topic, std::string_view data, NodeTable::Source source)
 {
-    QueueMessage qmsg { .type = LogType };
-    strncpy(qmsg.message, message, sizeof(qmsg.message))[sizeof(qmsg.message) - 1] = '\0';
+    ESP_LOGD(TAG, "Node event: Topic: '%.*s', Data: '%.*s'", (int) topic.size(), topic.data(), (int) data.size(), data.data());
+
+    // Metric lines 3..5 are in NodeTable order, the node ID is the topic up to the metric
+    auto route = REMOTE_ROUTER.Find(topic);
+    if (const size_t level = topic.rfind('/'); route && level != topic.npos) {
+        char number[16] = {};
+        memcpy(number, data.data(), std::min(data.size(), sizeof(number) - 1));
+        m_nodes.Update(topic.substr(0, level), route->line - SPARKLINE_PAGE, strtof(number, nullptr), esp_timer_get_time(), source);
+    }
+}
 
-    if (xQueueSend(m_queue, &qmsg, 0) != pdPASS) {
-        ESP_LOGI(TAG, "Warning: Display queue is full, dropping MQTT message!\n");
+void EnvironmentMonitor::draw_node(size_t index)
+{
+    NodeTable::Node node;
+    if (!m_nodes.Get(index, &node))
+        return;
+
+    char line[METRIC_LINE_SIZE];
+    for (int i = 0; i < NodeTable::METRICS; ++i) {
+        format_metric(line, i, node.values[i]);
+        m_screen.DrawText(SPARKLINE_PAGE + i, line);
     }
+
+    // Node ID and position on the console's status line, the ID cut to what fits
+    char position[2 * FixedFormat::MAX_UNSIGNED + 3];
+    char* p = FixedFormat::Char(position, ' ');
+    p = FixedFormat::Unsigned(p, index + 1);
+    p = FixedFormat::Char(p, '/');
+    p = FixedFormat::Unsigned(p, m_nodes.Count());
+    FixedFormat::End(p);
+    const int len = p - position;
+    const int id_len = OledFramebuffer::CHARS_PER_LINE - len;
+    snprintf(line, sizeof(line), "%-*.*s%s", id_len, id_len, node.id, position);
+    m_console.Update(line);
 }
 
-void EnvironmentMonitor::post_event(const char* topic, size_t topic_len, const char* data, size_t data_len)
+void EnvironmentMonitor::draw_clock()
+{
+    char time[sizeof(m_clock_shown)] = {};
+    FixedFormat::Clock(time, m_local_time.tm_hour, m_local_time.tm_min, m_local_time.tm_sec, CLOCK_SECONDS);
+
+    // Only the digits that changed since the last draw
+    for (size_t i = 0; i < sizeof(time) - 1; ++i) {
+        if (time[i] != m_clock_shown[i]) {
+            m_screen.DrawBigChar(0, CLOCK_COL + i * CLOCK_SCALE * OledFramebuffer::GLYPH_WIDTH, time[i], CLOCK_SCALE);
+            m_clock_shown[i] = time[i];
+        }
+    }
+
+    char date[OledFramebuffer::CHARS_PER_LINE + 1] = {};
+    strftime(date, sizeof(date), "%a %d.%m.%Y", &m_local_time);
+    m_screen.DrawText(DATE_PAGE, date);
+}
+
+void EnvironmentMonitor::on_sample(const SensorSampler::Sample& sample)
 {
-    QueueMessage qmsg { .type = EventType };
-    strncpy(qmsg.topic, topic, std::min(topic_len, sizeof(qmsg.topic) - 1));
-    strncpy(qmsg.data, data, std::min(data_len, sizeof(qmsg.data) - 1));
+    // Runs on sampler task: hand the sample over to the display, then publish it
+    xQueueOverwrite(m_sample_queue, &sample);
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+    if (sample.valid) {
+        m_boot.Mark(BootTimeline::STAGE_FIRST_READING);
+        record_history(sample);
+    }
 
-    if (xQueueSend(m_queue, &qmsg, 0) != pdPASS) {
-        ESP_LOGI(TAG, "Warning: Display queue is full, dropping MQTT message!\n");
+    // New settings and the slow/fast decision are applied between two samples, here
+    if (m_sampling.TakeChanged()) {
+        apply_sampling();
+    }
+    if (const uint32_t period = m_sampling.Adapt(sample); period != m_sampler.Period()) {
+        m_sampler.SetPeriod(period);
+        post_log(m_sampling.IsSlow() ? "Sampling slow" : "Sampling fast");
+    }
+
+    // Statistics keep running while offline, only their publishing needs the broker
+    const int64_t time_s = sample.mono_us / 1000000;
+    m_temp_stats.Add(sample.temp, time_s);
+    m_pres_stats.Add(sample.pres / 100.f, time_s);
+    m_humi_stats.Add(sample.humi, time_s);
+
+    // Loop timing goes to the console in any case, to the broker when there is one
+    const bool loop_stats_due = CONFIG_LOOP_STATS_INTERVAL_S && time_s - m_loop_stats_time >= CONFIG_LOOP_STATS_INTERVAL_S;
+    if (loop_stats_due) {
+        m_loop_stats_time = time_s;
+        LoopStats::LogAll();
+    }
+
+    auto uxBits = xEventGroupWaitBits(m_wifi_event_group, WIFI_CONNECTED_BIT | MQTT_CONNECTED_BIT, pdFALSE, pdFALSE, 0);
+    if (uxBits & WIFI_CONNECTED_BIT) {
+        if (uxBits & MQTT_CONNECTED_BIT) {
+            if (CONFIG_STATS_PUBLISH_INTERVAL_S && time_s - m_stats_time >= CONFIG_STATS_PUBLISH_INTERVAL_S) {
+                m_stats_time = time_s;
+                publish_stats(time_s);
+            }
+            if (loop_stats_due) {
+                publish_loop_stats();
+            }
+
+            #ifdef CONFIG_PUBLISH_FORMAT_PACKED
+            publish_packed(sample);
+            #else
+            char value[FixedFormat::MAX_FIXED];
+            const char* end;
+            bool published = false;
+
+            // Unchanged values are held back by the per-metric publish policies, a value
+            // only counts as published once the client took it
+            if (m_temp_policy.Check(sample.temp, sample.mono_us)) {
+                end = FixedFormat::Fixed(value, sample.temp, 1);
+                if (esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/temp", value, end - value, 0, 0) >= 0) {
+                    m_temp_policy.Commit(sample.temp, sample.mono_us);
+                    published = true;
+                }
+            }
+            if (m_pres_policy.Check(sample.pres, sample.mono_us)) {
+                end = FixedFormat::Unsigned(value, (uint32_t) (sample.pres / 100.f));
+                if (esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/pres", value, end - value, 0, 0) >= 0) {
+                    m_pres_policy.Commit(sample.pres, sample.mono_us);
+                    published = true;
+                }
+            }
+            if (m_humi_policy.Check(sample.humi, sample.mono_us)) {
+                end = FixedFormat::Fixed(value, sample.humi, 1);
+                if (esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/humi", value, end - value, 0, 0) >= 0) {
+                    m_humi_policy.Commit(sample.humi, sample.mono_us);
+                    published = true;
+                }
+            }
+            if (published) {
+                m_boot.Mark(BootTimeline::STAGE_FIRST_PUBLISH);
+            }
+            #endif
+            drain_backlog();
+
+            #ifdef CONFIG_BROKER_ENABLE
+            // Checked once per sample, a slow sampling period stretches the interval
+            if (sample.mono_us - m_forward_us >= CONFIG_BROKER_FORWARD_INTERVAL_S * 1000000LL) {
+                const int64_t since_us = m_forward_us;
+                m_forward_us = sample.mono_us;
+                forward_nodes(since_us);
+            }
+            #endif
+        }
+        else {
+            store_reading(sample);
+            post_log("MQTT not ready");
+        }
     }
     else {
-        ESP_LOGI(TAG, "MQTT event: Topic: '%s', Data: '%s'", qmsg.topic, qmsg.data);
+        store_reading(sample);
+        post_log("Wi-Fi disconnect");
+    }
+}
+
+void EnvironmentMonitor::publish_stats(int64_t time_s)
+{
+    const struct {
+        const char* name;
+        const RollingStats& stats;
+    } metrics[] = {
+        { "temp", m_temp_stats },
+        { "pres", m_pres_stats },
+        { "humi", m_humi_stats },
+    };
+
+    char topic[64];
+    char payload[128];      // Count and four clamped values
+
+    for (const auto& metric : metrics) {
+        for (int w = 0; w < RollingStats::WINDOWS; ++w) {
+            const RollingStats::Result r = metric.stats.Get(w, time_s);
+            if (!r.count)
+                continue;
+
+            snprintf(topic, sizeof(topic), MQTT_PUB_TOPIC "/stats/%s/%s", RollingStats::WINDOW_NAMES[w], metric.name);
+            char* p = FixedFormat::Unsigned(FixedFormat::Text(payload, "{\"n\":"), r.count);
+            p = FixedFormat::Fixed(FixedFormat::Text(p, ",\"min\":"), r.min, 2);
+            p = FixedFormat::Fixed(FixedFormat::Text(p, ",\"max\":"), r.max, 2);
+            p = FixedFormat::Fixed(FixedFormat::Text(p, ",\"mean\":"), r.mean, 2);
+            p = FixedFormat::Fixed(FixedFormat::Text(p, ",\"sd\":"), r.stddev, 3);
+            p = FixedFormat::Char(p, '}');
+            esp_mqtt_client_publish(m_mqtt_handle, topic, payload, p - payload, 0, 0);
+        }
+    }
+}
+
+void EnvironmentMonitor::publish_loop_stats()
+{
+    LoopStats::ForEach([this] (const LoopStats& stats) {
+        char topic[64];
+        char payload[640];      // Both histograms with every bucket in use
+        snprintf(topic, sizeof(topic), MQTT_PUB_TOPIC "/loops/%s", stats.Name());
+        const int len = stats.Format(payload, sizeof(payload));
+        if (len < (int) sizeof(payload)) {
+            esp_mqtt_client_publish(m_mqtt_handle, topic, payload, len, 0, 0);
+        }
+    });
+}
+
+#ifdef CONFIG_PUBLISH_FORMAT_PACKED
+void EnvironmentMonitor::publish_packed(const SensorSampler::Sample& sample)
+{
+    // A batch the client refused is kept and sent again first. While it can't go out,
+    // samples go to the offline buffer as they would without a connection.
+    if (m_batch.Full() && !send_batch()) {
+        store_reading(sample);
+        return;
+    }
+
+    // Sample joins the batch when any of its metrics passes its publish policy. Its
+    // values are held until the batch is sent, so the following samples are compared
+    // against them.
+    bool changed = false;
+    const struct {
+        PublishPolicy& policy;
+        float value;
+    } metrics[] = {
+        { m_temp_policy, sample.temp },
+        { m_pres_policy, sample.pres },
+        { m_humi_policy, sample.humi },
+    };
+    for (const auto& metric : metrics) {
+        if (metric.policy.Check(metric.value, sample.mono_us)) {
+            metric.policy.Hold(metric.value, sample.mono_us);
+            changed = true;
+        }
+    }
+
+    if (changed && m_batch.Add(sample)) {
+        send_batch();
+    }
+}
+
+bool EnvironmentMonitor::send_batch()
+{
+    if (esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/packed",
+            reinterpret_cast<const char*>(m_batch.Data()), m_batch.Size(), 0, 0) < 0)
+        return false;
+
+    m_boot.Mark(BootTimeline::STAGE_FIRST_PUBLISH);
+    m_temp_policy.Commit();
+    m_pres_policy.Commit();
+    m_humi_policy.Commit();
+    m_batch.Clear();
+    return true;
+}
+#endif
+
+void EnvironmentMonitor::apply_sampling()
+{
+    const SamplingControl::Settings settings = m_sampling.Get();
+
+    const auto profile = static_cast<SensorSampler::ProfileId>(settings.profile);
+    if (esp_err_t err = m_sampler.SetProfile(profile); err != ESP_OK) {
+        ESP_LOGW(TAG, "Can't switch BMP280 to %s profile (%s)", SensorSampler::PROFILE_NAMES[profile], esp_err_to_name(err));
+    }
+
+    for (PublishPolicy* policy : { &m_temp_policy, &m_pres_policy, &m_humi_policy }) {
+        PublishPolicy::Config config = policy->GetConfig();
+        config.min_interval_ms = settings.min_interval_ms;
+        config.max_silence_ms = settings.max_silence_s * 1000;
+        policy->SetConfig(config);
     }
 }
 
-void EnvironmentMonitor::log_to_screen(int line, const char* fmt, ...)
+void EnvironmentMonitor::publish_sampling()
 {
-    char buf[256] = {};
+    char state[128];
+    m_sampling.Format(state, sizeof(state));
+    esp_mqtt_client_publish(m_mqtt_handle, MQTT_CONTROL_TOPIC "/state", state, 0, 1, 1);
+}
+
+void EnvironmentMonitor::store_reading(const SensorSampler::Sample& sample)
+{
+    if (!sample.valid)
+        return;
+
+    if (sample.time - m_backlog_time < CONFIG_TELEMETRY_BUFFER_INTERVAL)
+        return;
 
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
-    va_end(args);
+    if (m_backlog.Push({ sample.time, sample.temp, sample.pres, sample.humi })) {
+        m_backlog_time = sample.time;
+    }
+}
 
-    const size_t len = strlen(buf);
-    buf[len] = 0x20;
+void EnvironmentMonitor::record_history(const SensorSampler::Sample& sample)
+{
+    if (!CONFIG_HISTORY_INTERVAL_S || sample.time - m_history_time < CONFIG_HISTORY_INTERVAL_S)
+        return;
 
-    for (int i = 0; i + line < 8; ++i) {
-        ssd1306_display_text(&m_oled, i + line, buf + i * 16, 16, false);
+    m_history_time = sample.time;
+    if (esp_err_t err = m_history.Append(SeriesBlock::Quantize(sample.time, sample.temp, sample.pres, sample.humi));
+        err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Can't store history block (%s)", esp_err_to_name(err));
+    }
+}
+
+void EnvironmentMonitor::drain_backlog()
+{
+    // Replay stored readings in small bursts (one burst per sample period) so the
+    // broker is not flooded right after reconnect
+    size_t count = m_backlog.Drain(CONFIG_TELEMETRY_DRAIN_BURST, [this] (const TelemetryBuffer::Reading& reading) {
+        char payload[24 + 3 * FixedFormat::MAX_FIXED];
+        char* p = payload + snprintf(payload, 24, "%lld,", (long long) reading.time);
+        p = FixedFormat::Char(FixedFormat::Fixed(p, reading.temp, 1), ',');
+        p = FixedFormat::Char(FixedFormat::Fixed(p, reading.pres / 100.f, 0), ',');
+        p = FixedFormat::Fixed(p, reading.humi, 1);
+        return esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/history", payload, p - payload, 1, 0) >= 0;
+    });
+
+    if (count) {
+        ESP_LOGI(TAG, "Replayed %u stored readings, %u pending", (unsigned) count, (unsigned) m_backlog.Count());
+    }
+}
+
+#ifdef CONFIG_BROKER_ENABLE
+void EnvironmentMonitor::forward_nodes(int64_t since_us)
+{
+    // Nodes of the local broker updated since the last batch, one "id,temp,pres,humi"
+    // line each (empty field = never received), as few messages as the buffer allows.
+    // Nodes last heard of upstream are left out, sending them back would echo them.
+    char batch[512];
+    size_t len = 0;
+    unsigned nodes = 0;
+    unsigned messages = 0;
+
+    const auto send = [this, &batch, &len, &messages] {
+        esp_mqtt_client_publish(m_mqtt_handle, MQTT_PUB_TOPIC "/nodes", batch, len, 1, 0);
+        ++messages;
+        len = 0;
+    };
+
+    m_nodes.ForEach([&] (const NodeTable::Node& node) {
+        if (node.source != NodeTable::SOURCE_LOCAL || node.updated_us <= since_us)
+            return;
+
+        // Same decimals as the display
+        char line[sizeof(node.id) + NodeTable::METRICS * (1 + FixedFormat::MAX_FIXED) + 1];
+        char* p = FixedFormat::Text(line, node.id);
+        for (int m = 0; m < NodeTable::METRICS; ++m) {
+            p = FixedFormat::Char(p, ',');
+            if (!std::isnan(node.values[m])) {
+                p = FixedFormat::Fixed(p, node.values[m], METRIC_FORMATS[m].decimals);
+            }
+        }
+        p = FixedFormat::Char(p, '\n');
+        const size_t n = p - line;
+
+        if (len + n > sizeof(batch)) {
+            send();
+        }
+        memcpy(batch + len, line, n);
+        len += n;
+        ++nodes;
+    });
+
+    if (len) {
+        send();
+        ESP_LOGI(TAG, "Forwarded %u nodes in %u messages", nodes, messages);
+    }
+}
+#endif
+
+void EnvironmentMonitor::post_log(const char* message)
+{
+    // Message is written once, into its block, only the block index is queued
+    const uint16_t index = m_messages.Allocate();
+    if (index == m_messages.NONE) {
+        ESP_LOGI(TAG, "Warning: Display queue is full, dropping log message!\n");
+        return;
+    }
+
+    QueueMessage& qmsg = m_messages[index];
+    qmsg.type = LogType;
+    strncpy(qmsg.message, message, sizeof(qmsg.message))[sizeof(qmsg.message) - 1] = '\0';
+
+    // Queue holds as many indices as there are blocks, so this can't fail
+    xQueueSend(m_queue, &index, 0);
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+}
+
+void EnvironmentMonitor::post_event(const char* topic, size_t topic_len, const char* data, size_t data_len)
+{
+    const std::string_view name(topic, topic_len);
+
+    if (*CONFIG_REMOTE_NODES_TOPIC && topic_matches(CONFIG_REMOTE_NODES_TOPIC, name)) {
+        update_node(name, std::string_view(data, data_len), NodeTable::SOURCE_UPSTREAM);
+
+        if (!topic_matches(MQTT_SUB_TOPIC, name))
+            return;
+    }
+
+    ESP_LOGI(TAG, "MQTT event: Topic: '%.*s', Data: '%.*s'", (int) topic_len, topic, (int) data_len, data);
+
+    // A newer value of a topic replaces the one not yet displayed. Only the first pending
+    // update of a topic needs to wake the display.
+    const auto result = m_latest.Put(topic, topic_len, data, data_len);
+    if (result == LatestValueTable::PUT_ADDED && m_task) {
+        xTaskNotifyGive(m_task);
+    }
+    else if (result == LatestValueTable::PUT_DROPPED) {
+        // Every entry holds an update of another topic not yet displayed, logged at 1, 2, 4, 8... drops
+        if (const uint32_t dropped = m_latest.Dropped(); !(dropped & (dropped - 1))) {
+            ESP_LOGW(TAG, "Too many MQTT topics pending, dropping message! (%lu dropped, %d topics)",
+                (unsigned long) dropped, LatestValueTable::SLOTS);
+        }
     }
 }
 
 bool EnvironmentMonitor::set_system_time(tm* rtc_time /* = nullptr */)
 {
-    char* current_tz = nullptr;
     time_t utc_ts = 0;
 
     if (rtc_time) {
-        current_tz = getenv("TZ");
-        setenv("TZ", "GMT0", 1);
-        tzset();
-        utc_ts = std::mktime(rtc_time);
+        // RTC keeps UTC, no timezone involved
+        utc_ts = TimeZone::FromCivil(*rtc_time);
     }
     else {
         if (m_local_time.tm_year > 1900)
             m_local_time.tm_year -= 1900;
-        m_local_time.tm_isdst = -1;
-        utc_ts = std::mktime(&m_local_time);
+        utc_ts = m_tz.ToUtc(m_local_time);
     }
     timeval tv = { .tv_sec = utc_ts };
     settimeofday(&tv, nullptr);
 
-    if (rtc_time) {
-        // Restore actual TZ value
-        if (current_tz) {
-            setenv("TZ", current_tz, 1);
-            tzset();
-        }
+    if (rtc_time)
         return true;
-    }
-    else {
-        // Always maintain system time in UTC timezone
-        if (tm* utc_tm = std::gmtime(&utc_ts)) {
-            ds1307_set_time(&m_ds1307, utc_tm);
-            return true;
-        }
-        return false;
-    }
+
+    // Recompute derived fields (weekday, DST flag) of the adjusted time
+    m_tz.ToLocal(utc_ts, &m_local_time);
+
+    // Always maintain system time in UTC timezone
+    tm utc_tm;
+    TimeZone::ToCivil(utc_ts, &utc_tm);
+    m_bus.Execute(m_ds1307_bus_device, I2cBus::PRIO_CLOCK, 0, [&] {
+        return ds1307_set_time(&m_ds1307, &utc_tm);
+    });
+    return true;
 }
 
 bool EnvironmentMonitor::get_local_time()
 {
-    time_t utc_now = std::time(nullptr);
-    if (tm* local = std::localtime(&utc_now)) {
-        m_local_time = *local;
-        return true;
-    }
-    return false;
+    // Cheap when called several times a second: only seconds move until the next minute
+    m_tz.Update(std::time(nullptr), &m_local_time);
+    return true;
 }
 
 void EnvironmentMonitor::on_wifi_event(esp_event_base_t event_base, int32_t event_id, void* event_data)
@@ -328,6 +949,7 @@ void EnvironmentMonitor::on_wifi_event(esp_event_base_t event_base, int32_t even
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         xEventGroupSetBits(m_wifi_event_group, WIFI_CONNECTED_BIT);
+        m_boot.Mark(BootTimeline::STAGE_WIFI_CONNECTED);
         post_log("Wi-Fi ready");
 
         auto uxBits = xEventGroupWaitBits(m_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, 0);
@@ -354,8 +976,6 @@ void EnvironmentMonitor::setup_nvs()
 
 void EnvironmentMonitor::setup_wifi()
 {
-    m_wifi_event_group = xEventGroupCreate();
-
     ESP_ERROR_CHECK(esp_netif_init());
     m_netif = esp_netif_create_default_wifi_sta();
 
@@ -382,7 +1002,8 @@ void EnvironmentMonitor::setup_wifi()
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    log_to_screen(7, "Starting Wi-Fi");
+    // Runs on the setup task, the display belongs to update_task by now
+    post_log("Starting Wi-Fi");
 }
 
 void EnvironmentMonitor::mqtt_start()
@@ -405,7 +1026,13 @@ void EnvironmentMonitor::on_mqtt_event(esp_event_base_t event_base, int32_t even
     switch (event_id) {
         case MQTT_EVENT_CONNECTED:
             esp_mqtt_client_subscribe(m_mqtt_handle, MQTT_SUB_TOPIC, 0);
+            esp_mqtt_client_subscribe(m_mqtt_handle, MQTT_CONTROL_TOPIC, 1);
+            if (*CONFIG_REMOTE_NODES_TOPIC) {
+                esp_mqtt_client_subscribe(m_mqtt_handle, CONFIG_REMOTE_NODES_TOPIC, 0);
+            }
+            publish_sampling();
             xEventGroupSetBits(m_wifi_event_group, MQTT_CONNECTED_BIT);
+            m_boot.Mark(BootTimeline::STAGE_MQTT_CONNECTED);
             post_log("MQTT ready");
             break;
         case MQTT_EVENT_DISCONNECTED:
@@ -413,14 +1040,43 @@ void EnvironmentMonitor::on_mqtt_event(esp_event_base_t event_base, int32_t even
             post_log("MQTT disconnect");
             break;
         case MQTT_EVENT_DATA:
-            post_event(event->topic, event->topic_len, event->data, event->data_len);
+            if (event->topic_len == strlen(MQTT_CONTROL_TOPIC) && !memcmp(event->topic, MQTT_CONTROL_TOPIC, event->topic_len))
+                on_control(event->data, event->data_len);
+            else
+                post_event(event->topic, event->topic_len, event->data, event->data_len);
             break;
         default:
             break;
     }
 }
 
+void EnvironmentMonitor::on_control(const char* data, size_t data_len)
+{
+    // Runs on MQTT task: settings are checked and stored here, the sampler task applies them
+    if (!m_sampling.Parse(data, data_len)) {
+        ESP_LOGW(TAG, "Invalid control message \"%.*s\"", (int) data_len, data);
+        post_log("Bad control msg");
+    }
+    else {
+        if (esp_err_t err = m_sampling.Save(); err != ESP_OK) {
+            ESP_LOGW(TAG, "Can't store sampling settings (%s)", esp_err_to_name(err));
+        }
+        m_sampler.Wake();
+        post_log("Settings changed");
+    }
+
+    // Reply with what is in effect now, also after a rejected message
+    publish_sampling();
+}
+
 void EnvironmentMonitor::on_mode_switch()
 {
+    // Called from GPIO ISR
     m_remote_mode = !m_remote_mode;
+
+    if (m_task) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(m_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
 }
@@ -7,9 +7,31 @@
 #include <esp_netif.h>
 #include <mqtt_client.h>
 
+#include <atomic>
 #include <string>
 
+#include "BootTimeline.h"
 #include "ClockAdjuster.h"
+#include "I2cBus.h"
+#include "HistoryLog.h"
+#include "HistoryUploader.h"
+#include "LatestValueTable.h"
+#include "LogConsole.h"
+#include "LoopStats.h"
+#include "MessagePool.h"
+#ifdef CONFIG_BROKER_ENABLE
+#include "MqttBroker.h"
+#endif
+#include "NodeTable.h"
+#include "SensorSampler.h"
+#include "OledFramebuffer.h"
+#include "PublishPolicy.h"
+#include "RollingStats.h"
+#include "SamplingControl.h"
+#include "SampleBatch.h"
+#include "Sparkline.h"
+#include "TelemetryBuffer.h"
+#include "TimeZone.h"
 
 class EnvironmentMonitor
 {
@@ -20,26 +42,44 @@ public:
 private:
     enum MessageType {
         LogType = 0,
-        EventType = 1,
     };
 
     struct QueueMessage {
         MessageType type;
         union {
             uint64_t value;
-            struct {
-                char topic[32];
-                char data[32];
-            };
             char message[64];
         };
     };
 
-    bmp280_t  m_bmp280 = {};
+    I2cBus m_bus;               // Must precede every I2C client below
     i2c_dev_t m_ds1307 = {};
+    int m_ds1307_bus_device = -1;
     SSD1306_t m_oled = {};
+    OledFramebuffer m_screen { &m_oled, &m_bus };
+
+    // Remote mode: value text on the left of lines 3..5, sparkline graph on the right
+    static constexpr int SPARKLINES = 3;
+    static constexpr int SPARKLINE_PAGE = 3;
+    static constexpr int REMOTE_TEXT_CHARS = 11;
+    static constexpr int SPARKLINE_COL = REMOTE_TEXT_CHARS * OledFramebuffer::GLYPH_WIDTH;
+    static constexpr int SPARKLINE_WIDTH = OledFramebuffer::WIDTH - SPARKLINE_COL;
+    Sparkline m_sparklines[SPARKLINES] = {
+        { &m_screen, SPARKLINE_PAGE + 0, SPARKLINE_COL, SPARKLINE_WIDTH },
+        { &m_screen, SPARKLINE_PAGE + 1, SPARKLINE_COL, SPARKLINE_WIDTH },
+        { &m_screen, SPARKLINE_PAGE + 2, SPARKLINE_COL, SPARKLINE_WIDTH },
+    };
+
+    // Log console takes the pages below the metric lines that the date doesn't use
+    static constexpr int CONSOLE_PAGE = CONFIG_CLOCK_DIGIT_SCALE == 3 ? 7 : 6;
+    LogConsole m_console { &m_screen, CONSOLE_PAGE, OledFramebuffer::PAGES - 1 };
+    std::atomic<int> m_console_scroll = 0;  // Encoder turns not yet applied to m_console
+    BootTimeline m_boot;
     TaskHandle_t m_task = {};
-    QueueHandle_t m_queue = {};
+    LoopStats m_update_loop { "update_task" };
+    QueueHandle_t m_queue = {};                     // Indices of m_messages blocks
+    MessagePool<QueueMessage, 10> m_messages;
+    QueueHandle_t m_sample_queue = {};      // Latest sample for display, length 1
 
     esp_netif_t* m_netif = nullptr;
     EventGroupHandle_t m_wifi_event_group = {};
@@ -49,32 +89,86 @@ private:
     volatile bool m_pause = false;
     volatile bool m_remote_mode = false;
 
+    TimeZone m_tz;
     std::tm m_local_time = {};
+    char m_clock_shown[9] = {};             // Clock text currently on the screen
     std::tm m_new_time = {};
 
     std::tm m_mqtt_data_time = {};
     std::string m_mqtt_topic;
     std::string m_mqtt_data;
 
+    TelemetryBuffer m_backlog { &m_bus };
+    time_t m_backlog_time = 0;
+    HistoryLog m_history;
+    time_t m_history_time = 0;
+
     ClockAdjuster m_clock_adjuster;
     Button m_mode_switcher;
 
+    LatestValueTable m_latest;  // MQTT data from on_mqtt_event to update_task
+    NodeTable m_nodes;          // Latest metrics of other nodes (REMOTE_NODES_TOPIC, local broker)
+    SensorSampler m_sampler;
+    SamplingControl m_sampling;
+    HistoryUploader m_uploader;
+
+    #ifdef CONFIG_BROKER_ENABLE
+    MqttBroker m_broker { [this] (std::string_view topic, std::string_view data) { update_node(topic, data, NodeTable::SOURCE_LOCAL); } };
+    int64_t m_forward_us = 0;   // Nodes updated since then go into the next upstream batch
+    #endif
+
+    PublishPolicy m_temp_policy;
+    PublishPolicy m_pres_policy;
+    PublishPolicy m_humi_policy;
+    // Temperature in C, pressure in hPa, humidity in %
+    RollingStats m_temp_stats;
+    RollingStats m_pres_stats;
+    RollingStats m_humi_stats;
+    int64_t m_stats_time = 0;
+    int64_t m_loop_stats_time = 0;
+
+    #ifdef CONFIG_PUBLISH_FORMAT_PACKED
+    SampleBatch m_batch { CONFIG_PUBLISH_BATCH_SIZE };
+    #endif
+
+    void setup_power();
     void setup_bmp280();
     void setup_ds1307();
+    void setup_at24c32();
     void setup_ssd1306();
+    void setup_history();
     void setup_task();
+    void net_setup_task();
     void setup_nvs();
     void setup_wifi();
 
     void mqtt_start();
     void update_task();
+    void publish_stats(int64_t time_s);
+    void publish_loop_stats();
+    #ifdef CONFIG_PUBLISH_FORMAT_PACKED
+    void publish_packed(const SensorSampler::Sample& sample);
+    bool send_batch();
+    #endif
+    void apply_sampling();
+    void publish_sampling();
+    void store_reading(const SensorSampler::Sample& sample);
+    void record_history(const SensorSampler::Sample& sample);
+    void drain_backlog();
+    #ifdef CONFIG_BROKER_ENABLE
+    void forward_nodes(int64_t since_us);
+    #endif
     void post_log(const char* message);
     void post_event(const char* topic, size_t topic_len, const char* data, size_t data_len);
-    void log_to_screen(int line, const char* fmt, ...);
+    void update_node(std::string_view topic, std::string_view data, NodeTable::Source source);
+    void draw_node(size_t index);
+    void draw_clock();
     bool set_system_time(tm* rtc_time = nullptr);
     bool get_local_time();
 
     void on_wifi_event(esp_event_base_t event_base, int32_t event_id, void* event_data);
     void on_mqtt_event(esp_event_base_t event_base, int32_t event_id, void* event_data);
+    void on_sample(const SensorSampler::Sample& sample);
+    void on_control(const char* data, size_t data_len);
     void on_mode_switch();
 };
@@ -0,0 +1,134 @@
+#include "HistoryLog.h"
+
+#include <esp_rom_crc.h>
+#include <esp_log.h>
+
+#include <algorithm>
+#include <climits>
+
+#include "common.h"
+#include "FixedFormat.h"
+
+constexpr const uint32_t EMPTY_SEQ = UINT32_MAX;     // Erased flash
+
+HistoryLog::HistoryLog()
+    : m_block(m_buffer, sizeof(m_buffer))
+{
+}
+
+esp_err_t HistoryLog::Open(const char* label)
+{
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part)
+        return ESP_ERR_NOT_FOUND;
+    if (part->erase_size % SLOT_SIZE || part->size < 2 * part->erase_size)
+        return ESP_ERR_INVALID_SIZE;
+
+    m_slots = part->size / SLOT_SIZE;
+    m_slots_per_sector = part->erase_size / SLOT_SIZE;
+
+    // Newest and oldest block by scanning the slot headers, contents are checked on read
+    bool found = false;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    for (uint32_t slot = 0; slot < m_slots; ++slot) {
+        Header header;
+        if (esp_partition_read(part, slot * SLOT_SIZE, &header, sizeof(header)) != ESP_OK)
+            continue;
+        if (header.seq == EMPTY_SEQ || header.seq % m_slots != slot || header.size > BLOCK_SIZE)
+            continue;
+
+        first = found ? std::min(first, header.seq) : header.seq;
+        last = found ? std::max(last, header.seq) : header.seq;
+        found = true;
+    }
+
+    m_first = first;
+    m_next = found ? last + 1 : 0;
+    m_part = part;
+
+    ESP_LOGI(TAG, "History: %lu blocks stored, %lu slots of %u bytes",
+        (unsigned long) (m_next - m_first), (unsigned long) m_slots, (unsigned) SLOT_SIZE);
+    return ESP_OK;
+}
+
+esp_err_t HistoryLog::Append(const SeriesBlock::Point& point)
+{
+    if (!m_part)
+        return ESP_ERR_INVALID_STATE;
+
+    if (m_block.Append(point))
+        return ESP_OK;
+
+    // Full: store it and start the next block with this reading
+    esp_err_t err = seal();
+    m_block.Clear();
+    m_block.Append(point);
+    return err;
+}
+
+esp_err_t HistoryLog::ReadBlock(uint32_t seq, uint8_t* data, size_t* size) const
+{
+    if (!m_part)
+        return ESP_ERR_INVALID_STATE;
+
+    const size_t offset = (seq % m_slots) * SLOT_SIZE;
+    Header header;
+    esp_err_t err = esp_partition_read(m_part, offset, &header, sizeof(header));
+    if (err != ESP_OK)
+        return err;
+    if (header.seq != seq || header.size > BLOCK_SIZE)
+        return ESP_ERR_NOT_FOUND;
+
+    err = esp_partition_read(m_part, offset + HEADER_SIZE, data, header.size);
+    if (err != ESP_OK)
+        return err;
+    if (header.crc != crc(header, data))
+        return ESP_ERR_INVALID_CRC;
+
+    *size = header.size;
+    return ESP_OK;
+}
+
+esp_err_t HistoryLog::seal()
+{
+    const uint32_t seq = m_next;
+    const uint32_t slot = seq % m_slots;
+
+    // Entering a new sector: erase it, which drops the oldest blocks still in there
+    if (slot % m_slots_per_sector == 0) {
+        esp_err_t err = esp_partition_erase_range(m_part, slot * SLOT_SIZE, m_part->erase_size);
+        if (err != ESP_OK)
+            return err;
+        if (seq + m_slots_per_sector > m_slots) {
+            m_first = std::max<uint32_t>(m_first, seq + m_slots_per_sector - m_slots);
+        }
+    }
+
+    Header header = { seq, static_cast<uint16_t>(m_block.Size()), 0 };
+    header.crc = crc(header, m_block.Data());
+
+    esp_err_t err = esp_partition_write(m_part, slot * SLOT_SIZE + HEADER_SIZE, m_block.Data(), header.size);
+    if (err == ESP_OK) {
+        // Header last, a block cut short by power loss has no valid header
+        err = esp_partition_write(m_part, slot * SLOT_SIZE, &header, sizeof(header));
+    }
+    if (err != ESP_OK)
+        return err;
+
+    m_next = seq + 1;
+
+    char bits[FixedFormat::MAX_FIXED + 1];
+    char ratio[FixedFormat::MAX_FIXED + 1];
+    FixedFormat::End(FixedFormat::Fixed(bits, 8.f * header.size / m_block.Count(), 1));
+    FixedFormat::End(FixedFormat::Fixed(ratio, static_cast<float>(sizeof(SeriesBlock::Point)) * m_block.Count() / header.size, 1));
+    ESP_LOGI(TAG, "History: block %lu, %u readings in %u bytes, %s bits each, %sx smaller than raw",
+        (unsigned long) seq, m_block.Count(), header.size, bits, ratio);
+    return ESP_OK;
+}
+
+/* static */ uint16_t HistoryLog::crc(const Header& header, const uint8_t* data)
+{
+    uint16_t crc = esp_rom_crc16_le(0, reinterpret_cast<const uint8_t*>(&header), offsetof(Header, crc));
+    return esp_rom_crc16_le(crc, data, header.size);
+}
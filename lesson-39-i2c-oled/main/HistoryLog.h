@@ -0,0 +1,59 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_partition.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "SeriesBlock.h"
+
+// Long-term history of readings in a flash data partition, as compressed SeriesBlocks.
+// The partition is a ring of fixed-size slots; block number seq always goes to slot
+// seq % slots, so a block is found without an index and its header (seq, size, CRC)
+// tells whether it's still the one asked for. Erasing happens a sector ahead of the
+// writes and drops the oldest blocks of the ring.
+// Readings collect in RAM until a block is full, the open block is lost on reset.
+class HistoryLog
+{
+public:
+    static constexpr size_t SLOT_SIZE = 512;
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr size_t BLOCK_SIZE = SLOT_SIZE - HEADER_SIZE;
+
+    HistoryLog();
+
+    esp_err_t Open(const char* label);
+    bool IsOpen() const { return m_part != nullptr; }
+
+    esp_err_t Append(const SeriesBlock::Point& point);
+
+    // Stored blocks are [FirstSeq(), NextSeq()), safe to call from any task
+    uint32_t FirstSeq() const { return m_first; }
+    uint32_t NextSeq() const { return m_next; }
+
+    // data must hold BLOCK_SIZE bytes. ESP_ERR_NOT_FOUND when the block has been
+    // overwritten meanwhile, ESP_ERR_INVALID_CRC when it's damaged.
+    esp_err_t ReadBlock(uint32_t seq, uint8_t* data, size_t* size) const;
+
+private:
+    struct Header {
+        uint32_t seq;
+        uint16_t size;
+        uint16_t crc;
+    };
+    static_assert(sizeof(Header) == HEADER_SIZE);
+
+    const esp_partition_t* m_part = nullptr;
+    uint32_t m_slots = 0;
+    uint32_t m_slots_per_sector = 0;
+    std::atomic<uint32_t> m_first = 0;
+    std::atomic<uint32_t> m_next = 0;
+
+    uint8_t m_buffer[BLOCK_SIZE];
+    SeriesBlock m_block;
+
+    esp_err_t seal();
+    static uint16_t crc(const Header& header, const uint8_t* data);
+};
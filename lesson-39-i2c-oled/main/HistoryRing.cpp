@@ -0,0 +1,45 @@
+#include "HistoryRing.h"
+
+#include <algorithm>
+#include <cmath>
+
+void HistoryRing::Push(float value)
+{
+    if (std::isnan(value))
+        return;
+
+    const int32_t fixed = std::lround(std::clamp(value * SCALE, -2e9f, 2e9f));
+
+    int32_t delta = 0;
+    if (m_count) {
+        delta = std::clamp<int32_t>(fixed - m_latest, INT16_MIN, INT16_MAX);
+    }
+    else {
+        m_latest = fixed;
+    }
+
+    m_head = (m_head + 1) % CAPACITY;
+    m_deltas[m_head] = delta;
+    m_latest += delta;
+    m_count = std::min(m_count + 1, CAPACITY);
+}
+
+void HistoryRing::Clear()
+{
+    m_count = 0;
+    m_latest = 0;
+}
+
+int HistoryRing::Read(float* out, int max) const
+{
+    const int n = std::min(max, m_count);
+
+    int32_t value = m_latest;
+    int index = m_head;
+    for (int i = n - 1; i >= 0; --i) {
+        out[i] = value / SCALE;
+        value -= m_deltas[index];
+        index = (index + CAPACITY - 1) % CAPACITY;
+    }
+    return n;
+}
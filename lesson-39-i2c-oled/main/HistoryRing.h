@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Recent values of one metric in 2 bytes each: the ring stores fixed-point deltas
+// between consecutive values and only the newest value in full. Older values are
+// reconstructed by walking back from the newest one. A jump that doesn't fit into
+// a delta is clamped; the series then catches up with the following values.
+class HistoryRing
+{
+public:
+    static constexpr int CAPACITY = 128;
+    static constexpr float SCALE = 100.f;       // Fixed point resolution 0.01
+
+    HistoryRing() = default;
+
+    void Push(float value);
+    void Clear();
+
+    int Count() const { return m_count; }
+    float Latest() const { return m_latest / SCALE; }
+
+    // Copies up to max newest values, oldest first; returns the number copied
+    int Read(float* out, int max) const;
+
+private:
+    int16_t m_deltas[CAPACITY] = {};            // m_deltas[i] = value[i] - value[i - 1]
+    int m_head = 0;                             // Index of the newest entry
+    int m_count = 0;
+    int32_t m_latest = 0;                       // Newest value, fixed point
+};
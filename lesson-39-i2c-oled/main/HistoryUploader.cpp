@@ -0,0 +1,264 @@
+#include "HistoryUploader.h"
+
+#include <esp_timer.h>
+#include <esp_log.h>
+#include <nvs.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "common.h"
+
+constexpr const char* NVS_NAMESPACE = "history";
+constexpr const char* NVS_KEY = "uploaded";
+
+constexpr const uint32_t MAX_BLOCKS_PER_REQUEST = 64;     // About 32 KB of body
+constexpr const int TIMEOUT_MS = 10 * 1000;
+
+// Block numbers wrap around, compare them by distance
+static bool seq_before(uint32_t a, uint32_t b)
+{
+    return static_cast<int32_t>(a - b) < 0;
+}
+
+HistoryUploader::HistoryUploader(HistoryLog* history, online_t online)
+    : m_history(history)
+    , m_online(online)
+{
+}
+
+HistoryUploader::~HistoryUploader()
+{
+    Stop();
+}
+
+void HistoryUploader::Start(const char* url, uint32_t interval_s)
+{
+    if (m_task || !url || !*url)
+        return;
+
+    m_url = url;
+    m_interval_s = interval_s;
+    m_stop_task = false;
+    load_next();
+
+    xTaskCreatePinnedToCore(
+        member_cast<TaskFunction_t>(&HistoryUploader::upload_task),
+        "upload_task",
+        6144,                   // HTTP client and TLS-less socket I/O
+        this,
+        2,                      // Below display, sampler and MQTT: live data always goes first
+        &m_task,
+        tskNO_AFFINITY
+    );
+}
+
+void HistoryUploader::Stop()
+{
+    if (!m_task)
+        return;
+
+    m_stop_task = true;
+    Wake();
+    while (m_task) {
+        vTaskDelay(1);
+    }
+}
+
+void HistoryUploader::Wake()
+{
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+}
+
+void HistoryUploader::upload_task()
+{
+    const TickType_t interval = pdMS_TO_TICKS(m_interval_s * 1000);
+
+    while (!m_stop_task) {
+        if (m_online()) {
+            // Keep going while there's a backlog and the server takes it, one request per round
+            uint32_t count = 0;
+            uint32_t before;
+            esp_err_t err;
+            do {
+                before = m_next;
+                err = upload(&count);
+            } while (err == ESP_OK && count && m_next != before && !m_stop_task);
+
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Upload: failed (%s), retrying in %lu s", esp_err_to_name(err), (unsigned long) m_interval_s);
+                disconnect();
+            }
+        }
+
+        ulTaskNotifyTake(pdTRUE, interval);
+    }
+
+    disconnect();
+
+    m_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+esp_err_t HistoryUploader::upload(uint32_t* count)
+{
+    *count = 0;
+
+    const uint32_t first = m_history->FirstSeq();
+    const uint32_t next = m_history->NextSeq();
+
+    // Blocks overwritten before the server got them are gone for good
+    if (seq_before(m_next, first)) {
+        ESP_LOGW(TAG, "Upload: %lu blocks lost before upload", (unsigned long) (first - m_next));
+        m_next = first;
+    }
+    // Past the log's end: the partition was erased while NVS kept the old position. Start
+    // over from the oldest block in the next round, which doesn't loop in this one if the
+    // server's answer is past the end again.
+    else if (seq_before(next, m_next)) {
+        ESP_LOGW(TAG, "Upload: block %lu is past the log's end %lu, starting over at %lu",
+            (unsigned long) m_next, (unsigned long) next, (unsigned long) first);
+        m_next = first;
+        save_next();
+        return ESP_OK;
+    }
+    if (!seq_before(m_next, next))
+        return ESP_OK;
+
+    const uint32_t to = next - m_next > MAX_BLOCKS_PER_REQUEST ? m_next + MAX_BLOCKS_PER_REQUEST : next;
+
+    const int64_t start = esp_timer_get_time();
+    size_t bytes = 0;
+    const uint32_t from = m_next;
+    esp_err_t err = post(from, to, count, &bytes);
+    if (err != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "Upload: blocks %lu..%lu, %u bytes in %lu ms, server wants %lu next",
+        (unsigned long) from, (unsigned long) (to - 1), (unsigned) bytes,
+        (unsigned long) ((esp_timer_get_time() - start) / 1000), (unsigned long) m_next);
+    return ESP_OK;
+}
+
+esp_err_t HistoryUploader::post(uint32_t from, uint32_t to, uint32_t* count, size_t* bytes)
+{
+    if (!m_client) {
+        esp_http_client_config_t config = {};
+        config.url = m_url;
+        config.method = HTTP_METHOD_POST;
+        config.timeout_ms = TIMEOUT_MS;
+        config.keep_alive_enable = true;
+
+        m_client = esp_http_client_init(&config);
+        if (!m_client)
+            return ESP_ERR_NO_MEM;
+    }
+
+    char value[12];
+    snprintf(value, sizeof(value), "%lu", (unsigned long) from);
+    esp_http_client_set_header(m_client, "X-History-From", value);
+    snprintf(value, sizeof(value), "%lu", (unsigned long) to);
+    esp_http_client_set_header(m_client, "X-History-To", value);
+    esp_http_client_set_header(m_client, "Content-Type", "application/octet-stream");
+
+    // Negative length: body goes with chunked transfer encoding, framed here
+    esp_err_t err = esp_http_client_open(m_client, -1);
+    if (err != ESP_OK)
+        return err;
+
+    for (uint32_t seq = from; seq != to; ++seq) {
+        size_t size = 0;
+        err = m_history->ReadBlock(seq, m_frame + FRAME_HEADER_SIZE, &size);
+        if (err == ESP_ERR_NOT_FOUND || err == ESP_ERR_INVALID_CRC)
+            continue;           // Server sees the gap in seq
+        if (err != ESP_OK)
+            return err;
+
+        const uint8_t header[FRAME_HEADER_SIZE] = {
+            static_cast<uint8_t>(seq), static_cast<uint8_t>(seq >> 8), static_cast<uint8_t>(seq >> 16), static_cast<uint8_t>(seq >> 24),
+            static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+        };
+        memcpy(m_frame, header, sizeof(header));
+
+        if (!write_chunk(m_frame, FRAME_HEADER_SIZE + size))
+            return ESP_FAIL;
+
+        *bytes += FRAME_HEADER_SIZE + size;
+    }
+    *count = to - from;         // Lost blocks included, they are done with as well
+
+    if (esp_http_client_write(m_client, "0\r\n\r\n", 5) != 5)
+        return ESP_FAIL;
+
+    if (esp_http_client_fetch_headers(m_client) < 0)
+        return ESP_FAIL;
+
+    const int status = esp_http_client_get_status_code(m_client);
+    char body[32] = {};
+    const int len = esp_http_client_read_response(m_client, body, sizeof(body) - 1);
+    int flushed = 0;
+    esp_http_client_flush_response(m_client, &flushed);
+
+    if (status != 200 || len <= 0 || strncmp(body, "next=", 5)) {
+        ESP_LOGW(TAG, "Upload: HTTP %d \"%.*s\"", status, len > 0 ? len : 0, body);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // Accepted even backwards, the server knows what it has stored
+    char* end = nullptr;
+    const uint32_t next = strtoul(body + 5, &end, 10);
+    if (end == body + 5)
+        return ESP_ERR_INVALID_RESPONSE;
+
+    if (next != m_next) {
+        m_next = next;
+        save_next();
+    }
+    return ESP_OK;
+}
+
+bool HistoryUploader::write_chunk(const void* data, size_t size)
+{
+    char head[12];
+    const int head_len = snprintf(head, sizeof(head), "%x\r\n", (unsigned) size);
+    return esp_http_client_write(m_client, head, head_len) == head_len
+        && esp_http_client_write(m_client, static_cast<const char*>(data), size) == static_cast<int>(size)
+        && esp_http_client_write(m_client, "\r\n", 2) == 2;
+}
+
+void HistoryUploader::disconnect()
+{
+    if (m_client) {
+        esp_http_client_close(m_client);
+        esp_http_client_cleanup(m_client);
+        m_client = nullptr;
+    }
+}
+
+void HistoryUploader::load_next()
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return;
+
+    uint32_t next = 0;
+    if (nvs_get_u32(handle, NVS_KEY, &next) == ESP_OK) {
+        m_next = next;
+    }
+    nvs_close(handle);
+}
+
+void HistoryUploader::save_next()
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+        return;
+
+    if (nvs_set_u32(handle, NVS_KEY, m_next) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
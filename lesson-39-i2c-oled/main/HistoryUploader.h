@@ -0,0 +1,68 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_http_client.h>
+
+#include <atomic>
+#include <functional>
+
+#include "HistoryLog.h"
+
+// Background upload of the history blocks to an HTTP endpoint, below everything live.
+// Each request POSTs a run of blocks with chunked transfer encoding, one chunk per
+// block, over a connection that is kept open between requests:
+//
+//   POST <url>
+//   X-History-From: <first seq>
+//   X-History-To: <last seq + 1>
+//   Transfer-Encoding: chunked
+//
+//   body: repeated { u32 seq, u16 size, <size bytes of SeriesBlock> } (little endian),
+//         overwritten or damaged blocks of the range are left out
+//
+// The server answers "next=<seq>" with the first block it still wants (normally the
+// X-History-To value). That offset is stored in NVS, so an interrupted upload resumes
+// where the server says it stopped, also after a reset; the server may as well rewind
+// it to get blocks again. tools/history_server.py is a test server.
+class HistoryUploader
+{
+public:
+    using online_t = std::function<bool()>;
+
+    HistoryUploader(HistoryLog* history, online_t online);
+    ~HistoryUploader();
+
+    // NVS must be initialized
+    void Start(const char* url, uint32_t interval_s);
+    void Stop();
+
+    // Upload now instead of at the next interval
+    void Wake();
+
+    uint32_t NextSeq() const { return m_next; }
+
+private:
+    HistoryLog* m_history;
+    online_t m_online;
+    const char* m_url = nullptr;
+    uint32_t m_interval_s = 0;
+
+    TaskHandle_t m_task = nullptr;
+    volatile bool m_stop_task = false;
+    esp_http_client_handle_t m_client = nullptr;
+
+    static constexpr size_t FRAME_HEADER_SIZE = 6;      // u32 seq, u16 size
+
+    std::atomic<uint32_t> m_next = 0;       // First block the server hasn't confirmed
+    uint8_t m_frame[FRAME_HEADER_SIZE + HistoryLog::BLOCK_SIZE];
+
+    void upload_task();
+    esp_err_t upload(uint32_t* count);
+    esp_err_t post(uint32_t from, uint32_t to, uint32_t* count, size_t* bytes);
+    bool write_chunk(const void* data, size_t size);
+    void disconnect();
+
+    void load_next();
+    void save_next();
+};
@@ -0,0 +1,213 @@
+#include "I2cBus.h"
+
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#include <cassert>
+
+#include "common.h"
+
+// Callers wait for completion on their own notification slot, so waiting for the bus
+// doesn't consume notifications that the task uses for something else (slot 0)
+constexpr const UBaseType_t NOTIFY_INDEX = 1;
+static_assert(configTASK_NOTIFICATION_ARRAY_ENTRIES > NOTIFY_INDEX, "Set CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES to 2 or more");
+
+constexpr const int64_t STATS_INTERVAL_US = 10 * 1000 * 1000LL;     // 10 s
+
+I2cBus::~I2cBus()
+{
+    Stop();
+}
+
+int I2cBus::AddDevice(const char* name)
+{
+    assert(m_devices < MAX_DEVICES);
+    m_stats[m_devices].name = name;
+    return m_devices++;
+}
+
+void I2cBus::Start()
+{
+    if (m_task)
+        return;
+
+    m_queue = xQueueCreate(MAX_PENDING, sizeof(Transaction*));
+    assert(m_queue);
+
+    m_stop_task = false;
+    m_window_start = esp_timer_get_time();
+
+    xTaskCreatePinnedToCore(
+        member_cast<TaskFunction_t>(&I2cBus::bus_task),
+        "i2c_bus_task",
+        4096,                   // Operations run on this stack, including the OLED driver
+        this,
+        7,                      // Above every client, so the bus never idles while work is queued
+        &m_task,
+        xPortGetCoreID()
+    );
+}
+
+void I2cBus::Stop()
+{
+    if (!m_task)
+        return;
+
+    m_stop_task = true;
+    Transaction* wakeup = nullptr;
+    xQueueSend(m_queue, &wakeup, portMAX_DELAY);
+
+    while (m_task) {
+        vTaskDelay(1);
+    }
+
+    vQueueDelete(m_queue);
+    m_queue = {};
+}
+
+bool I2cBus::GetStats(int device, Stats* stats) const
+{
+    if (device < 0 || device >= m_devices)
+        return false;
+
+    *stats = m_stats[device];
+    return true;
+}
+
+esp_err_t I2cBus::submit(int device, Priority priority, uint32_t timeout_us, invoke_t invoke, void* arg)
+{
+    const int64_t now = esp_timer_get_time();
+
+    // Not started yet (setup), or nested call from an operation already running on the bus
+    if (!m_task || xTaskGetCurrentTaskHandle() == m_task) {
+        esp_err_t result = invoke(arg);
+        account(device, 0, esp_timer_get_time() - now);
+        return result;
+    }
+
+    Transaction t = {};
+    t.invoke = invoke;
+    t.arg = arg;
+    t.device = device;
+    t.priority = priority;
+    t.deadline = timeout_us ? now + timeout_us : 0;
+    t.submitted = now;
+    t.caller = xTaskGetCurrentTaskHandle();
+    t.result = ESP_FAIL;
+
+    Transaction* ptr = &t;
+    xQueueSend(m_queue, &ptr, portMAX_DELAY);
+    ulTaskNotifyTakeIndexed(NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+
+    return t.result;
+}
+
+void I2cBus::bus_task()
+{
+    const TickType_t idle_timeout = pdMS_TO_TICKS(STATS_INTERVAL_US / 1000);
+
+    while (!m_stop_task || m_pending_count) {
+        // Collect everything submitted so far, block only when there is nothing to run
+        Transaction* t = nullptr;
+        while (m_pending_count < MAX_PENDING
+            && xQueueReceive(m_queue, &t, m_pending_count ? 0 : idle_timeout) == pdTRUE) {
+            if (!t)
+                break;              // Stop() wakeup
+            t->seq = m_seq++;
+            m_pending[m_pending_count++] = t;
+        }
+
+        if (m_pending_count) {
+            run(take_next());
+        }
+
+        report_stats();
+    }
+
+    m_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+I2cBus::Transaction* I2cBus::take_next()
+{
+    // Highest priority first, earliest deadline within a priority, then FIFO
+    auto before = [] (const Transaction* a, const Transaction* b) {
+        if (a->priority != b->priority)
+            return a->priority < b->priority;
+        const int64_t da = a->deadline ? a->deadline : INT64_MAX;
+        const int64_t db = b->deadline ? b->deadline : INT64_MAX;
+        if (da != db)
+            return da < db;
+        return static_cast<int32_t>(a->seq - b->seq) < 0;
+    };
+
+    int best = 0;
+    for (int i = 1; i < m_pending_count; ++i) {
+        if (before(m_pending[i], m_pending[best])) {
+            best = i;
+        }
+    }
+
+    Transaction* t = m_pending[best];
+    m_pending[best] = m_pending[--m_pending_count];
+    return t;
+}
+
+void I2cBus::run(Transaction* t)
+{
+    const int64_t start = esp_timer_get_time();
+
+    if (t->deadline && start > t->deadline) {
+        t->result = ESP_ERR_TIMEOUT;
+        if (t->device >= 0 && t->device < m_devices) {
+            ++m_stats[t->device].missed;
+        }
+    }
+    else {
+        t->result = t->invoke(t->arg);
+        account(t->device, start - t->submitted, esp_timer_get_time() - start);
+    }
+
+    // Transaction lives on the caller's stack, don't touch it after this
+    xTaskNotifyGiveIndexed(t->caller, NOTIFY_INDEX);
+}
+
+void I2cBus::account(int device, int64_t wait_us, int64_t busy_us)
+{
+    if (device < 0 || device >= m_devices)
+        return;
+
+    Stats& stats = m_stats[device];
+    ++stats.count;
+    stats.busy_us += busy_us;
+    stats.wait_us += wait_us;
+    if (wait_us > stats.wait_max_us) {
+        stats.wait_max_us = wait_us;
+    }
+}
+
+void I2cBus::report_stats()
+{
+    const int64_t now = esp_timer_get_time();
+    const int64_t elapsed = now - m_window_start;
+    if (elapsed < STATS_INTERVAL_US)
+        return;
+
+    for (int i = 0; i < m_devices; ++i) {
+        Stats& stats = m_stats[i];
+        // Occupancy in per mille, the log has no use for floating point
+        const unsigned long busy = stats.busy_us * 1000 / elapsed;
+        ESP_LOGI(TAG, "I2C %-8s: %5lu ops, busy %3lu.%lu%%, wait avg %lu us, max %lu us, missed %lu",
+            stats.name,
+            (unsigned long) stats.count,
+            busy / 10, busy % 10,
+            (unsigned long) (stats.count ? stats.wait_us / stats.count : 0),
+            (unsigned long) stats.wait_max_us,
+            (unsigned long) stats.missed);
+
+        stats = { stats.name };
+    }
+
+    m_window_start = now;
+}
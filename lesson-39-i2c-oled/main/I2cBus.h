@@ -0,0 +1,95 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <esp_err.h>
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Serializes all transactions on the shared I2C bus through one task. Callers submit
+// an operation with a priority and an optional deadline and block until it has run;
+// the bus task always starts the most urgent pending operation next, so a sensor read
+// waits for at most one display chunk instead of a whole frame. Submission is
+// synchronous: there is no completion callback, the caller sleeps on its notification
+// index 1 and gets op()'s result back. Keeps per-device bus occupancy and queueing
+// latency, logged every STATS_INTERVAL.
+class I2cBus
+{
+public:
+    enum Priority : uint8_t {
+        PRIO_SENSOR = 0,        // Highest
+        PRIO_CLOCK,
+        PRIO_STORAGE,
+        PRIO_DISPLAY,           // Lowest
+    };
+
+    struct Stats {
+        const char* name;
+        uint32_t count;         // Operations run in the current window
+        uint32_t missed;        // Operations dropped because their deadline had passed
+        uint64_t busy_us;       // Time spent running operations
+        uint64_t wait_us;       // Time operations spent queued
+        uint32_t wait_max_us;
+    };
+
+    static constexpr int MAX_DEVICES = 8;
+
+    I2cBus() = default;
+    ~I2cBus();
+
+    int AddDevice(const char* name);
+
+    void Start();
+    void Stop();
+
+    // Runs op() on the bus task and returns its result. timeout_us = 0 means no deadline,
+    // otherwise ESP_ERR_TIMEOUT is returned if op() could not be started in time.
+    template <typename F>
+    esp_err_t Execute(int device, Priority priority, uint32_t timeout_us, F&& op)
+    {
+        using op_t = std::remove_reference_t<F>;
+        return submit(device, priority, timeout_us,
+            [] (void* arg) -> esp_err_t { return (*static_cast<op_t*>(arg))(); },
+            const_cast<void*>(static_cast<const void*>(std::addressof(op))));
+    }
+
+    bool GetStats(int device, Stats* stats) const;
+
+private:
+    using invoke_t = esp_err_t (*)(void* arg);
+
+    struct Transaction {
+        invoke_t invoke;
+        void* arg;
+        int device;
+        Priority priority;
+        int64_t deadline;       // esp_timer time, 0 = none
+        int64_t submitted;
+        uint32_t seq;
+        TaskHandle_t caller;
+        esp_err_t result;
+    };
+
+    static constexpr int MAX_PENDING = 8;
+
+    TaskHandle_t m_task = nullptr;
+    QueueHandle_t m_queue = {};
+    volatile bool m_stop_task = false;
+
+    Transaction* m_pending[MAX_PENDING] = {};
+    int m_pending_count = 0;
+    uint32_t m_seq = 0;
+
+    Stats m_stats[MAX_DEVICES] = {};
+    int m_devices = 0;
+    int64_t m_window_start = 0;
+
+    esp_err_t submit(int device, Priority priority, uint32_t timeout_us, invoke_t invoke, void* arg);
+    void bus_task();
+    Transaction* take_next();
+    void run(Transaction* t);
+    void account(int device, int64_t wait_us, int64_t busy_us);
+    void report_stats();
+};
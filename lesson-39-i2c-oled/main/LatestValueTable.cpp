@@ -0,0 +1,112 @@
+#include "LatestValueTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr const size_t MASK = LatestValueTable::SLOTS - 1;
+
+static_assert((LatestValueTable::SLOTS & MASK) == 0);
+
+LatestValueTable::PutResult LatestValueTable::Put(const char* topic, size_t topic_len, const char* data, size_t data_len)
+{
+    // Keep the end of an overlong topic, that's where the metric name is
+    if (topic_len > MAX_TOPIC) {
+        topic += topic_len - MAX_TOPIC;
+        topic_len = MAX_TOPIC;
+    }
+    data_len = std::min(data_len, MAX_DATA);
+
+    const std::string_view key(topic, topic_len);
+    const uint32_t h = hash(key);
+
+    // Values are small, copying under the spinlock is cheaper than anything lock-free
+    taskENTER_CRITICAL(&m_lock);
+
+    // Probe until the topic or a free entry, the whole table when it's full
+    size_t pos = h & MASK;
+    bool found = false;
+    for (int i = 0; i < SLOTS && m_entries[pos].used; ++i, pos = (pos + 1) & MASK) {
+        const Value& v = m_entries[pos].value;
+        if (m_entries[pos].hash == h && key == std::string_view(v.topic, v.topic_len)) {
+            found = true;
+            break;
+        }
+    }
+
+    PutResult result = PUT_REPLACED;
+    Entry& e = m_entries[pos];
+    if (found) {
+        ++e.value.superseded;
+        ++m_superseded;
+    }
+    else if (!e.used) {
+        std::memcpy(e.value.topic, topic, topic_len);
+        e.value.topic_len = topic_len;
+        e.value.superseded = 0;
+        e.hash = h;
+        e.used = true;
+        m_high_water = std::max(m_high_water, ++m_count);
+        result = PUT_ADDED;
+    }
+    else {
+        ++m_dropped;
+        taskEXIT_CRITICAL(&m_lock);
+        return PUT_DROPPED;
+    }
+
+    std::memcpy(e.value.data, data, data_len);
+    e.value.data_len = data_len;
+
+    taskEXIT_CRITICAL(&m_lock);
+
+    return result;
+}
+
+bool LatestValueTable::Take(Value* value)
+{
+    bool taken = false;
+
+    taskENTER_CRITICAL(&m_lock);
+
+    for (size_t pos = 0; m_count && pos < SLOTS; ++pos) {
+        if (m_entries[pos].used) {
+            *value = m_entries[pos].value;
+            remove(pos);
+            taken = true;
+            break;
+        }
+    }
+
+    taskEXIT_CRITICAL(&m_lock);
+
+    return taken;
+}
+
+void LatestValueTable::remove(size_t pos)
+{
+    // Backward-shift deletion: pull following entries of the cluster into the hole
+    // unless that would move them before their home slot
+    size_t hole = pos;
+    for (size_t i = (hole + 1) & MASK; i != pos && m_entries[i].used; i = (i + 1) & MASK) {
+        const size_t home = m_entries[i].hash & MASK;
+        if (((i - home) & MASK) >= ((i - hole) & MASK)) {
+            m_entries[hole] = m_entries[i];
+            hole = i;
+        }
+    }
+    m_entries[hole].used = false;
+    --m_count;
+}
+
+/* static */ uint32_t LatestValueTable::hash(std::string_view topic)
+{
+    // FNV-1a, then a final mix: table indexes come from the low bits
+    uint32_t h = 2166136261u;
+    for (uint8_t ch : topic) {
+        h = (h ^ ch) * 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
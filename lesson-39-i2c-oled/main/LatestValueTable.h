@@ -0,0 +1,66 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Latest-value-wins mailbox between a producer task and the display task, one entry per
+// topic. A write to a topic whose value has not been taken yet replaces that value and
+// counts it as superseded, so the consumer renders at most one update per topic per
+// frame, and a burst on one topic can neither fill up the path nor push out newer values
+// of other topics. Entries are found by the full topic through a small open-addressing
+// table (linear probing, backward-shift deletion on Take()). When SLOTS different topics
+// are pending, a value of yet another topic is dropped and counted.
+class LatestValueTable
+{
+public:
+    static constexpr int SLOTS = 16;            // Power of two
+    static constexpr size_t MAX_TOPIC = 64;
+    static constexpr size_t MAX_DATA = 32;
+
+    struct Value {
+        char topic[MAX_TOPIC];
+        size_t topic_len;
+        char data[MAX_DATA];
+        size_t data_len;
+        uint32_t superseded;    // Values replaced before this one was taken
+    };
+
+    enum PutResult : uint8_t {
+        PUT_ADDED,              // Topic had no pending value, the consumer has to be woken up
+        PUT_REPLACED,           // Pending value superseded
+        PUT_DROPPED,            // Table full of other topics
+    };
+
+    LatestValueTable() = default;
+
+    // Longer data is truncated, longer topic keeps its last levels
+    PutResult Put(const char* topic, size_t topic_len, const char* data, size_t data_len);
+
+    // Copies one pending value out and removes it, false if there is nothing new
+    bool Take(Value* value);
+
+    uint32_t Superseded() const { return m_superseded; }
+    uint32_t Dropped() const { return m_dropped; }
+    size_t HighWater() const { return m_high_water; }
+
+private:
+    struct Entry {
+        Value value;
+        uint32_t hash;
+        bool used;
+    };
+
+    Entry m_entries[SLOTS] = {};
+    size_t m_count = 0;
+    size_t m_high_water = 0;
+    uint32_t m_superseded = 0;
+    uint32_t m_dropped = 0;
+    portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+    void remove(size_t pos);
+
+    static uint32_t hash(std::string_view topic);
+};
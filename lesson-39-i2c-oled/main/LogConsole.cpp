@@ -0,0 +1,154 @@
+#include "LogConsole.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Rows per second that may scroll the console, and the burst allowed on top of that
+constexpr const int32_t RATE_ROWS_PER_SEC = 2;
+constexpr const int32_t RATE_BURST = 4;
+
+// Long messages wrap to at most this many rows
+constexpr const int MAX_ROWS_PER_MESSAGE = 4;
+
+LogConsole::LogConsole(OledFramebuffer* screen, int first_page, int last_page)
+    : m_screen(screen)
+    , m_first_page(first_page)
+    , m_last_page(std::max(first_page, last_page))
+    , m_tokens(RATE_BURST)
+{
+}
+
+void LogConsole::Print(const char* text)
+{
+    // Repeated message: count instead of scrolling
+    if (!m_transient && m_row_count && std::strncmp(text, m_last, sizeof(m_last) - 1) == 0) {
+        ++m_repeat;
+
+        char row[COLS + 1];
+        char suffix[12];
+        const int suffix_len = snprintf(suffix, sizeof(suffix), " x%lu", (unsigned long) m_repeat);
+        const int len = std::min<int>(std::strlen(text), COLS);
+        snprintf(row, sizeof(row), "%-*.*s%s", COLS - suffix_len, std::min(len, COLS - suffix_len), text, suffix);
+        rewrite_row(row, COLS);
+        return;
+    }
+
+    std::strncpy(m_last, text, sizeof(m_last) - 1);
+    m_repeat = 1;
+    m_transient = false;
+
+    int len = std::min<int>(std::strlen(text), COLS * MAX_ROWS_PER_MESSAGE);
+    do {
+        const int n = std::min(len, COLS);
+        if (take_token()) {
+            append_row(text, n);
+        }
+        else {
+            ++m_rate_limited;
+            rewrite_row(text, n);
+        }
+        text += n;
+        len -= n;
+    } while (len > 0);
+}
+
+void LogConsole::Update(const char* text)
+{
+    const int len = std::min<int>(std::strlen(text), COLS);
+    if (m_transient) {
+        rewrite_row(text, len);
+    }
+    else {
+        append_row(text, len);
+        m_transient = true;
+    }
+    m_last[0] = '\0';
+}
+
+void LogConsole::ScrollBack(int rows)
+{
+    const int max_scroll = std::max<int>(0, std::min<uint32_t>(m_row_count, SCROLLBACK) - (m_last_page - m_first_page + 1));
+    m_scroll = std::clamp(rows, 0, max_scroll);
+    repaint();
+}
+
+bool LogConsole::take_token()
+{
+    const int64_t now = esp_timer_get_time();
+    const int64_t period = 1000 * 1000 / RATE_ROWS_PER_SEC;
+
+    if (const int64_t earned = (now - m_refill_time) / period; earned > 0) {
+        m_tokens = std::min<int64_t>(RATE_BURST, m_tokens + earned);
+        m_refill_time += earned * period;
+    }
+    if (m_tokens == RATE_BURST) {
+        m_refill_time = now;
+    }
+
+    if (!m_tokens)
+        return false;
+    --m_tokens;
+    return true;
+}
+
+void LogConsole::append_row(const char* text, int len)
+{
+    char* row = m_rows[m_row_count++ % SCROLLBACK];
+    std::memset(row, ' ', COLS);
+    std::memcpy(row, text, len);
+
+    // Scrolled back: keep the view still, it's repainted when following again
+    if (m_scroll)
+        return;
+
+    for (int page = m_first_page; page < m_last_page; ++page) {
+        m_screen->CopyPage(page, page + 1);
+    }
+    draw_row(m_last_page, row);
+}
+
+void LogConsole::rewrite_row(const char* text, int len)
+{
+    if (!m_row_count) {
+        append_row(text, len);
+        return;
+    }
+
+    char* row = newest_row();
+    std::memset(row, ' ', COLS);
+    std::memcpy(row, text, len);
+
+    if (!m_scroll) {
+        draw_row(m_last_page, row);
+    }
+}
+
+char* LogConsole::newest_row()
+{
+    return m_rows[(m_row_count - 1) % SCROLLBACK];
+}
+
+void LogConsole::draw_row(int page, const char* row)
+{
+    char line[COLS + 1];
+    std::memcpy(line, row, COLS);
+    line[COLS] = '\0';
+    m_screen->DrawText(page, line);
+}
+
+void LogConsole::repaint()
+{
+    static constexpr char EMPTY[COLS] = {};
+
+    // Bottom page shows the row m_scroll rows back from the newest
+    for (int page = m_last_page; page >= m_first_page; --page) {
+        const int64_t index = static_cast<int64_t>(m_row_count) - 1 - m_scroll - (m_last_page - page);
+        if (index < 0 || index <= static_cast<int64_t>(m_row_count) - 1 - SCROLLBACK)
+            draw_row(page, EMPTY);
+        else
+            draw_row(page, m_rows[index % SCROLLBACK]);
+    }
+}
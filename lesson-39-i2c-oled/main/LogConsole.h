@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+#include "OledFramebuffer.h"
+
+// Scrolling text console in a range of OLED pages, backed by a ring of text rows that
+// also serves as scrollback. A new row scrolls the pages up inside the framebuffer and
+// repaints just the bottom one. To keep the small region readable:
+//  - a message equal to the previous one is not repeated, the bottom row gets an "xN" count
+//  - rows beyond the rate limit overwrite the bottom row instead of scrolling
+//  - Update() is for transient status (spinners, progress), consecutive updates share one row
+class LogConsole
+{
+public:
+    static constexpr int COLS = OledFramebuffer::CHARS_PER_LINE;
+    static constexpr int SCROLLBACK = 32;
+    static constexpr int MAX_MESSAGE = 64;
+
+    LogConsole(OledFramebuffer* screen, int first_page, int last_page);
+
+    void Print(const char* text);
+    void Update(const char* text);
+
+    // Shows older rows, 0 follows the newest again
+    void ScrollBack(int rows);
+    int Scrolled() const { return m_scroll; }
+
+    uint32_t RateLimited() const { return m_rate_limited; }
+
+private:
+    OledFramebuffer* m_screen;
+    int m_first_page;
+    int m_last_page;
+
+    char m_rows[SCROLLBACK][COLS] = {};
+    uint32_t m_row_count = 0;           // Rows ever appended, newest is m_row_count - 1
+    int m_scroll = 0;
+
+    char m_last[MAX_MESSAGE] = {};      // Last printed message and its repeat count
+    uint32_t m_repeat = 0;
+    bool m_transient = false;           // Newest row was written by Update()
+
+    int32_t m_tokens;
+    int64_t m_refill_time = 0;
+    uint32_t m_rate_limited = 0;
+
+    bool take_token();
+    void append_row(const char* text, int len);
+    void rewrite_row(const char* text, int len);
+    char* newest_row();
+    void draw_row(int page, const char* row);
+    void repaint();
+};
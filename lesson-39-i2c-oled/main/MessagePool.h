@@ -0,0 +1,73 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed pool of message blocks for passing messages between tasks by index. The
+// producer fills a block in place and queues its 2-byte index, and the consumer uses
+// the block in place and releases it. A message is therefore never copied into or out
+// of the queue. Free blocks are on an index-linked stack behind a spinlock, and the
+// _SAFE critical section makes Allocate() and Release() callable from tasks and ISRs.
+template <typename T, size_t N>
+class MessagePool
+{
+public:
+    static constexpr size_t SIZE = N;
+    static constexpr uint16_t NONE = 0xFFFF;
+    static_assert(N < NONE);
+
+    MessagePool()
+    {
+        for (size_t i = 0; i < N; ++i) {
+            m_next[i] = i + 1 < N ? i + 1 : NONE;
+        }
+    }
+
+    // NONE and counted as exhausted when every block is in use
+    uint16_t Allocate()
+    {
+        portENTER_CRITICAL_SAFE(&m_lock);
+        const uint16_t index = m_free;
+        if (index != NONE) {
+            m_free = m_next[index];
+            if (++m_in_use > m_peak) {
+                m_peak = m_in_use;
+            }
+        }
+        else {
+            ++m_exhausted;
+        }
+        portEXIT_CRITICAL_SAFE(&m_lock);
+        return index;
+    }
+
+    void Release(uint16_t index)
+    {
+        if (index >= N)
+            return;
+
+        portENTER_CRITICAL_SAFE(&m_lock);
+        m_next[index] = m_free;
+        m_free = index;
+        --m_in_use;
+        portEXIT_CRITICAL_SAFE(&m_lock);
+    }
+
+    // Only the holder of an allocated index may touch its block
+    T& operator[](uint16_t index) { return m_blocks[index]; }
+
+    size_t InUse() const { return m_in_use; }
+    size_t Peak() const { return m_peak; }
+    uint32_t Exhausted() const { return m_exhausted; }
+
+private:
+    T m_blocks[N] = {};
+    uint16_t m_next[N];
+    uint16_t m_free = 0;
+    size_t m_in_use = 0;
+    size_t m_peak = 0;
+    uint32_t m_exhausted = 0;
+    portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+};
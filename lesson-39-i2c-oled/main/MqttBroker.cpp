@@ -0,0 +1,589 @@
+#include <sdkconfig.h>
+
+// Built only with the broker mode on, the pool sizes exist only then
+#ifdef CONFIG_BROKER_ENABLE
+
+#include "MqttBroker.h"
+
+#include <esp_timer.h>
+#include <esp_log.h>
+#include <lwip/sockets.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+#include "common.h"
+#include "TopicRouter.h"
+
+enum PacketType : uint8_t {
+    CONNECT = 1,
+    CONNACK = 2,
+    PUBLISH = 3,
+    PUBACK = 4,
+    SUBSCRIBE = 8,
+    SUBACK = 9,
+    UNSUBSCRIBE = 10,
+    UNSUBACK = 11,
+    PINGREQ = 12,
+    PINGRESP = 13,
+    DISCONNECT = 14,
+};
+
+constexpr const uint8_t CONNACK_ACCEPTED = 0;
+constexpr const uint8_t CONNACK_BAD_PROTOCOL = 1;
+constexpr const uint8_t CONNACK_BAD_CLIENT_ID = 2;
+constexpr const uint8_t SUBACK_FAILURE = 0x80;
+
+// Sockets taken besides the clients: the listener, the upstream MQTT connection and the
+// history upload
+constexpr const int OTHER_SOCKETS = 3;
+static_assert(CONFIG_BROKER_MAX_CLIENTS + OTHER_SOCKETS <= CONFIG_LWIP_MAX_SOCKETS,
+    "BROKER_MAX_CLIENTS needs LWIP_MAX_SOCKETS >= BROKER_MAX_CLIENTS + 3");
+
+constexpr const int64_t CONNECT_TIMEOUT_US = 10 * 1000 * 1000LL;    // Socket open, no CONNECT yet
+constexpr const int64_t STATS_INTERVAL_US = 60 * 1000 * 1000LL;
+
+// Fixed header is the packet type byte and the remaining length in 1..4 bytes of 7 bits.
+// Returns the header size, 0 if the length isn't complete yet, -1 if it is malformed.
+static int decode_header(const uint8_t* data, size_t size, size_t* length)
+{
+    size_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (size < 2u + i)
+            return 0;
+
+        const uint8_t byte = data[1 + i];
+        value |= static_cast<size_t>(byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            *length = value;
+            return 2 + i;
+        }
+    }
+    return -1;
+}
+
+static size_t encode_length(uint8_t* out, size_t length)
+{
+    size_t n = 0;
+    do {
+        out[n] = length & 0x7F;
+        length >>= 7;
+        if (length)
+            out[n] |= 0x80;
+        ++n;
+    } while (length);
+    return n;
+}
+
+// String field: u16 big-endian length and the bytes, advances pos past it
+static bool read_string(const uint8_t* body, size_t len, size_t* pos, std::string_view* str)
+{
+    if (*pos + 2 > len)
+        return false;
+
+    const size_t n = (body[*pos] << 8) | body[*pos + 1];
+    if (*pos + 2 + n > len)
+        return false;
+
+    *str = std::string_view(reinterpret_cast<const char*>(body + *pos + 2), n);
+    *pos += 2 + n;
+    return true;
+}
+
+MqttBroker::MqttBroker(publish_t on_publish)
+    : m_on_publish(on_publish)
+{
+    for (Client& c : m_clients) {
+        c.sock = -1;
+    }
+    for (Subscription& s : m_subscriptions) {
+        s.client = -1;
+    }
+}
+
+MqttBroker::~MqttBroker()
+{
+    Stop();
+}
+
+esp_err_t MqttBroker::Start(uint16_t port)
+{
+    if (m_task)
+        return ESP_ERR_INVALID_STATE;
+
+    m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (m_listen < 0)
+        return ESP_FAIL;
+
+    int one = 1;
+    setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listen, 4) != 0) {
+        ESP_LOGW(TAG, "Broker: can't listen on port %u (errno %d)", port, errno);
+        close(m_listen);
+        m_listen = -1;
+        return ESP_FAIL;
+    }
+
+    m_stop_task = false;
+    xTaskCreatePinnedToCore(
+        member_cast<TaskFunction_t>(&MqttBroker::broker_task),
+        "broker_task",
+        4096,                   // Packets are parsed in place, the callback updates the node table
+        this,
+        4,                      // Below display and sampler, above the history upload
+        &m_task,
+        tskNO_AFFINITY
+    );
+
+    ESP_LOGI(TAG, "Broker: listening on port %u, up to %d clients", port, MAX_CLIENTS);
+    return ESP_OK;
+}
+
+void MqttBroker::Stop()
+{
+    if (!m_task)
+        return;
+
+    // Task notices within one select() timeout
+    m_stop_task = true;
+    while (m_task) {
+        vTaskDelay(1);
+    }
+}
+
+MqttBroker::Stats MqttBroker::GetStats() const
+{
+    return Stats {
+        .clients = m_client_count,
+        .connects = m_connects,
+        .received = m_received,
+        .delivered = m_delivered,
+        .dropped = m_dropped,
+        .refused = m_refused,
+    };
+}
+
+void MqttBroker::broker_task()
+{
+    int64_t stats_time = esp_timer_get_time();
+
+    while (!m_stop_task) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(m_listen, &readable);
+        int max_fd = m_listen;
+        for (const Client& c : m_clients) {
+            if (c.sock >= 0) {
+                FD_SET(c.sock, &readable);
+                max_fd = std::max(max_fd, c.sock);
+            }
+        }
+
+        timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+        const int ready = select(max_fd + 1, &readable, nullptr, nullptr, &timeout);
+        if (ready < 0) {
+            ESP_LOGW(TAG, "Broker: select failed (errno %d)", errno);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        if (ready > 0) {
+            if (FD_ISSET(m_listen, &readable)) {
+                accept_client();
+            }
+            for (int i = 0; i < MAX_CLIENTS; ++i) {
+                if (m_clients[i].sock >= 0 && FD_ISSET(m_clients[i].sock, &readable)) {
+                    receive(i);
+                }
+            }
+        }
+
+        const int64_t now = esp_timer_get_time();
+        check_keep_alive(now);
+
+        if (now - stats_time >= STATS_INTERVAL_US) {
+            stats_time = now;
+            ESP_LOGI(TAG, "Broker: %lu clients, %lu connects, %lu received, %lu delivered, %lu dropped, %lu refused",
+                (unsigned long) m_client_count, (unsigned long) m_connects, (unsigned long) m_received,
+                (unsigned long) m_delivered, (unsigned long) m_dropped, (unsigned long) m_refused);
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        close_client(i);
+    }
+    close(m_listen);
+    m_listen = -1;
+
+    m_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void MqttBroker::accept_client()
+{
+    const int sock = accept(m_listen, nullptr, nullptr);
+    if (sock < 0)
+        return;
+
+    int index = 0;
+    while (index < MAX_CLIENTS && m_clients[index].sock >= 0) {
+        ++index;
+    }
+    if (index == MAX_CLIENTS) {
+        // A burst of clients would otherwise flood the console, one line per connect
+        if (!m_refusing) {
+            ESP_LOGW(TAG, "Broker: all %d client slots in use, refusing connections", MAX_CLIENTS);
+            m_refusing = true;
+        }
+        ++m_refused;
+        close(sock);
+        return;
+    }
+
+    // Sends never block the other clients, small packets go out right away
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Client& c = m_clients[index];
+    c.sock = sock;
+    c.connected = false;
+    c.keep_alive_s = 0;
+    c.last_rx_us = esp_timer_get_time();
+    c.rx_len = 0;
+    c.id[0] = '\0';
+    ++m_client_count;
+}
+
+void MqttBroker::receive(int index)
+{
+    Client& c = m_clients[index];
+
+    const ssize_t n = recv(c.sock, c.rx + c.rx_len, sizeof(c.rx) - c.rx_len, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (n <= 0) {
+        close_client(index);
+        return;
+    }
+    c.rx_len += n;
+    c.last_rx_us = esp_timer_get_time();
+
+    // Handle every complete packet in the buffer, keep the start of the next one
+    size_t pos = 0;
+    while (pos < c.rx_len) {
+        size_t length = 0;
+        const int header = decode_header(c.rx + pos, c.rx_len - pos, &length);
+        if (header < 0 || header + length > MAX_PACKET) {
+            ESP_LOGW(TAG, "Broker: malformed or oversized packet from '%s'", c.id);
+            close_client(index);
+            return;
+        }
+        if (header == 0 || c.rx_len - pos < header + length)
+            break;
+
+        if (!handle_packet(index, c.rx[pos], c.rx + pos + header, length)) {
+            close_client(index);
+            return;
+        }
+        // Delivery may have dropped this client too
+        if (c.sock < 0)
+            return;
+
+        pos += header + length;
+    }
+
+    std::memmove(c.rx, c.rx + pos, c.rx_len - pos);
+    c.rx_len -= pos;
+}
+
+void MqttBroker::check_keep_alive(int64_t now_us)
+{
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+        const Client& c = m_clients[i];
+        if (c.sock < 0)
+            continue;
+
+        // One and a half keep alive periods without a packet, as the spec says
+        const int64_t limit_us = c.connected ? c.keep_alive_s * 1500 * 1000LL : CONNECT_TIMEOUT_US;
+        if (limit_us && now_us - c.last_rx_us > limit_us) {
+            ESP_LOGI(TAG, "Broker: client '%s' timed out", c.id);
+            close_client(i);
+        }
+    }
+}
+
+void MqttBroker::close_client(int index)
+{
+    Client& c = m_clients[index];
+    if (c.sock < 0)
+        return;
+
+    unsubscribe_all(index);
+    close(c.sock);
+    c.sock = -1;
+    c.connected = false;
+    c.rx_len = 0;
+    --m_client_count;
+    m_refusing = false;
+}
+
+bool MqttBroker::handle_packet(int index, uint8_t header, const uint8_t* body, size_t len)
+{
+    const uint8_t type = header >> 4;
+    const uint8_t flags = header & 0x0F;
+
+    if (!m_clients[index].connected)
+        return type == CONNECT && handle_connect(index, body, len);
+
+    switch (type) {
+    case PUBLISH:
+        return handle_publish(index, header, body, len);
+    case PUBACK:
+        return true;            // Nothing goes out with QoS 1
+    case SUBSCRIBE:
+        return flags == 0x02 && handle_subscribe(index, body, len);
+    case UNSUBSCRIBE:
+        return flags == 0x02 && handle_unsubscribe(index, body, len);
+    case PINGREQ:
+        return send_packet(index, PINGRESP << 4, nullptr, 0);
+    default:
+        return false;           // DISCONNECT, a second CONNECT, QoS 2 flow, garbage
+    }
+}
+
+bool MqttBroker::handle_connect(int index, const uint8_t* body, size_t len)
+{
+    size_t pos = 0;
+    std::string_view protocol;
+    if (!read_string(body, len, &pos, &protocol) || pos + 4 > len)
+        return false;
+
+    const uint8_t level = body[pos];
+    const uint8_t flags = body[pos + 1];
+    const uint16_t keep_alive = (body[pos + 2] << 8) | body[pos + 3];
+    pos += 4;
+
+    if (protocol != "MQTT" || level != 4) {
+        const uint8_t ack[2] = { 0, CONNACK_BAD_PROTOCOL };
+        send_packet(index, CONNACK << 4, ack, sizeof(ack));
+        return false;
+    }
+
+    // Will and credentials are parsed over, not used
+    std::string_view id, field;
+    if (!read_string(body, len, &pos, &id))
+        return false;
+    if ((flags & 0x04) && (!read_string(body, len, &pos, &field) || !read_string(body, len, &pos, &field)))
+        return false;
+    if ((flags & 0x80) && !read_string(body, len, &pos, &field))
+        return false;
+    if ((flags & 0x40) && !read_string(body, len, &pos, &field))
+        return false;
+
+    // Without sessions an empty ID is only fine with clean session set
+    if (id.size() > MAX_CLIENT_ID || (id.empty() && !(flags & 0x02))) {
+        const uint8_t ack[2] = { 0, CONNACK_BAD_CLIENT_ID };
+        send_packet(index, CONNACK << 4, ack, sizeof(ack));
+        return false;
+    }
+
+    // Same ID again: the new connection replaces the old one
+    for (int i = 0; i < MAX_CLIENTS && !id.empty(); ++i) {
+        if (i != index && m_clients[i].connected && id == m_clients[i].id) {
+            ESP_LOGI(TAG, "Broker: client '%.*s' reconnected", (int) id.size(), id.data());
+            close_client(i);
+        }
+    }
+
+    Client& c = m_clients[index];
+    std::memcpy(c.id, id.data(), id.size());
+    c.id[id.size()] = '\0';
+    c.keep_alive_s = keep_alive;
+    c.connected = true;
+    ++m_connects;
+
+    const uint8_t ack[2] = { 0, CONNACK_ACCEPTED };
+    return send_packet(index, CONNACK << 4, ack, sizeof(ack));
+}
+
+bool MqttBroker::handle_publish(int index, uint8_t header, const uint8_t* body, size_t len)
+{
+    const int qos = (header >> 1) & 0x03;
+    if (qos > 1)
+        return false;
+
+    size_t pos = 0;
+    std::string_view topic;
+    if (!read_string(body, len, &pos, &topic) || topic.empty() || topic.find_first_of("+#") != topic.npos)
+        return false;
+
+    if (qos) {
+        if (pos + 2 > len)
+            return false;
+
+        // Acknowledged once it's here, subscribers get it at QoS 0
+        const uint8_t ack[2] = { body[pos], body[pos + 1] };
+        pos += 2;
+        if (!send_packet(index, PUBACK << 4, ack, sizeof(ack)))
+            return false;
+    }
+
+    const std::string_view data(reinterpret_cast<const char*>(body + pos), len - pos);
+    ++m_received;
+
+    if (m_on_publish) {
+        m_on_publish(topic, data);
+    }
+    deliver(topic, data);
+    return true;
+}
+
+bool MqttBroker::handle_subscribe(int index, const uint8_t* body, size_t len)
+{
+    if (len < 2)
+        return false;
+
+    // SUBACK: packet ID, then one return code per filter
+    m_tx[0] = body[0];
+    m_tx[1] = body[1];
+    size_t count = 0;
+
+    size_t pos = 2;
+    while (pos < len) {
+        std::string_view filter;
+        if (!read_string(body, len, &pos, &filter) || filter.empty() || pos >= len || body[pos] > 2)
+            return false;
+        ++pos;
+
+        // Granted QoS is always 0
+        m_tx[2 + count++] = subscribe(index, filter) ? 0 : SUBACK_FAILURE;
+    }
+
+    return count && send_packet(index, SUBACK << 4, m_tx, 2 + count);
+}
+
+bool MqttBroker::handle_unsubscribe(int index, const uint8_t* body, size_t len)
+{
+    if (len < 2)
+        return false;
+
+    size_t pos = 2;
+    while (pos < len) {
+        std::string_view filter;
+        if (!read_string(body, len, &pos, &filter))
+            return false;
+        unsubscribe(index, filter);
+    }
+
+    return send_packet(index, UNSUBACK << 4, body, 2);
+}
+
+bool MqttBroker::subscribe(int index, std::string_view filter)
+{
+    // '#' has to be the last character
+    const size_t hash = filter.find('#');
+    if (filter.size() > MAX_FILTER || (hash != filter.npos && hash != filter.size() - 1))
+        return false;
+
+    Subscription* free_slot = nullptr;
+    for (Subscription& s : m_subscriptions) {
+        if (s.client == index && filter == std::string_view(s.filter, s.filter_len))
+            return true;
+        if (s.client < 0 && !free_slot) {
+            free_slot = &s;
+        }
+    }
+    if (!free_slot) {
+        ESP_LOGW(TAG, "Broker: all %d subscriptions in use, '%s' not subscribed", MAX_SUBSCRIPTIONS, m_clients[index].id);
+        return false;
+    }
+
+    free_slot->client = index;
+    free_slot->filter_len = filter.size();
+    std::memcpy(free_slot->filter, filter.data(), filter.size());
+    return true;
+}
+
+void MqttBroker::unsubscribe(int index, std::string_view filter)
+{
+    for (Subscription& s : m_subscriptions) {
+        if (s.client == index && filter == std::string_view(s.filter, s.filter_len)) {
+            s.client = -1;
+        }
+    }
+}
+
+void MqttBroker::unsubscribe_all(int index)
+{
+    for (Subscription& s : m_subscriptions) {
+        if (s.client == index) {
+            s.client = -1;
+        }
+    }
+}
+
+void MqttBroker::deliver(std::string_view topic, std::string_view data)
+{
+    // Overlapping subscriptions of a client get one copy
+    bool sent[MAX_CLIENTS] = {};
+    const uint8_t topic_len[2] = { static_cast<uint8_t>(topic.size() >> 8), static_cast<uint8_t>(topic.size()) };
+
+    for (const Subscription& s : m_subscriptions) {
+        if (s.client < 0 || sent[s.client] || !topic_matches(std::string_view(s.filter, s.filter_len), topic))
+            continue;
+
+        const int client = s.client;
+        sent[client] = true;
+        if (send_packet(client, PUBLISH << 4, topic_len, sizeof(topic_len), topic.data(), topic.size(), data.data(), data.size())) {
+            ++m_delivered;
+        }
+        else {
+            // Part of a packet may be out already, the stream can't be continued
+            ESP_LOGW(TAG, "Broker: client '%s' can't keep up, dropped", m_clients[client].id);
+            ++m_dropped;
+            close_client(client);
+        }
+    }
+}
+
+bool MqttBroker::send_packet(int index, uint8_t header, const void* a, size_t a_len,
+                             const void* b /* = nullptr */, size_t b_len /* = 0 */,
+                             const void* c /* = nullptr */, size_t c_len /* = 0 */)
+{
+    uint8_t fixed[5] = { header };
+    const size_t fixed_len = 1 + encode_length(fixed + 1, a_len + b_len + c_len);
+
+    const struct {
+        const void* data;
+        size_t len;
+    } parts[] = {
+        { fixed, fixed_len },
+        { a, a_len },
+        { b, b_len },
+        { c, c_len },
+    };
+
+    // MSG_MORE lets lwIP put the pieces into one segment
+    size_t last = std::size(parts) - 1;
+    while (last && !parts[last].len) {
+        --last;
+    }
+    for (size_t i = 0; i <= last; ++i) {
+        if (!parts[i].len)
+            continue;
+
+        const ssize_t n = send(m_clients[index].sock, parts[i].data, parts[i].len, MSG_DONTWAIT | (i < last ? MSG_MORE : 0));
+        if (n != static_cast<ssize_t>(parts[i].len))
+            return false;
+    }
+    return true;
+}
+
+#endif // CONFIG_BROKER_ENABLE
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_err.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// Small MQTT 3.1.1 broker for the nodes nearby, one task serving all clients with
+// select(). Every connection and subscription lives in a fixed pool and a packet is
+// parsed in place in its client's receive buffer, so nothing is allocated per client
+// or per message.
+//
+// Subset of the protocol:
+//   CONNECT/CONNACK, PUBLISH QoS 0 and 1 (PUBACK), SUBSCRIBE/SUBACK, UNSUBSCRIBE/UNSUBACK,
+//   PINGREQ/PINGRESP, DISCONNECT. Everything is delivered at QoS 0, there are no retained
+//   messages, no will and no persistent sessions. QoS 2 and packets larger than
+//   MAX_PACKET close the connection. A client whose socket buffer is full is dropped
+//   rather than stalling the others.
+class MqttBroker
+{
+public:
+    static constexpr int MAX_CLIENTS = CONFIG_BROKER_MAX_CLIENTS;
+    static constexpr int MAX_SUBSCRIPTIONS = CONFIG_BROKER_MAX_SUBSCRIPTIONS;
+    static constexpr size_t MAX_PACKET = 512;
+    static constexpr size_t MAX_FILTER = 64;
+    static constexpr size_t MAX_CLIENT_ID = 23;     // Every 3.1.1 broker must accept 23
+
+    // Called on the broker task for every PUBLISH received
+    using publish_t = std::function<void(std::string_view topic, std::string_view data)>;
+
+    struct Stats {
+        uint32_t clients;       // Connected now
+        uint32_t connects;
+        uint32_t received;      // PUBLISH packets from clients
+        uint32_t delivered;     // PUBLISH packets to subscribers
+        uint32_t dropped;       // Clients closed on a full socket buffer
+        uint32_t refused;       // Connections closed with all client slots in use
+    };
+
+    MqttBroker(publish_t on_publish);
+    ~MqttBroker();
+
+    esp_err_t Start(uint16_t port);
+    void Stop();
+
+    Stats GetStats() const;
+
+private:
+    struct Client {
+        int sock;                       // -1 = free
+        bool connected;                 // CONNECT accepted
+        uint16_t keep_alive_s;
+        int64_t last_rx_us;
+        size_t rx_len;
+        char id[MAX_CLIENT_ID + 1];
+        uint8_t rx[MAX_PACKET];
+    };
+
+    struct Subscription {
+        int client;                     // -1 = free
+        uint8_t filter_len;
+        char filter[MAX_FILTER];
+    };
+
+    publish_t m_on_publish;
+    int m_listen = -1;
+    TaskHandle_t m_task = nullptr;
+    volatile bool m_stop_task = false;
+
+    Client m_clients[MAX_CLIENTS];
+    Subscription m_subscriptions[MAX_SUBSCRIPTIONS];
+    uint8_t m_tx[MAX_PACKET];           // Acknowledgements, broker task only
+
+    std::atomic<uint32_t> m_client_count = 0;
+    std::atomic<uint32_t> m_connects = 0;
+    std::atomic<uint32_t> m_received = 0;
+    std::atomic<uint32_t> m_delivered = 0;
+    std::atomic<uint32_t> m_dropped = 0;
+    std::atomic<uint32_t> m_refused = 0;
+    bool m_refusing = false;            // Refusals logged once until a slot is free again
+
+    void broker_task();
+    void accept_client();
+    void receive(int index);
+    void check_keep_alive(int64_t now_us);
+    void close_client(int index);
+
+    // false closes the connection
+    bool handle_packet(int index, uint8_t header, const uint8_t* body, size_t len);
+    bool handle_connect(int index, const uint8_t* body, size_t len);
+    bool handle_publish(int index, uint8_t header, const uint8_t* body, size_t len);
+    bool handle_subscribe(int index, const uint8_t* body, size_t len);
+    bool handle_unsubscribe(int index, const uint8_t* body, size_t len);
+
+    bool subscribe(int index, std::string_view filter);
+    void unsubscribe(int index, std::string_view filter);
+    void unsubscribe_all(int index);
+
+    void deliver(std::string_view topic, std::string_view data);
+
+    // Body is sent in up to three pieces as is, without copying it together
+    bool send_packet(int index, uint8_t header, const void* a, size_t a_len,
+                     const void* b = nullptr, size_t b_len = 0, const void* c = nullptr, size_t c_len = 0);
+};
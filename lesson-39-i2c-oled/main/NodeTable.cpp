@@ -0,0 +1,187 @@
+#include "NodeTable.h"
+
+#include <cmath>
+#include <cstring>
+
+NodeTable::NodeTable()
+{
+    for (auto& slot : m_table) {
+        slot = NONE;
+    }
+}
+
+bool NodeTable::Update(std::string_view id, int metric, float value, int64_t now_us, Source source)
+{
+    if (metric < 0 || metric >= METRICS)
+        return false;
+
+    if (id.size() > MAX_ID) {
+        id.remove_prefix(id.size() - MAX_ID);
+    }
+    const uint32_t h = hash(id);
+
+    taskENTER_CRITICAL(&m_lock);
+
+    size_t pos;
+    uint16_t index = find(id, h, &pos);
+    if (index == NONE) {
+        index = allocate();
+
+        // Eviction may have shifted entries, probe again for the free slot
+        find(id, h, &pos);
+        m_table[pos] = index;
+
+        Entry& e = m_entries[index];
+        memcpy(e.node.id, id.data(), id.size());
+        e.node.id[id.size()] = '\0';
+        for (float& v : e.node.values) {
+            v = NAN;
+        }
+        e.node.updates = 0;
+        e.hash = h;
+        e.used = true;
+        ++m_count;
+    }
+    else {
+        unlink(index);
+    }
+    push_front(index);
+
+    Node& node = m_entries[index].node;
+    node.values[metric] = value;
+    node.updated_us = now_us;
+    node.source = source;
+    ++node.updates;
+
+    taskEXIT_CRITICAL(&m_lock);
+    return true;
+}
+
+bool NodeTable::Get(size_t n, Node* node) const
+{
+    bool found = false;
+
+    taskENTER_CRITICAL(&m_lock);
+    for (size_t i = 0; i < CAPACITY; ++i) {
+        if (m_entries[i].used && n-- == 0) {
+            *node = m_entries[i].node;
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&m_lock);
+
+    return found;
+}
+
+void NodeTable::ForEach(const std::function<void(const Node&)>& fn) const
+{
+    Node node;
+    for (size_t i = 0; i < CAPACITY; ++i) {
+        taskENTER_CRITICAL(&m_lock);
+        const bool used = m_entries[i].used;
+        if (used) {
+            node = m_entries[i].node;
+        }
+        taskEXIT_CRITICAL(&m_lock);
+
+        if (used) {
+            fn(node);
+        }
+    }
+}
+
+uint16_t NodeTable::find(std::string_view id, uint32_t hash, size_t* pos) const
+{
+    // Table is never more than half full, an empty slot ends every probe
+    for (size_t i = hash & (TABLE_SIZE - 1); ; i = (i + 1) & (TABLE_SIZE - 1)) {
+        const uint16_t index = m_table[i];
+        if (index == NONE) {
+            *pos = i;
+            return NONE;
+        }
+        const Entry& e = m_entries[index];
+        if (e.hash == hash && id == e.node.id) {
+            *pos = i;
+            return index;
+        }
+    }
+}
+
+uint16_t NodeTable::allocate()
+{
+    if (m_count == CAPACITY) {
+        const uint16_t victim = m_lru_tail;
+        remove(victim);
+        ++m_evicted;
+        return victim;
+    }
+
+    for (uint16_t i = 0; i < CAPACITY; ++i) {
+        if (!m_entries[i].used)
+            return i;
+    }
+    return NONE;    // Unreachable, m_count < CAPACITY
+}
+
+void NodeTable::remove(uint16_t index)
+{
+    Entry& e = m_entries[index];
+    size_t pos;
+    find(e.node.id, e.hash, &pos);
+
+    // Backward-shift deletion: pull following entries of the cluster into the hole
+    // unless that would move them before their home slot
+    size_t hole = pos;
+    for (size_t i = (hole + 1) & (TABLE_SIZE - 1); m_table[i] != NONE; i = (i + 1) & (TABLE_SIZE - 1)) {
+        const size_t home = m_entries[m_table[i]].hash & (TABLE_SIZE - 1);
+        if (((i - home) & (TABLE_SIZE - 1)) >= ((i - hole) & (TABLE_SIZE - 1))) {
+            m_table[hole] = m_table[i];
+            hole = i;
+        }
+    }
+    m_table[hole] = NONE;
+
+    unlink(index);
+    e.used = false;
+    --m_count;
+}
+
+void NodeTable::unlink(uint16_t index)
+{
+    Entry& e = m_entries[index];
+    if (e.prev != NONE)
+        m_entries[e.prev].next = e.next;
+    else
+        m_lru_head = e.next;
+    if (e.next != NONE)
+        m_entries[e.next].prev = e.prev;
+    else
+        m_lru_tail = e.prev;
+    e.prev = e.next = NONE;
+}
+
+void NodeTable::push_front(uint16_t index)
+{
+    Entry& e = m_entries[index];
+    e.prev = NONE;
+    e.next = m_lru_head;
+    if (m_lru_head != NONE)
+        m_entries[m_lru_head].prev = index;
+    m_lru_head = index;
+    if (m_lru_tail == NONE)
+        m_lru_tail = index;
+}
+
+/* static */ uint32_t NodeTable::hash(std::string_view id)
+{
+    // FNV-1a, then a final mix: table indexes come from the low bits
+    uint32_t h = 2166136261u;
+    for (uint8_t ch : id) {
+        h = (h ^ ch) * 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
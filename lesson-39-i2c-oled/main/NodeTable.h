@@ -0,0 +1,80 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// Latest metrics of many remote nodes within a fixed memory budget. Nodes are kept in
+// a pool of CAPACITY entries, found through an open-addressing table (linear probing,
+// backward-shift deletion, so no tombstones) keyed by node ID, and linked into an LRU
+// list: when the pool is full, the node that has been silent longest is evicted.
+// Pool entries don't move, which gives paging through the nodes a stable order.
+class NodeTable
+{
+public:
+    static constexpr size_t CAPACITY = CONFIG_REMOTE_NODES_MAX;
+    static constexpr size_t MAX_ID = 23;
+    static constexpr int METRICS = 3;           // Temperature, pressure, humidity
+
+    enum Source : uint8_t {
+        SOURCE_UPSTREAM,                        // Subscription on the upstream broker
+        SOURCE_LOCAL,                           // Client of the local broker
+    };
+
+    struct Node {
+        char id[MAX_ID + 1];                    // Zero terminated
+        float values[METRICS];                  // NaN until received
+        int64_t updated_us;
+        uint32_t updates;
+        Source source;                          // Where the latest update came from
+    };
+
+    NodeTable();
+
+    // Longer IDs keep their tail. Returns false for an invalid metric.
+    bool Update(std::string_view id, int metric, float value, int64_t now_us, Source source);
+
+    // n-th node in pool order, false when n >= Count()
+    bool Get(size_t n, Node* node) const;
+
+    // Copy of every node in pool order, one pass instead of a Get() scan per node. Each
+    // entry is copied under the lock on its own, so updates go on in between, and fn runs
+    // without the lock.
+    void ForEach(const std::function<void(const Node&)>& fn) const;
+
+    size_t Count() const { return m_count; }
+    uint32_t Evicted() const { return m_evicted; }
+
+private:
+    static constexpr size_t TABLE_SIZE = std::bit_ceil(2 * CAPACITY);     // Load factor <= 0.5
+    static constexpr uint16_t NONE = 0xFFFF;
+    static_assert(CAPACITY < NONE);
+
+    struct Entry {
+        Node node;
+        uint32_t hash;
+        uint16_t prev;                          // LRU list, towards most recent
+        uint16_t next;                          // Towards least recent
+        bool used;
+    };
+
+    Entry m_entries[CAPACITY] = {};
+    uint16_t m_table[TABLE_SIZE];
+    uint16_t m_lru_head = NONE;                 // Most recently updated
+    uint16_t m_lru_tail = NONE;                 // Eviction candidate
+    size_t m_count = 0;
+    uint32_t m_evicted = 0;
+    mutable portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+    uint16_t find(std::string_view id, uint32_t hash, size_t* pos) const;
+    uint16_t allocate();
+    void remove(uint16_t index);
+    void unlink(uint16_t index);
+    void push_front(uint16_t index);
+
+    static uint32_t hash(std::string_view id);
+};
@@ -0,0 +1,264 @@
+#include "OledFramebuffer.h"
+
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "common.h"
+
+// Font table is defined by the ssd1306 component (font8x8_basic.h), we borrow its glyphs
+extern "C" uint8_t font8x8_basic_tr[128][8];
+
+// Bytes spent on every I2C image transfer besides the payload itself: slave address,
+// control bytes and the column/page range commands. A clean gap shorter than that
+// is cheaper to resend than to start a new transfer for.
+constexpr const int TRANSFER_OVERHEAD = 10;
+
+constexpr const int64_t RATE_WINDOW_US = 1000 * 1000LL;     // 1 s
+
+OledFramebuffer::OledFramebuffer(SSD1306_t* dev, I2cBus* bus)
+    : m_dev(dev)
+    , m_bus(bus)
+{
+    m_bus_device = m_bus->AddDevice("ssd1306");
+}
+
+void OledFramebuffer::DrawText(int page, const char* text, int len, bool invert)
+{
+    if (!m_glyphs_ready || m_glyphs_flip != m_dev->_flip) {
+        build_glyphs();
+    }
+
+    len = std::min(len, CHARS_PER_LINE);
+
+    bool eol = false;
+    for (int i = 0; i < len; ++i) {
+        // Past the end of the string draw blanks, so the rest of the line is cleared
+        eol = eol || !text[i];
+
+        const uint8_t* glyph = m_glyphs[eol ? ' ' : (uint8_t) text[i] & 0x7F];
+        if (invert) {
+            uint8_t inverted[GLYPH_WIDTH];
+            for (int x = 0; x < GLYPH_WIDTH; ++x) {
+                inverted[x] = ~glyph[x];
+            }
+            DrawImage(page, i * GLYPH_WIDTH, inverted, GLYPH_WIDTH);
+        }
+        else {
+            DrawImage(page, i * GLYPH_WIDTH, glyph, GLYPH_WIDTH);
+        }
+    }
+}
+
+void OledFramebuffer::DrawBigChar(int page, int col, char ch, int scale)
+{
+    scale = std::clamp(scale, 1, MAX_SCALE);
+    if (m_big_scale != scale || m_big_flip != m_dev->_flip) {
+        build_big_glyphs(scale);
+    }
+
+    const int width = scale * GLYPH_WIDTH;
+    static constexpr uint8_t BLANK[MAX_SCALE * GLYPH_WIDTH] = {};
+
+    const uint8_t* glyph = nullptr;
+    if (ch >= '0' && ch <= '9')
+        glyph = m_big_glyphs[ch - '0'];
+    else if (ch == ':')
+        glyph = m_big_glyphs[10];
+
+    for (int p = 0; p < scale; ++p) {
+        DrawImage(page + p, col, glyph ? glyph + p * width : BLANK, width);
+    }
+}
+
+void OledFramebuffer::DrawImage(int page, int col, const uint8_t* data, int width)
+{
+    if (page < 0 || page >= PAGES)
+        return;
+
+    for (int i = 0; i < width && col + i < WIDTH; ++i) {
+        put(page, col + i, data[i]);
+    }
+}
+
+void OledFramebuffer::DrawColumn(int page, int col, uint8_t seg)
+{
+    if (page < 0 || page >= PAGES || col < 0 || col >= WIDTH)
+        return;
+
+    if (m_dev->_flip)
+        ssd1306_flip(&seg, 1);
+    put(page, col, seg);
+}
+
+void OledFramebuffer::ScrollLeft(int page, int col, int width, int shift)
+{
+    if (page < 0 || page >= PAGES || col < 0)
+        return;
+
+    const int end = std::min(col + width, WIDTH);
+    for (int i = col; i + shift < end; ++i) {
+        put(page, i, m_frame[page][i + shift]);
+    }
+}
+
+void OledFramebuffer::CopyPage(int dst, int src)
+{
+    if (dst < 0 || dst >= PAGES || src < 0 || src >= PAGES || dst == src)
+        return;
+
+    for (int col = 0; col < WIDTH; ++col) {
+        put(dst, col, m_frame[src][col]);
+    }
+}
+
+void OledFramebuffer::ClearPage(int page)
+{
+    if (page < 0 || page >= PAGES)
+        return;
+
+    for (int col = 0; col < WIDTH; ++col) {
+        put(page, col, 0);
+    }
+}
+
+void OledFramebuffer::Clear()
+{
+    for (int page = 0; page < PAGES; ++page) {
+        ClearPage(page);
+    }
+}
+
+size_t OledFramebuffer::Flush()
+{
+    size_t sent = 0;
+    const int pages = std::min(m_dev->_pages, PAGES);
+
+    for (int page = 0; page < pages && m_dirty_pages; ++page) {
+        if (!(m_dirty_pages & (1 << page)))
+            continue;
+
+        int col = next_dirty(page, 0);
+        while (col < WIDTH) {
+            // Grow the run over short clean gaps, see TRANSFER_OVERHEAD
+            int end = col + 1;
+            for (int next = next_dirty(page, end); next < WIDTH && next - end <= TRANSFER_OVERHEAD; next = next_dirty(page, end)) {
+                end = next + 1;
+            }
+
+            send(page, col, end - col);
+            sent += end - col + (end - col + CHUNK_SIZE - 1) / CHUNK_SIZE * TRANSFER_OVERHEAD;
+
+            col = next_dirty(page, end);
+        }
+
+        std::memset(m_dirty[page], 0, sizeof(m_dirty[page]));
+        m_dirty_pages &= ~(1 << page);
+    }
+
+    account(sent);
+    return sent;
+}
+
+void OledFramebuffer::build_glyphs()
+{
+    for (int ch = 0; ch < GLYPHS; ++ch) {
+        std::memcpy(m_glyphs[ch], font8x8_basic_tr[ch], GLYPH_WIDTH);
+        if (m_dev->_flip)
+            ssd1306_flip(m_glyphs[ch], GLYPH_WIDTH);
+    }
+
+    m_glyphs_flip = m_dev->_flip;
+    m_glyphs_ready = true;
+}
+
+void OledFramebuffer::build_big_glyphs(int scale)
+{
+    static constexpr char CHARS[BIG_GLYPHS + 1] = "0123456789:";
+
+    const int width = scale * GLYPH_WIDTH;
+    const bool flip = m_dev->_flip;
+
+    for (int g = 0; g < BIG_GLYPHS; ++g) {
+        const uint8_t* src = font8x8_basic_tr[(uint8_t) CHARS[g]];
+        uint8_t* dst = m_big_glyphs[g];
+
+        // Every source pixel becomes a scale x scale block. Source columns are bytes
+        // with the top row in bit 0, output row y lands in page y / 8, bit y % 8.
+        for (int p = 0; p < scale; ++p) {
+            for (int x = 0; x < width; ++x) {
+                uint8_t seg = 0;
+                for (int bit = 0; bit < 8; ++bit) {
+                    if (src[x / scale] & (1 << ((p * 8 + bit) / scale)))
+                        seg |= 1 << bit;
+                }
+                dst[p * width + x] = seg;
+            }
+        }
+
+        // Upside-down panel: flip every byte, send() reverses the page order
+        if (flip) {
+            ssd1306_flip(dst, scale * width);
+        }
+    }
+
+    m_big_scale = scale;
+    m_big_flip = flip;
+}
+
+void OledFramebuffer::put(int page, int col, uint8_t seg)
+{
+    if (m_frame[page][col] == seg)
+        return;
+
+    m_frame[page][col] = seg;
+    m_dirty[page][col / WORD_BITS] |= 1u << (col % WORD_BITS);
+    m_dirty_pages |= 1 << page;
+}
+
+void OledFramebuffer::send(int page, int col, int width)
+{
+    // Upside-down panel: the frame's top page is the panel's bottom one. Bytes are flipped
+    // when drawn, the page order only here, the one place frames reach the bus.
+    const int target = m_dev->_flip ? m_dev->_pages - 1 - page : page;
+
+    // Display has the lowest bus priority, a sensor read waits for one chunk at most
+    for (int offset = 0; offset < width; offset += CHUNK_SIZE) {
+        const int chunk = std::min(CHUNK_SIZE, width - offset);
+        m_bus->Execute(m_bus_device, I2cBus::PRIO_DISPLAY, 0, [&] {
+            i2c_display_image(m_dev, target, col + offset, &m_frame[page][col + offset], chunk);
+            return ESP_OK;
+        });
+    }
+}
+
+int OledFramebuffer::next_dirty(int page, int col) const
+{
+    while (col < WIDTH) {
+        uint32_t word = m_dirty[page][col / WORD_BITS] >> (col % WORD_BITS);
+        if (word)
+            return col + __builtin_ctz(word);
+        col = (col / WORD_BITS + 1) * WORD_BITS;
+    }
+    return WIDTH;
+}
+
+void OledFramebuffer::account(size_t bytes)
+{
+    int64_t now = esp_timer_get_time();
+
+    m_bytes_total += bytes;
+    m_window_bytes += bytes;
+
+    if (!m_window_start) {
+        m_window_start = now;
+    }
+    else if (int64_t elapsed = now - m_window_start; elapsed >= RATE_WINDOW_US) {
+        m_bytes_per_sec = m_window_bytes * RATE_WINDOW_US / elapsed;
+        m_window_bytes = 0;
+        m_window_start = now;
+        ESP_LOGD(TAG, "OLED I2C traffic: %lu B/s", (unsigned long) m_bytes_per_sec);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <ssd1306.h>
+
+#include "I2cBus.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Shadow copy of SSD1306 display memory. Drawing only touches RAM and marks columns
+// whose bytes actually changed; Flush() then sends just the dirty column runs over I2C,
+// in chunks of at most CHUNK_SIZE bytes so more urgent bus traffic can go in between.
+// Text is drawn from a glyph atlas prepared once for the panel orientation, digits
+// also in 2x/3x scaled versions spanning several pages.
+class OledFramebuffer
+{
+public:
+    static constexpr int WIDTH = 128;
+    static constexpr int PAGES = 8;
+    static constexpr int GLYPH_WIDTH = 8;
+    static constexpr int CHARS_PER_LINE = WIDTH / GLYPH_WIDTH;
+    static constexpr int CHUNK_SIZE = 32;
+    static constexpr int MAX_SCALE = 3;
+
+    OledFramebuffer(SSD1306_t* dev, I2cBus* bus);
+
+    void DrawText(int page, const char* text, int len = CHARS_PER_LINE, bool invert = false);
+    void DrawImage(int page, int col, const uint8_t* data, int width);
+
+    // Digit or ':' scaled up to scale * GLYPH_WIDTH columns and scale pages starting
+    // at page, any other character draws a blank cell
+    void DrawBigChar(int page, int col, char ch, int scale);
+    // Single column byte, top row in bit 0; flipped for an upside-down panel
+    void DrawColumn(int page, int col, uint8_t seg);
+
+    // Moves columns [col + shift, col + width) to col, the freed columns keep their content
+    void ScrollLeft(int page, int col, int width, int shift = 1);
+    // Copies a whole page, only the columns that differ become dirty
+    void CopyPage(int dst, int src);
+
+    void ClearPage(int page);
+    void Clear();
+
+    size_t Flush();
+
+    bool IsDirty() const { return m_dirty_pages != 0; }
+
+    uint64_t BytesTotal() const { return m_bytes_total; }
+    uint32_t BytesPerSecond() const { return m_bytes_per_sec; }
+
+private:
+    static constexpr int WORD_BITS = 32;
+    static constexpr int DIRTY_WORDS = WIDTH / WORD_BITS;
+    static constexpr int GLYPHS = 128;
+    static constexpr int BIG_GLYPHS = 11;       // "0123456789:"
+    static constexpr int BIG_GLYPH_SIZE = MAX_SCALE * MAX_SCALE * GLYPH_WIDTH;
+
+    SSD1306_t* m_dev = nullptr;
+    I2cBus* m_bus = nullptr;
+    int m_bus_device = -1;
+
+    uint8_t m_frame[PAGES][WIDTH] = {};
+    uint32_t m_dirty[PAGES][DIRTY_WORDS] = {};
+    uint8_t m_dirty_pages = 0;
+
+    uint8_t m_glyphs[GLYPHS][GLYPH_WIDTH] = {};
+    bool m_glyphs_flip = false;
+    bool m_glyphs_ready = false;
+
+    uint8_t m_big_glyphs[BIG_GLYPHS][BIG_GLYPH_SIZE] = {};     // Page after page, scale * GLYPH_WIDTH bytes each
+    int m_big_scale = 0;
+    bool m_big_flip = false;
+
+    uint64_t m_bytes_total = 0;
+    uint32_t m_bytes_per_sec = 0;
+    uint32_t m_window_bytes = 0;
+    int64_t m_window_start = 0;
+
+    void put(int page, int col, uint8_t seg);
+    int next_dirty(int page, int col) const;
+    void send(int page, int col, int width);
+    void build_glyphs();
+    void build_big_glyphs(int scale);
+    void account(size_t bytes);
+};
@@ -0,0 +1,63 @@
+#include "PublishPolicy.h"
+
+#include <algorithm>
+#include <cmath>
+
+PublishPolicy::PublishPolicy(const Config& config)
+    : m_config(config)
+{
+}
+
+bool PublishPolicy::Check(float value, int64_t now_us)
+{
+    if (std::isnan(value))
+        return false;
+
+    // A held value is newer than the last published one
+    const bool has_last = m_has_held || m_has_last;
+    const float last_value = m_has_held ? m_held_value : m_last_value;
+    const int64_t last_time = m_has_held ? m_held_time : m_last_time;
+
+    bool publish = true;
+    if (has_last) {
+        const int64_t elapsed_ms = (now_us - last_time) / 1000;
+        const float band = std::max(m_config.abs_deadband, m_config.rel_deadband * std::fabs(last_value));
+
+        if (elapsed_ms < m_config.min_interval_ms)
+            publish = false;
+        else if (elapsed_ms >= m_config.max_silence_ms)
+            publish = true;
+        else
+            publish = std::fabs(value - last_value) >= band;
+    }
+
+    if (!publish) {
+        ++m_suppressed;
+    }
+    return publish;
+}
+
+void PublishPolicy::Commit(float value, int64_t now_us)
+{
+    Hold(value, now_us);
+    Commit();
+}
+
+void PublishPolicy::Hold(float value, int64_t now_us)
+{
+    m_has_held = true;
+    m_held_value = value;
+    m_held_time = now_us;
+}
+
+void PublishPolicy::Commit()
+{
+    if (!m_has_held)
+        return;
+
+    m_has_held = false;
+    m_has_last = true;
+    m_last_value = m_held_value;
+    m_last_time = m_held_time;
+    ++m_published;
+}
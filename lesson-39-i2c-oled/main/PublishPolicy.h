@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+// Decides whether a new reading of one metric is worth publishing. A value goes out
+// when it moved away from the last published one by more than the deadband (absolute
+// or relative to that value, whichever is larger), or when the metric has been silent
+// for max_silence; never more often than min_interval. Comparing against the last
+// published value rather than the previous reading gives hysteresis: noise around a
+// steady value doesn't produce a stream of updates.
+//
+// Check() only decides, the state changes when the caller reports what happened to the
+// value: Commit() once it went out, or Hold() while it waits in a batch. A held value is
+// what later checks compare against, and Commit() without a value takes the held one as
+// published. A value that failed to go out is never taken, so it is offered again.
+class PublishPolicy
+{
+public:
+    struct Config {
+        float abs_deadband;             // In units of the metric, 0 = off
+        float rel_deadband;             // Fraction of the last published value, 0 = off
+        uint32_t min_interval_ms;
+        uint32_t max_silence_ms;
+    };
+
+    PublishPolicy(const Config& config);
+
+    // Returns true if value should be published now, counts it as suppressed otherwise
+    bool Check(float value, int64_t now_us);
+
+    // value was published at now_us
+    void Commit(float value, int64_t now_us);
+    // value is on its way, e.g. waiting in a batch
+    void Hold(float value, int64_t now_us);
+    // The held value was published, nothing happens without one
+    void Commit();
+
+    const Config& GetConfig() const { return m_config; }
+    void SetConfig(const Config& config) { m_config = config; }
+
+    uint32_t Published() const { return m_published; }
+    uint32_t Suppressed() const { return m_suppressed; }
+
+private:
+    Config m_config;
+
+    bool m_has_last = false;
+    float m_last_value = 0;
+    int64_t m_last_time = 0;
+
+    bool m_has_held = false;
+    float m_held_value = 0;
+    int64_t m_held_time = 0;
+
+    uint32_t m_published = 0;
+    uint32_t m_suppressed = 0;
+};
@@ -0,0 +1,68 @@
+#include "RollingStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+void RollingStats::Add(float value, int64_t time_s)
+{
+    if (std::isnan(value))
+        return;
+
+    if (!m_has_ref) {
+        m_ref = value;
+        m_has_ref = true;
+    }
+    const float d = value - m_ref;
+
+    for (int w = 0; w < WINDOWS; ++w) {
+        const int32_t slice = time_s / (WINDOW_SECONDS[w] / BUCKETS);
+        Bucket& b = m_buckets[w][slice % BUCKETS];
+
+        // Bucket still holds an expired slice, start it over
+        if (b.slice != slice || !b.count) {
+            b = { slice, 0, value, value, 0, 0 };
+        }
+
+        ++b.count;
+        b.min = std::min(b.min, value);
+        b.max = std::max(b.max, value);
+        b.sum += d;
+        b.sum_sq += d * d;
+    }
+}
+
+RollingStats::Result RollingStats::Get(int window, int64_t time_s) const
+{
+    Result result = { 0, NAN, NAN, NAN, NAN };
+    if (window < 0 || window >= WINDOWS)
+        return result;
+
+    const int32_t slice = time_s / (WINDOW_SECONDS[window] / BUCKETS);
+
+    double sum = 0;
+    double sum_sq = 0;
+    for (const Bucket& b : m_buckets[window]) {
+        if (!b.count || b.slice > slice || b.slice <= slice - BUCKETS)
+            continue;
+
+        if (!result.count) {
+            result.min = b.min;
+            result.max = b.max;
+        }
+        else {
+            result.min = std::min(result.min, b.min);
+            result.max = std::max(result.max, b.max);
+        }
+        result.count += b.count;
+        sum += b.sum;
+        sum_sq += b.sum_sq;
+    }
+
+    if (result.count) {
+        const double mean = sum / result.count;
+        const double var = std::max(0.0, sum_sq / result.count - mean * mean);
+        result.mean = m_ref + mean;
+        result.stddev = std::sqrt(var);
+    }
+    return result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// Min/max/mean/standard deviation of one metric over the last 1 min, 5 min and 1 h.
+// Every window is a ring of BUCKETS time buckets, each holding the aggregates of its
+// slice of time, so adding a sample is O(1) and memory is fixed no matter the sample
+// rate. A window result merges its buckets that are still inside the window; it
+// covers the last BUCKETS - 1 full slices plus the current partial one.
+// Sums are kept relative to the first value seen, which keeps float precision where
+// the readings vary (pressure in Pa would otherwise lose it to the large mean).
+class RollingStats
+{
+public:
+    static constexpr int WINDOWS = 3;
+    static constexpr int BUCKETS = 60;
+    static constexpr uint32_t WINDOW_SECONDS[WINDOWS] = { 60, 5 * 60, 60 * 60 };
+    static constexpr const char* WINDOW_NAMES[WINDOWS] = { "1m", "5m", "1h" };
+
+    struct Result {
+        uint32_t count;
+        float min;
+        float max;
+        float mean;
+        float stddev;
+    };
+
+    RollingStats() = default;
+
+    void Add(float value, int64_t time_s);
+    Result Get(int window, int64_t time_s) const;
+
+private:
+    struct Bucket {
+        int32_t slice;          // Time slice the bucket holds, time_s / slice width
+        uint32_t count;
+        float min;
+        float max;
+        float sum;              // Of (value - m_ref)
+        float sum_sq;
+    };
+
+    Bucket m_buckets[WINDOWS][BUCKETS] = {};
+    float m_ref = 0;
+    bool m_has_ref = false;
+};
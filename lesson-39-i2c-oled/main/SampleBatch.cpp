@@ -0,0 +1,69 @@
+#include "SampleBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+static uint8_t* put_le16(uint8_t* p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+static uint8_t* put_le32(uint8_t* p, uint32_t value)
+{
+    p = put_le16(p, value);
+    return put_le16(p, value >> 16);
+}
+
+SampleBatch::SampleBatch(int capacity)
+    : m_capacity(std::clamp(capacity, 1, MAX_SAMPLES))
+{
+    Clear();
+}
+
+bool SampleBatch::Add(const SensorSampler::Sample& sample)
+{
+    if (m_count >= m_capacity)
+        return true;
+
+    uint8_t flags = 0;
+    int16_t temp = 0;
+    uint16_t pres = 0;
+    uint16_t humi = 0;
+
+    // Same fixed-point scales as the offline buffer in AT24C32
+    if (!std::isnan(sample.temp)) {
+        temp = std::lround(std::clamp(sample.temp * 100.f, -32768.f, 32767.f));
+        flags |= FLAG_TEMP;
+    }
+    if (!std::isnan(sample.pres)) {
+        pres = std::lround(std::clamp(sample.pres / 10.f, 0.f, 65535.f));
+        flags |= FLAG_PRES;
+    }
+    if (!std::isnan(sample.humi)) {
+        humi = std::lround(std::clamp(sample.humi * 100.f, 0.f, 65535.f));
+        flags |= FLAG_HUMI;
+    }
+
+    uint8_t* p = m_buffer + HEADER_SIZE + m_count * RECORD_SIZE;
+    p = put_le32(p, sample.seq);
+    p = put_le32(p, static_cast<uint32_t>(sample.time));
+    p = put_le16(p, static_cast<uint16_t>(temp));
+    p = put_le16(p, pres);
+    p = put_le16(p, humi);
+    *p++ = flags;
+    *p = 0;
+
+    m_buffer[1] = ++m_count;
+    return m_count >= m_capacity;
+}
+
+void SampleBatch::Clear()
+{
+    m_count = 0;
+    m_buffer[0] = PAYLOAD_VERSION;
+    m_buffer[1] = 0;
+    m_buffer[2] = RECORD_SIZE;
+    m_buffer[3] = 0;
+}
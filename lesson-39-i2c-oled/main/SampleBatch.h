@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SensorSampler.h"
+
+// Packs several samples into one fixed-layout binary MQTT payload. All fields are
+// little-endian.
+//
+//   Header, 4 bytes:
+//     u8  version          PAYLOAD_VERSION
+//     u8  count            number of records
+//     u8  record_size      RECORD_SIZE, lets older decoders skip fields added later
+//     u8  reserved
+//   Record, RECORD_SIZE bytes each:
+//     u32 seq              sampler sequence number, gaps = samples not sent
+//     u32 time             UTC, seconds since epoch
+//     i16 temp             0.01 C
+//     u16 pres             0.1 hPa
+//     u16 humi             0.01 %
+//     u8  flags            bit 0..2: temp/pres/humi present
+//     u8  reserved
+class SampleBatch
+{
+public:
+    static constexpr uint8_t PAYLOAD_VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t RECORD_SIZE = 16;
+    static constexpr int MAX_SAMPLES = 32;
+
+    static constexpr uint8_t FLAG_TEMP = 0x01;
+    static constexpr uint8_t FLAG_PRES = 0x02;
+    static constexpr uint8_t FLAG_HUMI = 0x04;
+
+    SampleBatch(int capacity);
+
+    // Returns true when the batch is full and should be sent, a full batch takes no more
+    bool Add(const SensorSampler::Sample& sample);
+    void Clear();
+
+    bool Full() const { return m_count >= m_capacity; }
+
+    const uint8_t* Data() const { return m_buffer; }
+    size_t Size() const { return HEADER_SIZE + m_count * RECORD_SIZE; }
+    int Count() const { return m_count; }
+
+private:
+    int m_capacity;
+    int m_count = 0;
+    uint8_t m_buffer[HEADER_SIZE + MAX_SAMPLES * RECORD_SIZE] = {};
+};
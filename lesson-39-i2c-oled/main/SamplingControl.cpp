@@ -0,0 +1,197 @@
+#include "SamplingControl.h"
+
+#include <nvs.h>
+#include <esp_log.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "common.h"
+
+constexpr const char* NVS_NAMESPACE = "sampling";
+constexpr const char* NVS_KEY = "settings";
+
+// A change that would be published counts as activity
+constexpr const float TEMP_STEP = CONFIG_PUBLISH_DEADBAND_TEMP / 100.f;      // C
+constexpr const float PRES_STEP = CONFIG_PUBLISH_DEADBAND_PRES;              // Pa
+constexpr const float HUMI_STEP = CONFIG_PUBLISH_DEADBAND_HUMI / 100.f;      // %
+
+const SamplingControl::Settings SamplingControl::DEFAULTS = {
+    .period_ms = CONFIG_SENSOR_SAMPLE_PERIOD_MS,
+    .slow_period_ms = CONFIG_SENSOR_SLOW_PERIOD_MS,
+    .calm_s = CONFIG_SENSOR_CALM_TIME_S,
+    .min_interval_ms = CONFIG_PUBLISH_MIN_INTERVAL_MS,
+    .max_silence_s = CONFIG_PUBLISH_MAX_SILENCE_S,
+    .profile = SensorSampler::DEFAULT_PROFILE,
+};
+
+esp_err_t SamplingControl::Load()
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+        return err;         // Nothing stored yet
+
+    Settings settings;
+    size_t size = sizeof(settings);
+    err = nvs_get_blob(handle, NVS_KEY, &settings, &size);
+    nvs_close(handle);
+
+    if (err == ESP_OK && (size != sizeof(settings) || !is_valid(settings)))
+        err = ESP_ERR_INVALID_SIZE;
+    if (err == ESP_OK) {
+        set(settings);
+    }
+    return err;
+}
+
+esp_err_t SamplingControl::Save()
+{
+    const Settings settings = Get();
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+        return err;
+
+    err = nvs_set_blob(handle, NVS_KEY, &settings, sizeof(settings));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+bool SamplingControl::Parse(const char* text, size_t len)
+{
+    char buf[128];
+    if (len >= sizeof(buf))
+        return false;
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+
+    Settings settings = Get();
+    char* save = nullptr;
+    for (char* token = strtok_r(buf, " ,;\r\n", &save); token; token = strtok_r(nullptr, " ,;\r\n", &save)) {
+        char* value = strchr(token, '=');
+        if (!value || !value[1])
+            return false;
+        *value++ = '\0';
+
+        char* end = nullptr;
+        uint32_t number = strtoul(value, &end, 10);
+        const bool is_number = *end == '\0';
+
+        if (!strcmp(token, "profile") && !is_number) {
+            number = SensorSampler::PROFILE_COUNT;
+            for (int i = 0; i < SensorSampler::PROFILE_COUNT; ++i) {
+                if (!strcmp(value, SensorSampler::PROFILE_NAMES[i])) {
+                    number = i;
+                }
+            }
+            settings.profile = number;
+            continue;
+        }
+
+        if (!is_number)
+            return false;
+
+        if (!strcmp(token, "period"))
+            settings.period_ms = number;
+        else if (!strcmp(token, "slow"))
+            settings.slow_period_ms = number;
+        else if (!strcmp(token, "calm"))
+            settings.calm_s = number;
+        else if (!strcmp(token, "profile"))
+            settings.profile = number;
+        else if (!strcmp(token, "min_interval"))
+            settings.min_interval_ms = number;
+        else if (!strcmp(token, "max_silence"))
+            settings.max_silence_s = number;
+        else
+            return false;
+    }
+
+    if (!is_valid(settings))
+        return false;
+
+    set(settings);
+    return true;
+}
+
+int SamplingControl::Format(char* buf, size_t size) const
+{
+    const Settings settings = Get();
+    return snprintf(buf, size, "period=%lu slow=%lu calm=%lu profile=%s min_interval=%lu max_silence=%lu",
+        (unsigned long) settings.period_ms,
+        (unsigned long) settings.slow_period_ms,
+        (unsigned long) settings.calm_s,
+        SensorSampler::PROFILE_NAMES[settings.profile],
+        (unsigned long) settings.min_interval_ms,
+        (unsigned long) settings.max_silence_s);
+}
+
+SamplingControl::Settings SamplingControl::Get() const
+{
+    taskENTER_CRITICAL(&m_lock);
+    const Settings settings = m_settings;
+    taskEXIT_CRITICAL(&m_lock);
+    return settings;
+}
+
+uint32_t SamplingControl::Adapt(const SensorSampler::Sample& sample)
+{
+    const Settings settings = Get();
+    if (!settings.slow_period_ms || settings.slow_period_ms <= settings.period_ms) {
+        m_slow = false;
+        return settings.period_ms;
+    }
+
+    // Failed readings say nothing about the environment, keep the current mode
+    if (sample.valid) {
+        // NaN humidity of a BMP280 never counts as a change
+        const bool moved = !m_has_ref
+            || std::fabs(sample.temp - m_ref_temp) > TEMP_STEP
+            || std::fabs(sample.pres - m_ref_pres) > PRES_STEP
+            || std::fabs(sample.humi - m_ref_humi) > HUMI_STEP;
+
+        if (moved) {
+            m_has_ref = true;
+            m_ref_temp = sample.temp;
+            m_ref_pres = sample.pres;
+            m_ref_humi = sample.humi;
+            m_active_us = sample.mono_us;
+        }
+
+        const bool slow = sample.mono_us - m_active_us >= settings.calm_s * 1000000LL;
+        if (slow != m_slow) {
+            m_slow = slow;
+            ESP_LOGI(TAG, "Sampling: %s mode, every %lu ms", slow ? "slow" : "fast",
+                (unsigned long) (slow ? settings.slow_period_ms : settings.period_ms));
+        }
+    }
+
+    return m_slow ? settings.slow_period_ms : settings.period_ms;
+}
+
+void SamplingControl::set(const Settings& settings)
+{
+    taskENTER_CRITICAL(&m_lock);
+    m_settings = settings;
+    taskEXIT_CRITICAL(&m_lock);
+
+    m_changed = true;
+}
+
+/* static */ bool SamplingControl::is_valid(const Settings& settings)
+{
+    // Same limits as the Kconfig options
+    return settings.period_ms >= 100 && settings.period_ms <= 3600000
+        && (settings.slow_period_ms == 0 || (settings.slow_period_ms >= settings.period_ms && settings.slow_period_ms <= 3600000))
+        && settings.calm_s >= 1 && settings.calm_s <= 86400
+        && settings.min_interval_ms <= 3600000
+        && settings.max_silence_s >= 1 && settings.max_silence_s <= 86400
+        && settings.profile < SensorSampler::PROFILE_COUNT;
+}
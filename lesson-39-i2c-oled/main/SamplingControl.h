@@ -0,0 +1,67 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <esp_err.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "SensorSampler.h"
+
+// Runtime sampling settings: changed by "key=value" commands (e.g. from MQTT), persisted
+// to NVS and applied by the sampler task. Also drives the automatic slow/fast mode:
+// while no metric moves by more than its publish deadband for calm_s, samples are taken
+// at slow_period_ms; the first sample that does move switches back to period_ms.
+//
+// Keys: period, slow (0 = always fast), calm, profile (name or index), min_interval, max_silence
+class SamplingControl
+{
+public:
+    struct Settings {
+        uint32_t period_ms;             // Normal (fast) sampling period
+        uint32_t slow_period_ms;        // Period while readings are steady, 0 = off
+        uint32_t calm_s;                // Steady time before slowing down
+        uint32_t min_interval_ms;       // Publish policy of every metric
+        uint32_t max_silence_s;
+        uint32_t profile;               // SensorSampler::ProfileId
+    };
+
+    static const Settings DEFAULTS;
+
+    SamplingControl() = default;
+
+    // NVS must be initialized, missing or invalid stored settings keep the defaults
+    esp_err_t Load();
+    esp_err_t Save();
+
+    // All or nothing: on an unknown key or a value out of range nothing changes
+    bool Parse(const char* text, size_t len);
+    int Format(char* buf, size_t size) const;
+
+    Settings Get() const;
+
+    // True once after the settings changed (Load, Parse)
+    bool TakeChanged() { return m_changed.exchange(false); }
+
+    // Feed every sample, returns the period to sample at
+    uint32_t Adapt(const SensorSampler::Sample& sample);
+
+    bool IsSlow() const { return m_slow; }
+
+private:
+    Settings m_settings = DEFAULTS;
+    std::atomic<bool> m_changed = false;
+    mutable portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+    // Reference readings of the slow/fast decision, sampler task only
+    bool m_has_ref = false;
+    float m_ref_temp = 0;
+    float m_ref_pres = 0;
+    float m_ref_humi = 0;
+    int64_t m_active_us = 0;
+    bool m_slow = false;
+
+    void set(const Settings& settings);
+    static bool is_valid(const Settings& settings);
+};
@@ -0,0 +1,206 @@
+#include "SensorSampler.h"
+
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#include <cmath>
+
+#include "common.h"
+
+// Oversampling/filter presets recommended by the BMP280/BME280 datasheets
+const SensorSampler::Profile SensorSampler::PROFILES[PROFILE_COUNT] = {
+    { BMP280_ULTRA_LOW_POWER, BMP280_ULTRA_LOW_POWER, BMP280_ULTRA_LOW_POWER, BMP280_FILTER_OFF },
+    { BMP280_LOW_POWER, BMP280_ULTRA_HIGH_RES, BMP280_ULTRA_LOW_POWER, BMP280_FILTER_16 },
+    { BMP280_ULTRA_LOW_POWER, BMP280_STANDARD, BMP280_ULTRA_LOW_POWER, BMP280_FILTER_4 },
+};
+
+const char* const SensorSampler::PROFILE_NAMES[PROFILE_COUNT] = {
+    "weather",
+    "indoor",
+    "standard",
+};
+
+#if CONFIG_BMP280_PROFILE_INDOOR
+const SensorSampler::ProfileId SensorSampler::DEFAULT_PROFILE = PROFILE_INDOOR;
+#elif CONFIG_BMP280_PROFILE_STANDARD
+const SensorSampler::ProfileId SensorSampler::DEFAULT_PROFILE = PROFILE_STANDARD;
+#else // CONFIG_BMP280_PROFILE_WEATHER
+const SensorSampler::ProfileId SensorSampler::DEFAULT_PROFILE = PROFILE_WEATHER;
+#endif
+
+// How many times the status register is polled when the conversion runs longer than computed
+constexpr const int MAX_BUSY_POLLS = 5;
+
+static uint32_t oversampling_factor(BMP280_Oversampling os)
+{
+    return os == BMP280_SKIPPED ? 0 : 1 << (os - 1);
+}
+
+SensorSampler::SensorSampler(I2cBus* bus, callback_t callback)
+    : m_bus(bus)
+    , m_callback(callback)
+{
+    m_bus_device = m_bus->AddDevice("bmp280");
+}
+
+SensorSampler::~SensorSampler()
+{
+    Stop();
+}
+
+esp_err_t SensorSampler::Init(uint8_t addr, i2c_port_t port, gpio_num_t sda, gpio_num_t scl, ProfileId profile)
+{
+    bmp280_params_t params = make_params(PROFILES[profile]);
+
+    esp_err_t err = bmp280_init_desc(&m_dev, addr, port, sda, scl);
+    if (err == ESP_OK) {
+        err = bmp280_init(&m_dev, &params);
+    }
+    if (err == ESP_OK) {
+        m_profile = PROFILES[profile];
+        m_profile_id = profile;
+    }
+    return err;
+}
+
+esp_err_t SensorSampler::SetProfile(ProfileId profile)
+{
+    if (profile < 0 || profile >= PROFILE_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if (profile == m_profile_id)
+        return ESP_OK;
+
+    // Re-initialization writes the new oversampling and filter settings to the sensor
+    bmp280_params_t params = make_params(PROFILES[profile]);
+    esp_err_t err = m_bus->Execute(m_bus_device, I2cBus::PRIO_SENSOR, 0, [&] { return bmp280_init(&m_dev, &params); });
+    if (err == ESP_OK) {
+        m_profile = PROFILES[profile];
+        m_profile_id = profile;
+    }
+    return err;
+}
+
+void SensorSampler::Wake()
+{
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+}
+
+void SensorSampler::Start(uint32_t period_ms)
+{
+    m_period_ms = period_ms;
+    m_stop_task = false;
+
+    xTaskCreatePinnedToCore(
+        member_cast<TaskFunction_t>(&SensorSampler::sampler_task),
+        "sampler_task",
+        4096,
+        this,
+        6,                      // Above display task, so UI load can't delay sampling
+        &m_task,
+        xPortGetCoreID()
+    );
+}
+
+void SensorSampler::Stop()
+{
+    if (!m_task)
+        return;
+
+    m_stop_task = true;
+    Wake();
+    while (m_task) {
+        vTaskDelay(1);
+    }
+}
+
+uint32_t SensorSampler::ConversionTimeUs() const
+{
+    // Maximum measurement time from the datasheet (BMP280 3.8.1, BME280 9.1)
+    uint32_t t_us = 1250 + 2300 * oversampling_factor(m_profile.temp);
+    if (m_profile.pres != BMP280_SKIPPED)
+        t_us += 2300 * oversampling_factor(m_profile.pres) + 575;
+    if (m_dev.id == BME280_CHIP_ID && m_profile.humi != BMP280_SKIPPED)
+        t_us += 2300 * oversampling_factor(m_profile.humi) + 575;
+    return t_us;
+}
+
+void SensorSampler::sampler_task()
+{
+    TickType_t next_wake = xTaskGetTickCount();
+    bool timed_out = false;
+
+    while (!m_stop_task) {
+        m_loop.Begin(timed_out);
+        Sample sample = {};
+        sample.valid = acquire(&sample);
+        m_callback(sample);
+
+        // Fixed cadence: next cycle is scheduled from the previous wake time, not from now.
+        // An overrun starts a new cadence instead of catching up with a burst of samples.
+        next_wake += pdMS_TO_TICKS(m_period_ms);
+        const TickType_t now = xTaskGetTickCount();
+        const int32_t wait = static_cast<int32_t>(next_wake - now);
+        m_loop.End(wait > 0 ? wait : 0);
+        timed_out = wait > 0 && !ulTaskNotifyTake(pdTRUE, wait);
+        if (!timed_out) {
+            next_wake = xTaskGetTickCount();
+        }
+    }
+
+    bmp280_free_desc(&m_dev);
+
+    m_task = nullptr;
+    vTaskDelete(nullptr);
+}
+
+/* static */ bmp280_params_t SensorSampler::make_params(const Profile& profile)
+{
+    bmp280_params_t params = {};
+    ESP_ERROR_CHECK(bmp280_init_default_params(&params));
+
+    // Sensor sleeps between conversions, each one is triggered explicitly
+    params.mode = BMP280_MODE_FORCED;
+    params.oversampling_temperature = profile.temp;
+    params.oversampling_pressure = profile.pres;
+    params.oversampling_humidity = profile.humi;
+    params.filter = profile.filter;
+    return params;
+}
+
+bool SensorSampler::acquire(Sample* sample)
+{
+    sample->seq = m_seq++;
+    sample->mono_us = esp_timer_get_time();
+    sample->time = std::time(nullptr);
+    sample->temp = NAN;
+    sample->pres = NAN;
+    sample->humi = NAN;
+
+    // A reading that can't start within one period is stale, let it fail instead
+    const uint32_t deadline_us = m_period_ms * 1000;
+
+    if (m_bus->Execute(m_bus_device, I2cBus::PRIO_SENSOR, deadline_us, [this] { return bmp280_force_measurement(&m_dev); }) != ESP_OK)
+        return false;
+
+    // Round conversion time up to whole ticks
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    vTaskDelay((ConversionTimeUs() + tick_us - 1) / tick_us);
+
+    bool busy = true;
+    for (int i = 0; i < MAX_BUSY_POLLS; ++i) {
+        if (m_bus->Execute(m_bus_device, I2cBus::PRIO_SENSOR, deadline_us, [&] { return bmp280_is_measuring(&m_dev, &busy); }) != ESP_OK)
+            return false;
+        if (!busy)
+            break;
+        vTaskDelay(1);
+    }
+    if (busy)
+        return false;
+
+    return m_bus->Execute(m_bus_device, I2cBus::PRIO_SENSOR, deadline_us, [&] {
+        return bmp280_read_float(&m_dev, &sample->temp, &sample->pres, &sample->humi);
+    }) == ESP_OK;
+}
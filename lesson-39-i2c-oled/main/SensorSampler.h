@@ -0,0 +1,87 @@
+#pragma once
+
+#include <bmp280.h>
+#include <freertos/FreeRTOS.h>
+
+#include <ctime>
+#include <functional>
+
+#include "I2cBus.h"
+#include "LoopStats.h"
+
+// Owns the BMP280/BME280 and samples it from a dedicated task on a fixed cadence,
+// independent of the display loop. Every cycle triggers a forced-mode conversion,
+// sleeps for the conversion time given by the oversampling settings, reads the
+// result and hands a timestamped sample to the callback. Period and profile can be
+// changed at runtime from the callback, Wake() starts the next cycle right away.
+class SensorSampler
+{
+public:
+    struct Profile {
+        BMP280_Oversampling temp;
+        BMP280_Oversampling pres;
+        BMP280_Oversampling humi;
+        BMP280_Filter filter;
+    };
+
+    enum ProfileId {
+        PROFILE_WEATHER,
+        PROFILE_INDOOR,
+        PROFILE_STANDARD,
+        PROFILE_COUNT
+    };
+
+    struct Sample {
+        uint32_t seq;
+        int64_t mono_us;        // esp_timer time of conversion start
+        time_t time;            // UTC time of conversion start
+        bool valid;
+        float temp;
+        float pres;
+        float humi;
+    };
+
+    using callback_t = std::function<void(const Sample&)>;
+
+    static const Profile PROFILES[PROFILE_COUNT];
+    static const char* const PROFILE_NAMES[PROFILE_COUNT];
+    static const ProfileId DEFAULT_PROFILE;
+
+    SensorSampler(I2cBus* bus, callback_t callback);
+    ~SensorSampler();
+
+    esp_err_t Init(uint8_t addr, i2c_port_t port, gpio_num_t sda, gpio_num_t scl, ProfileId profile = DEFAULT_PROFILE);
+    void Start(uint32_t period_ms);
+    void Stop();
+
+    // Sampler task only (i.e. from the callback), take effect with the next cycle
+    void SetPeriod(uint32_t period_ms) { m_period_ms = period_ms; }
+    esp_err_t SetProfile(ProfileId profile);
+
+    // Any task: cuts the current wait short
+    void Wake();
+
+    uint32_t Period() const { return m_period_ms; }
+    ProfileId GetProfile() const { return m_profile_id; }
+
+    uint32_t ConversionTimeUs() const;
+
+private:
+    bmp280_t m_dev = {};
+    I2cBus* m_bus = nullptr;
+    int m_bus_device = -1;
+    Profile m_profile = {};
+    ProfileId m_profile_id = DEFAULT_PROFILE;
+    callback_t m_callback;
+
+    TaskHandle_t m_task = nullptr;
+    volatile bool m_stop_task = false;
+    LoopStats m_loop { "sampler_task" };
+    uint32_t m_period_ms = 1000;
+    uint32_t m_seq = 0;
+
+    void sampler_task();
+    bool acquire(Sample* sample);
+
+    static bmp280_params_t make_params(const Profile& profile);
+};
@@ -0,0 +1,209 @@
+#include "SeriesBlock.h"
+
+#include <cmath>
+#include <cstring>
+
+// Payload widths of the buckets after the 0 / 10 / 110 / 1110 / 1111 prefixes
+static const int TIME_WIDTHS[] = { 0, 7, 9, 12, 32 };
+static const int VALUE_WIDTHS[] = { 0, 4, 8, 16, 32 };
+constexpr const int BUCKETS = 5;
+
+static uint32_t zigzag(int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return static_cast<int32_t>((value >> 1) ^ (0 - (value & 1)));
+}
+
+// Differences wrap around like the encoder's, so even MISSING <-> value round-trips
+static int32_t wrapping_sub(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+
+static int32_t wrapping_add(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+static void put_le32(uint8_t* p, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        p[i] = value >> (8 * i);
+    }
+}
+
+static uint32_t get_le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+SeriesBlock::SeriesBlock(uint8_t* data, size_t capacity)
+    : m_data(data)
+    , m_capacity_bits(capacity * 8)
+{
+    Clear();
+}
+
+/* static */ SeriesBlock::Point SeriesBlock::Quantize(time_t time, float temp, float pres, float humi)
+{
+    auto fixed = [] (float value, float scale) {
+        return std::isnan(value) ? MISSING : static_cast<int32_t>(std::lround(value * scale));
+    };
+    return { static_cast<uint32_t>(time), fixed(temp, 100), fixed(pres, 1), fixed(humi, 100) };
+}
+
+void SeriesBlock::Clear()
+{
+    std::memset(m_data, 0, HEADER_SIZE);
+    m_data[0] = VERSION;
+    m_bit = HEADER_SIZE * 8;
+    m_overflow = false;
+    m_count = 0;
+    m_last = {};
+    m_last_delta = 0;
+}
+
+bool SeriesBlock::Append(const Point& point)
+{
+    if (m_capacity_bits < HEADER_SIZE * 8 || m_count == UINT16_MAX)
+        return false;
+
+    if (!m_count) {
+        put_le32(m_data + 4, point.time);
+        put_le32(m_data + 8, point.temp);
+        put_le32(m_data + 12, point.pres);
+        put_le32(m_data + 16, point.humi);
+    }
+    else {
+        const size_t start = m_bit;
+        const int32_t delta = wrapping_sub(point.time, m_last.time);
+
+        put_bucket(TIME_WIDTHS, zigzag(wrapping_sub(delta, m_last_delta)));
+        put_bucket(VALUE_WIDTHS, zigzag(wrapping_sub(point.temp, m_last.temp)));
+        put_bucket(VALUE_WIDTHS, zigzag(wrapping_sub(point.pres, m_last.pres)));
+        put_bucket(VALUE_WIDTHS, zigzag(wrapping_sub(point.humi, m_last.humi)));
+
+        if (m_overflow) {
+            m_bit = start;
+            m_overflow = false;
+            return false;
+        }
+        m_last_delta = delta;
+    }
+
+    m_last = point;
+    ++m_count;
+    m_data[2] = m_count;
+    m_data[3] = m_count >> 8;
+    return true;
+}
+
+size_t SeriesBlock::Size() const
+{
+    return (m_bit + 7) / 8;
+}
+
+void SeriesBlock::put(uint32_t value, int bits)
+{
+    // Bits are cleared as well as set, a rolled back append may have left some behind
+    for (int i = bits - 1; i >= 0; --i) {
+        if (m_bit >= m_capacity_bits) {
+            m_overflow = true;
+            return;
+        }
+        const uint8_t mask = 0x80 >> (m_bit & 7);
+        if (value >> i & 1)
+            m_data[m_bit >> 3] |= mask;
+        else
+            m_data[m_bit >> 3] &= ~mask;
+        ++m_bit;
+    }
+}
+
+void SeriesBlock::put_bucket(const int* widths, uint32_t value)
+{
+    for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+        const int width = widths[bucket];
+        if (width < 32 && value >> width)
+            continue;
+
+        // Prefix: <bucket> ones, then a zero unless it's the last bucket
+        put((1u << bucket) - 1, bucket);
+        if (bucket < BUCKETS - 1) {
+            put(0, 1);
+        }
+        put(value, width);
+        return;
+    }
+}
+
+SeriesBlock::Reader::Reader(const uint8_t* data, size_t size)
+    : m_data(data)
+    , m_size_bits(size * 8)
+{
+    if (size < HEADER_SIZE || data[0] != VERSION)
+        return;
+
+    m_count = data[2] | data[3] << 8;
+    m_last.time = get_le32(data + 4);
+    m_last.temp = get_le32(data + 8);
+    m_last.pres = get_le32(data + 12);
+    m_last.humi = get_le32(data + 16);
+    m_valid = true;
+}
+
+bool SeriesBlock::Reader::Next(Point* point)
+{
+    if (!m_valid || m_index >= m_count)
+        return false;
+
+    if (m_index) {
+        uint32_t dod, temp, pres, humi;
+        if (!get_bucket(TIME_WIDTHS, &dod) || !get_bucket(VALUE_WIDTHS, &temp)
+            || !get_bucket(VALUE_WIDTHS, &pres) || !get_bucket(VALUE_WIDTHS, &humi)) {
+            m_valid = false;        // Truncated block
+            return false;
+        }
+
+        m_last_delta = wrapping_add(m_last_delta, unzigzag(dod));
+        m_last.time += m_last_delta;
+        m_last.temp = wrapping_add(m_last.temp, unzigzag(temp));
+        m_last.pres = wrapping_add(m_last.pres, unzigzag(pres));
+        m_last.humi = wrapping_add(m_last.humi, unzigzag(humi));
+    }
+
+    ++m_index;
+    *point = m_last;
+    return true;
+}
+
+bool SeriesBlock::Reader::get(int bits, uint32_t* value)
+{
+    if (m_bit + bits > m_size_bits)
+        return false;
+
+    uint32_t v = 0;
+    for (int i = 0; i < bits; ++i, ++m_bit) {
+        v = v << 1 | (m_data[m_bit >> 3] >> (7 - (m_bit & 7)) & 1);
+    }
+    *value = v;
+    return true;
+}
+
+bool SeriesBlock::Reader::get_bucket(const int* widths, uint32_t* value)
+{
+    int bucket = 0;
+    uint32_t bit = 1;
+    while (bucket < BUCKETS - 1) {
+        if (!get(1, &bit))
+            return false;
+        if (!bit)
+            break;
+        ++bucket;
+    }
+    return get(widths[bucket], value);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// Compressed block of temperature/pressure/humidity readings, Gorilla style but on
+// fixed-point values: timestamps as delta-of-delta, each metric as the delta to its
+// previous value, both zigzag encoded into variable-width bit buckets. On a steady
+// cadence the time costs 1 bit; a metric costs 1 bit when unchanged, 6 bits for a change
+// of -8..7 units, 11 bits for -128..127 and 20 bits for -32768..32767. So sensor noise
+// sets the size: at oversampling x1, filter off and a reading every 10 s, a BME280 takes
+// about 19.3 bits per reading and a BMP280 (no humidity, 1 bit) about 13.6, against 16
+// bytes unpacked. host/history_dump measures it on a partition image.
+//
+// The block lives in a caller supplied buffer, readings are appended until it is full.
+// Layout (little endian):
+//   0  u8   version
+//   1  u8   reserved
+//   2  u16  count
+//   4  u32  first time (UTC seconds)
+//   8  i32  first temperature, pressure, humidity
+//  20  bit stream of the following readings, MSB first:
+//      time  dod:   0 | 10 +7 bits | 110 +9 bits | 1110 +12 bits | 1111 +32 bits
+//      value delta: 0 | 10 +4 bits | 110 +8 bits | 1110 +16 bits | 1111 +32 bits
+class SeriesBlock
+{
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 20;
+    static constexpr int32_t MISSING = INT32_MIN;      // Metric not measured (BMP280 humidity)
+
+    struct Point {
+        uint32_t time;          // UTC seconds
+        int32_t temp;           // 0.01 C
+        int32_t pres;           // Pa
+        int32_t humi;           // 0.01 %
+    };
+
+    SeriesBlock(uint8_t* data, size_t capacity);
+
+    static Point Quantize(time_t time, float temp, float pres, float humi);
+
+    void Clear();
+    // False when the reading doesn't fit anymore, the block is unchanged then
+    bool Append(const Point& point);
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const;
+    uint16_t Count() const { return m_count; }
+    bool IsEmpty() const { return m_count == 0; }
+
+    // Streaming decoder, also works on a block that is still being appended to
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size);
+
+        bool IsValid() const { return m_valid; }
+        uint16_t Count() const { return m_count; }
+        bool Next(Point* point);
+
+    private:
+        const uint8_t* m_data;
+        size_t m_size_bits;
+        size_t m_bit = HEADER_SIZE * 8;
+        uint16_t m_count = 0;
+        uint16_t m_index = 0;
+        bool m_valid = false;
+        Point m_last = {};
+        int32_t m_last_delta = 0;
+
+        bool get(int bits, uint32_t* value);
+        bool get_bucket(const int* widths, uint32_t* value);
+    };
+
+private:
+    uint8_t* m_data;
+    size_t m_capacity_bits;
+    size_t m_bit = HEADER_SIZE * 8;
+    bool m_overflow = false;
+    uint16_t m_count = 0;
+    Point m_last = {};
+    int32_t m_last_delta = 0;
+
+    void put(uint32_t value, int bits);
+    void put_bucket(const int* widths, uint32_t value);
+};
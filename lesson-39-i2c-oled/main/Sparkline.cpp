@@ -0,0 +1,83 @@
+#include "Sparkline.h"
+
+#include <algorithm>
+
+Sparkline::Sparkline(OledFramebuffer* screen, int page, int col, int width)
+    : m_screen(screen)
+    , m_page(page)
+    , m_col(col)
+    , m_width(std::min(width, HistoryRing::CAPACITY))
+{
+}
+
+void Sparkline::Add(float value)
+{
+    m_history.Push(value);
+    if (!m_visible || !m_history.Count())
+        return;
+
+    const float v = m_history.Latest();
+    if (m_last_y < 0 || v < m_lo || v > m_hi || ++m_since_redraw >= m_width) {
+        redraw();
+        return;
+    }
+
+    const int y = y_of(v);
+    m_screen->ScrollLeft(m_page, m_col, m_width);
+    m_screen->DrawColumn(m_page, m_col + m_width - 1, segment(m_last_y, y));
+    m_last_y = y;
+}
+
+void Sparkline::Show()
+{
+    m_visible = true;
+    redraw();
+}
+
+void Sparkline::Hide()
+{
+    m_visible = false;
+}
+
+void Sparkline::redraw()
+{
+    float values[HistoryRing::CAPACITY];
+    const int n = m_history.Read(values, m_width);
+
+    m_since_redraw = 0;
+    m_last_y = -1;
+
+    for (int x = 0; x < m_width - n; ++x) {
+        m_screen->DrawColumn(m_page, m_col + x, 0);
+    }
+    if (!n)
+        return;
+
+    auto [lo, hi] = std::minmax_element(values, values + n);
+    m_lo = *lo;
+    m_hi = *hi;
+
+    int prev = -1;
+    for (int i = 0; i < n; ++i) {
+        const int y = y_of(values[i]);
+        m_screen->DrawColumn(m_page, m_col + m_width - n + i, segment(prev < 0 ? y : prev, y));
+        prev = y;
+    }
+    m_last_y = prev;
+}
+
+int Sparkline::y_of(float value) const
+{
+    // Top row is the maximum; a flat series sits in the middle
+    if (m_hi - m_lo < 1e-6f)
+        return HEIGHT / 2;
+    return std::clamp(static_cast<int>((m_hi - value) / (m_hi - m_lo) * (HEIGHT - 1) + 0.5f), 0, HEIGHT - 1);
+}
+
+uint8_t Sparkline::segment(int from_y, int to_y) const
+{
+    // Vertical run between consecutive points keeps the line connected
+    const int top = std::min(from_y, to_y);
+    const int bottom = std::max(from_y, to_y);
+    return static_cast<uint8_t>((0xFF << top) & (0xFF >> (HEIGHT - 1 - bottom)));
+}
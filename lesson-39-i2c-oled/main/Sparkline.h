@@ -0,0 +1,40 @@
+#pragma once
+
+#include "HistoryRing.h"
+#include "OledFramebuffer.h"
+
+// One page high graph of a metric's recent values in a screen region. Adding a value
+// scrolls the drawn columns left by one and draws just the new column. The whole
+// graph is re-rendered only when the new value falls outside the current vertical
+// scale, or once per width values so the scale can shrink again.
+class Sparkline
+{
+public:
+    Sparkline(OledFramebuffer* screen, int page, int col, int width);
+
+    void Add(float value);
+
+    // Values are recorded while hidden, Show() draws them all at once
+    void Show();
+    void Hide();
+
+private:
+    static constexpr int HEIGHT = 8;
+
+    OledFramebuffer* m_screen;
+    int m_page;
+    int m_col;
+    int m_width;
+
+    HistoryRing m_history;
+    bool m_visible = false;
+
+    float m_lo = 0;
+    float m_hi = 0;
+    int m_last_y = -1;
+    int m_since_redraw = 0;
+
+    void redraw();
+    int y_of(float value) const;
+    uint8_t segment(int from_y, int to_y) const;
+};
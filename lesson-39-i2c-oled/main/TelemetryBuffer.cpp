@@ -0,0 +1,287 @@
+#include "TelemetryBuffer.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "common.h"
+
+constexpr const uint32_t I2C_FREQ_HZ = 400 * 1000;
+
+constexpr const size_t EEPROM_SIZE = 4096;          // AT24C32 - 32 Kbit
+constexpr const size_t EEPROM_PAGE_SIZE = 32;
+constexpr const int64_t WRITE_CYCLE_US = 10 * 1000LL;   // Max self-timed write cycle
+
+constexpr const uint32_t META_MAGIC = 0x424D4C54;  // "TLMB"
+
+constexpr const uint8_t HAS_TEMP = 1 << 0;
+constexpr const uint8_t HAS_PRES = 1 << 1;
+constexpr const uint8_t HAS_HUMI = 1 << 2;
+
+// Both record types are 16 bytes, so a slot never crosses an EEPROM page boundary
+// and is written in a single page write.
+struct TelemetryBuffer::Record {
+    uint32_t seq;
+    uint32_t time;
+    int16_t temp;               // 0.01 C
+    uint16_t pres;              // 0.1 hPa
+    uint16_t humi;              // 0.01 %
+    uint8_t flags;
+    uint8_t crc;
+};
+
+struct TelemetryBuffer::Meta {
+    uint32_t magic;
+    uint32_t gen;
+    uint32_t tail;
+    uint8_t reserved[3];
+    uint8_t crc;
+};
+
+constexpr const size_t SLOT_SIZE = 16;
+constexpr const size_t META_SLOTS = 2;              // Two copies, written alternately
+constexpr const size_t DATA_SLOTS = EEPROM_SIZE / SLOT_SIZE - META_SLOTS;
+
+static_assert(EEPROM_PAGE_SIZE % SLOT_SIZE == 0);
+
+static uint8_t crc8(const void* data, size_t len)
+{
+    auto p = static_cast<const uint8_t*>(data);
+    uint8_t crc = 0xFF;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; ++i)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t slot_addr(uint32_t seq)
+{
+    return (META_SLOTS + seq % DATA_SLOTS) * SLOT_SIZE;
+}
+
+TelemetryBuffer::TelemetryBuffer(I2cBus* bus)
+    : m_bus(bus)
+{
+    m_bus_device = m_bus->AddDevice("at24c32");
+}
+
+TelemetryBuffer::~TelemetryBuffer()
+{
+    Close();
+}
+
+esp_err_t TelemetryBuffer::Open(i2c_port_t port, uint8_t addr, gpio_num_t sda, gpio_num_t scl)
+{
+    static_assert(sizeof(Record) == SLOT_SIZE);
+    static_assert(sizeof(Meta) == SLOT_SIZE);
+
+    m_dev.port = port;
+    m_dev.addr = addr;
+    m_dev.cfg.sda_io_num = sda;
+    m_dev.cfg.scl_io_num = scl;
+    m_dev.cfg.master.clk_speed = I2C_FREQ_HZ;
+
+    esp_err_t err = i2c_dev_create_mutex(&m_dev);
+    if (err != ESP_OK)
+        return err;
+
+    // Probe the chip before trusting anything read from it
+    Meta meta;
+    err = read(0, &meta, sizeof(meta));
+    if (err != ESP_OK) {
+        i2c_dev_delete_mutex(&m_dev);
+        return err;
+    }
+
+    m_open = true;
+    load();
+
+    ESP_LOGI(TAG, "Telemetry buffer: %u of %u readings pending", (unsigned) Count(), (unsigned) Capacity());
+    return ESP_OK;
+}
+
+void TelemetryBuffer::Close()
+{
+    if (m_open) {
+        m_open = false;
+        i2c_dev_delete_mutex(&m_dev);
+    }
+}
+
+size_t TelemetryBuffer::Capacity() const
+{
+    return DATA_SLOTS;
+}
+
+bool TelemetryBuffer::Push(const Reading& reading)
+{
+    if (!m_open)
+        return false;
+
+    Record rec = {
+        .seq = m_head,
+        .time = static_cast<uint32_t>(reading.time),
+    };
+    if (!std::isnan(reading.temp)) {
+        rec.temp = static_cast<int16_t>(std::lround(reading.temp * 100.f));
+        rec.flags |= HAS_TEMP;
+    }
+    if (!std::isnan(reading.pres)) {
+        rec.pres = static_cast<uint16_t>(std::lround(reading.pres / 10.f));
+        rec.flags |= HAS_PRES;
+    }
+    if (!std::isnan(reading.humi)) {
+        rec.humi = static_cast<uint16_t>(std::lround(reading.humi * 100.f));
+        rec.flags |= HAS_HUMI;
+    }
+    rec.crc = crc8(&rec, offsetof(Record, crc));
+
+    if (write(slot_addr(m_head), &rec, sizeof(rec)) != ESP_OK)
+        return false;
+
+    ++m_head;
+    if (Count() > DATA_SLOTS) {
+        // Oldest reading has just been overwritten
+        m_dropped += Count() - DATA_SLOTS;
+        m_tail = m_head - DATA_SLOTS;
+    }
+    return true;
+}
+
+size_t TelemetryBuffer::Drain(size_t max_count, publish_t publish)
+{
+    if (!m_open || !Count())
+        return 0;
+
+    size_t published = 0;
+    uint32_t tail = m_tail;
+
+    while (tail != m_head && published < max_count) {
+        Record rec;
+        if (read(slot_addr(tail), &rec, sizeof(rec)) != ESP_OK)
+            break;
+
+        // Skip slots that were torn by a reset in the middle of a write
+        if (rec.seq == tail && rec.crc == crc8(&rec, offsetof(Record, crc))) {
+            Reading reading = {
+                .time = static_cast<time_t>(rec.time),
+                .temp = (rec.flags & HAS_TEMP) ? rec.temp / 100.f : NAN,
+                .pres = (rec.flags & HAS_PRES) ? rec.pres * 10.f : NAN,
+                .humi = (rec.flags & HAS_HUMI) ? rec.humi / 100.f : NAN,
+            };
+            if (!publish(reading))
+                break;
+            ++published;
+        }
+        ++tail;
+    }
+
+    if (tail != m_tail) {
+        m_tail = tail;
+        save_tail();
+    }
+    return published;
+}
+
+esp_err_t TelemetryBuffer::read(uint16_t addr, void* data, size_t size)
+{
+    wait_write_cycle();
+
+    uint8_t reg[2] = { static_cast<uint8_t>(addr >> 8), static_cast<uint8_t>(addr) };
+
+    return m_bus->Execute(m_bus_device, I2cBus::PRIO_STORAGE, 0, [&] () -> esp_err_t {
+        I2C_DEV_TAKE_MUTEX(&m_dev);
+        I2C_DEV_CHECK(&m_dev, i2c_dev_read(&m_dev, reg, sizeof(reg), data, size));
+        I2C_DEV_GIVE_MUTEX(&m_dev);
+        return ESP_OK;
+    });
+}
+
+esp_err_t TelemetryBuffer::write(uint16_t addr, const void* data, size_t size)
+{
+    wait_write_cycle();
+
+    uint8_t reg[2] = { static_cast<uint8_t>(addr >> 8), static_cast<uint8_t>(addr) };
+
+    esp_err_t err = m_bus->Execute(m_bus_device, I2cBus::PRIO_STORAGE, 0, [&] () -> esp_err_t {
+        I2C_DEV_TAKE_MUTEX(&m_dev);
+        I2C_DEV_CHECK(&m_dev, i2c_dev_write(&m_dev, reg, sizeof(reg), data, size));
+        I2C_DEV_GIVE_MUTEX(&m_dev);
+        return ESP_OK;
+    });
+    if (err != ESP_OK)
+        return err;
+
+    m_write_time = esp_timer_get_time();
+    return ESP_OK;
+}
+
+void TelemetryBuffer::wait_write_cycle()
+{
+    // The chip does not acknowledge anything until its internal write cycle completes
+    while (esp_timer_get_time() - m_write_time < WRITE_CYCLE_US) {
+        vTaskDelay(1);
+    }
+}
+
+void TelemetryBuffer::load()
+{
+    // Restore head from the newest valid record
+    bool found = false;
+    uint8_t page[EEPROM_PAGE_SIZE];
+
+    for (uint16_t addr = META_SLOTS * SLOT_SIZE; addr < EEPROM_SIZE; addr += sizeof(page)) {
+        if (read(addr, page, sizeof(page)) != ESP_OK)
+            continue;
+
+        for (size_t offset = 0; offset < sizeof(page); offset += SLOT_SIZE) {
+            auto rec = reinterpret_cast<const Record*>(page + offset);
+            if (rec->crc != crc8(rec, offsetof(Record, crc)))
+                continue;
+            if (slot_addr(rec->seq) != addr + offset)
+                continue;
+            if (!found || rec->seq >= m_head) {
+                m_head = rec->seq + 1;
+                found = true;
+            }
+        }
+    }
+
+    // Restore tail from the newest valid metadata copy
+    for (size_t i = 0; i < META_SLOTS; ++i) {
+        Meta meta;
+        if (read(i * SLOT_SIZE, &meta, sizeof(meta)) != ESP_OK)
+            continue;
+        if (meta.magic != META_MAGIC || meta.crc != crc8(&meta, offsetof(Meta, crc)))
+            continue;
+        if (meta.gen >= m_meta_gen) {
+            m_meta_gen = meta.gen;
+            m_tail = meta.tail;
+        }
+    }
+
+    // Tail must lie within the last DATA_SLOTS records before head
+    if (m_tail > m_head)
+        m_tail = m_head;
+    else if (m_head - m_tail > DATA_SLOTS)
+        m_tail = m_head - DATA_SLOTS;
+}
+
+bool TelemetryBuffer::save_tail()
+{
+    Meta meta = {
+        .magic = META_MAGIC,
+        .gen = ++m_meta_gen,
+        .tail = m_tail,
+    };
+    meta.crc = crc8(&meta, offsetof(Meta, crc));
+
+    return write((meta.gen % META_SLOTS) * SLOT_SIZE, &meta, sizeof(meta)) == ESP_OK;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <i2cdev.h>
+
+#include "I2cBus.h"
+
+#include <ctime>
+#include <cstdint>
+#include <functional>
+
+// Ring of timestamped sensor readings kept in AT24C32 EEPROM while the node is offline.
+// Every slot carries its own sequence number and CRC, so the ring survives resets and
+// power loss: on Open() the newest valid slot becomes the head, and the drain position
+// is restored from a double-buffered metadata slot.
+// The chip is driven through i2cdev rather than the at24c component: that one reads and
+// writes a byte per transaction, so a record would take 16 write cycles instead of one
+// page write, and it brings up the I2C port on its own instead of sharing I2cBus.
+class TelemetryBuffer
+{
+public:
+    struct Reading {
+        time_t time;
+        float temp;             // Celsius
+        float pres;             // Pascal
+        float humi;             // Percent
+    };
+
+    using publish_t = std::function<bool(const Reading&)>;
+
+    TelemetryBuffer(I2cBus* bus);
+    ~TelemetryBuffer();
+
+    esp_err_t Open(i2c_port_t port, uint8_t addr, gpio_num_t sda, gpio_num_t scl);
+    void Close();
+
+    bool Push(const Reading& reading);
+    size_t Drain(size_t max_count, publish_t publish);
+
+    bool IsOpen() const { return m_open; }
+    size_t Count() const { return m_head - m_tail; }
+    size_t Capacity() const;
+    uint32_t Dropped() const { return m_dropped; }
+
+private:
+    struct Record;
+    struct Meta;
+
+    i2c_dev_t m_dev = {};
+    I2cBus* m_bus = nullptr;
+    int m_bus_device = -1;
+    bool m_open = false;
+
+    uint32_t m_head = 0;        // Sequence number of the next record to write
+    uint32_t m_tail = 0;        // Sequence number of the oldest record not yet drained
+    uint32_t m_meta_gen = 0;
+    uint32_t m_dropped = 0;     // Records overwritten before they could be drained
+
+    int64_t m_write_time = 0;
+
+    esp_err_t read(uint16_t addr, void* data, size_t size);
+    esp_err_t write(uint16_t addr, const void* data, size_t size);
+    void wait_write_cycle();
+
+    void load();
+    bool save_tail();
+};
@@ -0,0 +1,265 @@
+#include "TimeZone.h"
+
+#include <cctype>
+
+constexpr const int32_t SECONDS_PER_DAY = 24 * 60 * 60;
+constexpr const int32_t DEFAULT_RULE_TIME = 2 * 60 * 60;     // 02:00 when "/time" is omitted
+
+bool TimeZone::Parse(const char* posix_tz)
+{
+    // A rule that fails halfway would leave its offsets set so far
+    if (parse(posix_tz))
+        return true;
+
+    *this = TimeZone();
+    return false;
+}
+
+bool TimeZone::parse(const char* posix_tz)
+{
+    if (!posix_tz)
+        return false;
+
+    // std offset [dst [offset] [,start[/time],end[/time]]]
+    const char* p = parse_name(posix_tz);
+    int32_t offset = 0;
+    if (!p || !(p = parse_time(p, &offset)))
+        return false;
+
+    // POSIX offsets are west of Greenwich, "EET-2" is UTC+2
+    m_std_offset = -offset;
+    m_dst_offset = m_std_offset + 60 * 60;
+    m_has_dst = false;
+    m_year_begin = m_year_end = 0;
+
+    if (!*p)
+        return true;
+
+    if (!(p = parse_name(p)))
+        return false;
+
+    if (*p && *p != ',') {
+        if (!(p = parse_time(p, &offset)))
+            return false;
+        m_dst_offset = -offset;
+    }
+
+    if (*p++ != ',' || !(p = parse_rule(p, &m_start)) || *p++ != ',' || !(p = parse_rule(p, &m_end)) || *p)
+        return false;
+
+    m_has_dst = true;
+    return true;
+}
+
+void TimeZone::ToLocal(time_t utc, tm* local)
+{
+    const bool dst = IsDst(utc);
+    ToCivil(utc + (dst ? m_dst_offset : m_std_offset), local);
+    local->tm_isdst = dst;
+    m_last_utc = utc;
+}
+
+time_t TimeZone::ToUtc(const tm& local)
+{
+    const time_t wall = FromCivil(local);
+    if (!m_has_dst)
+        return wall - m_std_offset;
+
+    // Prefer daylight time when the wall time is valid as such. A wall time inside
+    // the spring gap resolves to standard time, one inside the autumn overlap to its
+    // first (daylight) occurrence.
+    const time_t as_dst = wall - m_dst_offset;
+    return IsDst(as_dst) ? as_dst : wall - m_std_offset;
+}
+
+void TimeZone::Update(time_t utc, tm* local)
+{
+    const time_t delta = utc - m_last_utc;
+
+    // Fast path: same minute, no DST transition crossed
+    if (delta >= 0 && local->tm_sec + delta < 60
+        && (!m_has_dst || (utc < m_year_end
+            && (m_last_utc < m_dst_begin) == (utc < m_dst_begin)
+            && (m_last_utc < m_dst_end) == (utc < m_dst_end)))) {
+        local->tm_sec += delta;
+        m_last_utc = utc;
+        return;
+    }
+
+    ToLocal(utc, local);
+}
+
+bool TimeZone::IsDst(time_t utc)
+{
+    if (!m_has_dst)
+        return false;
+
+    if (utc < m_year_begin || utc >= m_year_end) {
+        cache_year(utc);
+    }
+
+    if (m_dst_begin < m_dst_end)
+        return utc >= m_dst_begin && utc < m_dst_end;
+    // Southern hemisphere: DST spans the new year
+    return utc >= m_dst_begin || utc < m_dst_end;
+}
+
+/* static */ time_t TimeZone::FromCivil(const tm& utc)
+{
+    // Normalize month, everything below it is linear
+    int64_t year = utc.tm_year + 1900LL;
+    int month = utc.tm_mon;
+    year += month / 12;
+    month %= 12;
+    if (month < 0) {
+        month += 12;
+        --year;
+    }
+
+    const int64_t days = days_from_civil(year, month + 1, 1) + utc.tm_mday - 1;
+    return days * SECONDS_PER_DAY + utc.tm_hour * 3600LL + utc.tm_min * 60LL + utc.tm_sec;
+}
+
+/* static */ void TimeZone::ToCivil(time_t utc, tm* out)
+{
+    int64_t days = utc / SECONDS_PER_DAY;
+    int32_t secs = utc % SECONDS_PER_DAY;
+    if (secs < 0) {
+        secs += SECONDS_PER_DAY;
+        --days;
+    }
+
+    out->tm_hour = secs / 3600;
+    out->tm_min = secs / 60 % 60;
+    out->tm_sec = secs % 60;
+    out->tm_wday = static_cast<int>((days % 7 + 11) % 7);    // 1970-01-01 was Thursday
+
+    // civil_from_days(), H. Hinnant
+    const int64_t z = days + 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    const int d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    const int m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    const int64_t y = yoe + era * 400 + (m <= 2);
+
+    out->tm_year = static_cast<int>(y - 1900);
+    out->tm_mon = m - 1;
+    out->tm_mday = d;
+    out->tm_yday = static_cast<int>(days - days_from_civil(y, 1, 1));
+    out->tm_isdst = 0;
+}
+
+void TimeZone::cache_year(time_t utc)
+{
+    tm civil;
+    ToCivil(utc, &civil);
+    const int year = civil.tm_year + 1900;
+
+    // Start rule is given in standard time, end rule in daylight time
+    m_year_begin = days_from_civil(year, 1, 1) * SECONDS_PER_DAY;
+    m_year_end = days_from_civil(year + 1, 1, 1) * SECONDS_PER_DAY;
+    m_dst_begin = transition(year, m_start, m_std_offset);
+    m_dst_end = transition(year, m_end, m_dst_offset);
+}
+
+time_t TimeZone::transition(int year, const Rule& rule, int32_t offset) const
+{
+    // First <wday> of the month, then advance by weeks; week 5 means the last one
+    const int64_t first = days_from_civil(year, rule.month, 1);
+    const int first_wday = static_cast<int>((first % 7 + 11) % 7);
+    int64_t day = first + (rule.wday - first_wday + 7) % 7 + 7 * (rule.week - 1);
+
+    const int64_t next_month = rule.month == 12 ? days_from_civil(year + 1, 1, 1) : days_from_civil(year, rule.month + 1, 1);
+    while (day >= next_month) {
+        day -= 7;
+    }
+
+    return day * SECONDS_PER_DAY + rule.time - offset;
+}
+
+/* static */ const char* TimeZone::parse_name(const char* p)
+{
+    const char* begin = p;
+    if (*p == '<') {
+        while (*p && *p != '>')
+            ++p;
+        return *p ? p + 1 : nullptr;
+    }
+
+    while (std::isalpha(static_cast<unsigned char>(*p)))
+        ++p;
+    return p - begin >= 3 ? p : nullptr;
+}
+
+/* static */ const char* TimeZone::parse_time(const char* p, int32_t* seconds)
+{
+    // [+|-]hh[:mm[:ss]]
+    int sign = 1;
+    if (*p == '+' || *p == '-') {
+        sign = *p++ == '-' ? -1 : 1;
+    }
+
+    int32_t value = 0;
+    for (int field = 0; field < 3; ++field) {
+        if (!std::isdigit(static_cast<unsigned char>(*p)))
+            return nullptr;
+
+        int32_t n = 0;
+        while (std::isdigit(static_cast<unsigned char>(*p))) {
+            n = n * 10 + (*p++ - '0');
+        }
+
+        value += n * (field == 0 ? 3600 : field == 1 ? 60 : 1);
+        if (*p != ':')
+            break;
+        ++p;
+    }
+
+    *seconds = sign * value;
+    return p;
+}
+
+/* static */ const char* TimeZone::parse_rule(const char* p, Rule* rule)
+{
+    // Mm.w.d[/time]
+    if (*p++ != 'M')
+        return nullptr;
+
+    int fields[3] = {};
+    for (int i = 0; i < 3; ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(*p)))
+            return nullptr;
+        while (std::isdigit(static_cast<unsigned char>(*p))) {
+            fields[i] = fields[i] * 10 + (*p++ - '0');
+        }
+        if (i < 2 && *p++ != '.')
+            return nullptr;
+    }
+
+    if (fields[0] < 1 || fields[0] > 12 || fields[1] < 1 || fields[1] > 5 || fields[2] > 6)
+        return nullptr;
+
+    rule->month = fields[0];
+    rule->week = fields[1];
+    rule->wday = fields[2];
+    rule->time = DEFAULT_RULE_TIME;
+
+    if (*p == '/') {
+        return parse_time(p + 1, &rule->time);
+    }
+    return p;
+}
+
+/* static */ int64_t TimeZone::days_from_civil(int64_t y, int m, int d)
+{
+    // days_from_civil(), H. Hinnant: days since 1970-01-01 of a proleptic Gregorian date
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <ctime>
+#include <cstdint>
+
+// UTC <-> local time for one POSIX TZ rule ("EET-2EEST,M3.5.0/3,M10.5.0/4"), without
+// libc and without touching the process-wide TZ. DST transition instants are computed
+// once per year and cached, so a conversion is a couple of compares plus calendar
+// arithmetic; Update() goes further and just advances the previous result while the
+// clock ticks within the same minute.
+// Only the Mm.w.d transition rule format is supported (the one used everywhere in practice).
+class TimeZone
+{
+public:
+    TimeZone() = default;
+
+    // False and back to plain UTC when the rule is malformed or unsupported
+    bool Parse(const char* posix_tz);
+
+    void ToLocal(time_t utc, tm* local);
+    time_t ToUtc(const tm& local);
+
+    // Incremental ToLocal() for a clock that moves forward, local must hold the previous result
+    void Update(time_t utc, tm* local);
+
+    bool IsDst(time_t utc);
+
+    // Calendar arithmetic in UTC, replacement for timegm()/gmtime_r()
+    static time_t FromCivil(const tm& utc);
+    static void ToCivil(time_t utc, tm* out);
+
+private:
+    struct Rule {
+        int month;              // 1..12
+        int week;               // 1..5, 5 = last
+        int wday;               // 0 = Sunday
+        int32_t time;           // Seconds after local midnight
+    };
+
+    int32_t m_std_offset = 0;   // Seconds east of UTC
+    int32_t m_dst_offset = 0;
+    bool m_has_dst = false;
+    Rule m_start = {};
+    Rule m_end = {};
+
+    // Transition instants of the cached year (UTC)
+    time_t m_year_begin = 0;
+    time_t m_year_end = 0;
+    time_t m_dst_begin = 0;
+    time_t m_dst_end = 0;
+
+    time_t m_last_utc = 0;      // Argument of the last Update()
+
+    void cache_year(time_t utc);
+    time_t transition(int year, const Rule& rule, int32_t offset) const;
+
+    bool parse(const char* posix_tz);
+    static const char* parse_name(const char* p);
+    static const char* parse_time(const char* p, int32_t* seconds);
+    static const char* parse_rule(const char* p, Rule* rule);
+    static int64_t days_from_civil(int64_t y, int m, int d);
+};
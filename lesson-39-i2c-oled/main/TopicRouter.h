@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Maps the last level of an MQTT topic (e.g. "temp" in "home/node1/temp") to a route.
+struct TopicRoute {
+    std::string_view suffix;    // Last topic level, without '/'
+    const char* label;          // Label shown on the OLED
+    int line;                   // OLED page the value is drawn on
+};
+
+// Topic lookup table built at compile time as a hash-and-displace perfect hash:
+// the first hash picks a bucket, the bucket's displacement remixes the second hash
+// into a slot, and displacements are chosen so that no two routes share a slot.
+// Lookup is one backward scan over the last topic level (both hashes at once),
+// one table probe and one compare.
+template <size_t N>
+class TopicRouter
+{
+public:
+    constexpr TopicRouter(const TopicRoute (&routes)[N])
+        : m_routes(routes)
+    {
+        m_valid = build();
+    }
+
+    // False when displacements could not be found - check with static_assert
+    constexpr bool IsValid() const { return m_valid; }
+
+    constexpr const TopicRoute* Find(std::string_view topic) const
+    {
+        uint32_t h1 = FNV_BASIS_1;
+        uint32_t h2 = FNV_BASIS_2;
+        size_t i = topic.size();
+        while (i && topic[i - 1] != '/') {
+            uint8_t ch = topic[--i];
+            h1 = (h1 ^ ch) * FNV_PRIME;
+            h2 = (h2 ^ ch) * FNV_PRIME;
+        }
+
+        uint8_t index = m_table[slot(h2, m_disp[h1 >> BUCKET_SHIFT])];
+        if (index != EMPTY && m_routes[index].suffix == topic.substr(i))
+            return &m_routes[index];
+        return nullptr;
+    }
+
+private:
+    static constexpr uint32_t FNV_BASIS_1 = 2166136261u;
+    static constexpr uint32_t FNV_BASIS_2 = 0x9E3779B9u;
+    static constexpr uint32_t FNV_PRIME = 16777619u;
+    static constexpr uint32_t MAX_DISP = 0xFFFF;
+    static constexpr uint8_t EMPTY = 0xFF;
+
+    // Indexes are taken from the top bits of the hashes, low bits of FNV mix poorly
+    static constexpr size_t BUCKETS = std::bit_ceil(N < 2 ? 2 : N);
+    static constexpr size_t SIZE = std::bit_ceil(2 * N);
+    static constexpr int BUCKET_SHIFT = 32 - std::countr_zero(BUCKETS);
+    static constexpr int SLOT_SHIFT = 32 - std::countr_zero(SIZE);
+
+    static_assert(N < EMPTY, "Too many routes");
+
+    const TopicRoute* m_routes;
+    uint16_t m_disp[BUCKETS] = {};
+    uint8_t m_table[SIZE] = {};
+    bool m_valid = false;
+
+    static constexpr uint32_t hash(std::string_view s, uint32_t h)
+    {
+        for (size_t i = s.size(); i; --i) {
+            h = (h ^ static_cast<uint8_t>(s[i - 1])) * FNV_PRIME;
+        }
+        return h;
+    }
+
+    static constexpr size_t slot(uint32_t h, uint32_t disp)
+    {
+        // Murmur3 finalizer, so each displacement gives an unrelated slot
+        h ^= disp * 0x85EBCA6Bu;
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return h >> SLOT_SHIFT;
+    }
+
+    constexpr bool build()
+    {
+        size_t bucket_of[N] = {};
+        size_t bucket_size[BUCKETS] = {};
+        for (size_t k = 0; k < N; ++k) {
+            bucket_of[k] = hash(m_routes[k].suffix, FNV_BASIS_1) >> BUCKET_SHIFT;
+            ++bucket_size[bucket_of[k]];
+        }
+
+        for (size_t i = 0; i < SIZE; ++i) {
+            m_table[i] = EMPTY;
+        }
+
+        // Place the fullest buckets first while the table is still sparse
+        for (size_t size = N; size; --size) {
+            for (size_t b = 0; b < BUCKETS; ++b) {
+                if (bucket_size[b] == size && !place_bucket(b, bucket_of))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr bool place_bucket(size_t bucket, const size_t (&bucket_of)[N])
+    {
+        size_t taken[N] = {};
+
+        for (uint32_t disp = 0; disp <= MAX_DISP; ++disp) {
+            size_t count = 0;
+            bool fits = true;
+            for (size_t k = 0; k < N && fits; ++k) {
+                if (bucket_of[k] != bucket)
+                    continue;
+                size_t s = slot(hash(m_routes[k].suffix, FNV_BASIS_2), disp);
+                if (m_table[s] != EMPTY) {
+                    fits = false;
+                }
+                else {
+                    m_table[s] = k;
+                    taken[count++] = s;
+                }
+            }
+
+            if (fits) {
+                m_disp[bucket] = disp;
+                return true;
+            }
+
+            // Roll back slots taken by this attempt
+            while (count) {
+                m_table[taken[--count]] = EMPTY;
+            }
+        }
+        return false;
+    }
+};
+
+// MQTT topic filter match, '+' is one level, a trailing '#' any number of levels
+inline bool topic_matches(std::string_view filter, std::string_view topic)
+{
+    size_t f = 0;
+    size_t t = 0;
+    while (f < filter.size()) {
+        if (filter[f] == '#')
+            return true;
+
+        const size_t f_end = std::min(filter.find('/', f), filter.size());
+        const size_t t_end = std::min(topic.find('/', t), topic.size());
+        if (t > topic.size() || (filter.substr(f, f_end - f) != "+" && filter.substr(f, f_end - f) != topic.substr(t, t_end - t)))
+            return false;
+
+        f = f_end + 1;
+        t = t_end + 1;
+    }
+    return t > topic.size();
+}
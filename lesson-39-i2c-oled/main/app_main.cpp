@@ -8,7 +8,8 @@
 
 extern "C" void app_main(void)
 {
-    setenv("TZ", "EET-2EEST,M3.5.0/3,M10.5.0/4", 1);
+    // Only for libc time functions, the monitor converts local time on its own
+    setenv("TZ", CONFIG_LOCAL_TIMEZONE, 1);
     tzset();
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
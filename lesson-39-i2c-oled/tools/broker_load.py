@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Load test of the local MQTT broker (main/MqttBroker.h) with many clients.
+
+Runs against a monitor built with BROKER_ENABLE, e.g. the host build with
+host/broker.sdkconfig. Phases:
+  connect  --clients clients connect at once; the broker takes BROKER_MAX_CLIENTS of
+           them and closes the others right after accept
+  publish  every accepted client but one publishes QoS 0 sensor readings under
+           sensors/ at --rate per second, one in ten at QoS 1 for the PUBACK time,
+           for --seconds; the remaining client subscribes to sensors/# and counts
+  churn    accepted clients disconnect in turns to make room for the refused ones
+           until every client has had a session, or --seconds have passed
+"""
+import argparse, asyncio, random, struct, time
+
+args = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+args.add_argument("--host", default="127.0.0.1")
+args.add_argument("--port", type=int, default=1883)
+args.add_argument("--clients", type=int, default=300)
+args.add_argument("--rate", type=float, default=2, help="messages per second and client")
+args.add_argument("--seconds", type=float, default=20)
+args = args.parse_args()
+
+
+def string(s):
+    return struct.pack(">H", len(s)) + s.encode()
+
+
+def packet(header, body):
+    length, n = b"", len(body)
+    while True:
+        length += bytes([(n & 0x7F) | (0x80 if n > 0x7F else 0)])
+        n >>= 7
+        if not n:
+            return bytes([header]) + length + body
+
+
+async def read_packet(reader):
+    header = (await reader.readexactly(1))[0]
+    length, shift = 0, 0
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return header, await reader.readexactly(length)
+
+
+def percentiles(values):
+    if not values:
+        return "-"
+    values = sorted(values)
+    at = lambda p: values[min(len(values) - 1, int(p * len(values)))] * 1000
+    return f"p50 {at(0.5):.2f} ms, p99 {at(0.99):.2f} ms, max {values[-1] * 1000:.2f} ms"
+
+
+async def connect(client_id):
+    """(reader, writer, CONNACK time) or None when the broker refused or closed"""
+    start = time.monotonic()
+    try:
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), 10)
+        writer.write(packet(0x10, string("MQTT") + bytes([4, 0x02]) + struct.pack(">H", 60) + string(client_id)))
+        header, body = await asyncio.wait_for(read_packet(reader), 10)
+        if header >> 4 == 2 and body[1] == 0:
+            return reader, writer, time.monotonic() - start
+        writer.close()
+    except (OSError, asyncio.IncompleteReadError, asyncio.TimeoutError):
+        pass
+    return None
+
+
+async def subscriber(reader, writer, received):
+    writer.write(packet(0x82, struct.pack(">H", 1) + string("sensors/#") + b"\0"))
+    try:
+        while True:
+            header, body = await read_packet(reader)
+            if header >> 4 == 3:
+                (sent,) = struct.unpack_from(">d", body, 2 + struct.unpack_from(">H", body)[0])
+                received.append(time.monotonic() - sent)
+    except (OSError, asyncio.IncompleteReadError):
+        print("subscriber disconnected by the broker")
+
+
+async def publisher(index, reader, writer, end, stats):
+    topic = string(f"sensors/load{index}/temp")
+    packet_id = 0
+    await asyncio.sleep(random.random() / args.rate)
+    try:
+        while time.monotonic() < end:
+            payload = struct.pack(">d", time.monotonic()) + b" 21.5"
+            if random.random() < 0.1:
+                packet_id = packet_id % 0xFFFF + 1
+                writer.write(packet(0x32, topic + struct.pack(">H", packet_id) + payload))
+                start = time.monotonic()
+                header, _ = await asyncio.wait_for(read_packet(reader), 5)
+                stats["puback"].append(time.monotonic() - start)
+            else:
+                writer.write(packet(0x30, topic + payload))
+            stats["sent"] += 1
+            await writer.drain()
+            await asyncio.sleep(1 / args.rate)
+    except (OSError, asyncio.IncompleteReadError, asyncio.TimeoutError):
+        stats["lost"] += 1
+
+
+async def main():
+    ids = [f"load{i}" for i in range(args.clients)]
+    results = await asyncio.gather(*(connect(i) for i in ids))
+    sessions = {ids[i]: r for i, r in enumerate(results) if r}
+    print(f"connect: {len(sessions)} of {args.clients} accepted, CONNACK {percentiles([r[2] for r in sessions.values()])}")
+    if len(sessions) < 2:
+        return
+
+    first, *others = sessions.values()
+    received, stats = [], {"sent": 0, "lost": 0, "puback": []}
+    listener = asyncio.create_task(subscriber(first[0], first[1], received))
+    start = time.monotonic()
+    await asyncio.gather(*(publisher(i, r, w, start + args.seconds, stats) for i, (r, w, _) in enumerate(others)))
+    await asyncio.sleep(0.5)
+    elapsed = time.monotonic() - start
+    print(f"publish: {len(others)} publishers, {stats['sent']} sent ({stats['sent'] / elapsed:.0f}/s), "
+          f"{len(received)} delivered, {stats['lost']} publishers disconnected")
+    print(f"  delivery {percentiles(received)}")
+    print(f"  PUBACK   {percentiles(stats['puback'])}")
+    listener.cancel()
+
+    served, waiting = set(sessions), [i for i in ids if i not in sessions]
+    for _, writer, _ in sessions.values():
+        writer.write(packet(0xE0, b""))
+        writer.close()
+    end, times, refused = time.monotonic() + args.seconds, [], 0
+    while waiting and time.monotonic() < end:
+        batch, waiting = waiting[:len(sessions)], waiting[len(sessions):]
+        results = await asyncio.gather(*(connect(i) for i in batch))
+        for client_id, result in zip(batch, results):
+            if result:
+                served.add(client_id)
+                times.append(result[2])
+                result[1].write(packet(0xE0, b""))
+                result[1].close()
+            else:
+                refused += 1
+                waiting.append(client_id)
+        await asyncio.sleep(0.05)
+    print(f"churn: {len(served)} of {args.clients} clients had a session, {refused} connects refused, "
+          f"CONNACK {percentiles(times)}")
+
+
+asyncio.run(main())
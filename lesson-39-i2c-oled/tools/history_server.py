@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""Receiver of HistoryUploader's POSTs (see main/HistoryUploader.h) for testing.
+
+Appends the frames { u32 seq, u16 size, block } to FILE as they arrive, so the file
+decodes with "history_dump --frames FILE", and answers "next=<X-History-To>" over a
+kept-alive connection. For the resume path it can take fewer blocks than offered
+(--accept), drop every Nth request without an answer (--drop) and rewind (--rewind).
+"""
+import argparse, http.server, struct
+
+args = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+args.add_argument("file", help="file the received frames are appended to")
+args.add_argument("--port", type=int, default=8080)
+args.add_argument("--accept", type=int, default=0, help="take at most N blocks per request")
+args.add_argument("--drop", type=int, default=0, help="close every Nth request instead of answering")
+args.add_argument("--rewind", type=int, help="answer next=SEQ once, to get blocks again")
+args = args.parse_args()
+requests = 0
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"       # Keep-alive
+    wbufsize = -1                       # Headers and body in one segment, no delayed ACK wait
+
+    def do_POST(self):
+        global requests
+        requests += 1
+        first, offered = int(self.headers["X-History-From"]), int(self.headers["X-History-To"])
+        assert self.headers["Transfer-Encoding"] == "chunked"
+        frames = []
+        while size := int(self.rfile.readline(), 16):
+            chunk = self.rfile.read(size + 2)[:-2]
+            seq, length = struct.unpack_from("<IH", chunk)
+            assert first <= seq < offered and length == len(chunk) - 6, (seq, length, len(chunk))
+            frames.append((seq, chunk))
+        self.rfile.readline()
+        if args.drop and requests % args.drop == 0:
+            print(f"#{requests} port {self.client_address[1]} blocks {first}..{offered - 1}: dropped", flush=True)
+            self.close_connection = True
+            return
+        to = min(offered, first + args.accept) if args.accept else offered
+        with open(args.file, "ab") as out:
+            out.write(b"".join(chunk for seq, chunk in frames if seq < to))
+        if args.rewind is not None:
+            to, args.rewind = args.rewind, None
+        print(f"#{requests} port {self.client_address[1]} blocks {first}..{offered - 1}: {len(frames)} frames, next={to}", flush=True)
+        body = f"next={to}".encode()
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, *_):
+        pass
+
+http.server.ThreadingHTTPServer(("", args.port), Handler).serve_forever()